@@ -24,9 +24,28 @@ GNU General Public License for more details.
 #include <exception>
 #include <codecvt>
 #include <memory>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include "cli11/CLI11.hpp"
 #include "crypt.h"
+#include "crypt_file.h"
 #include "crypt_help.h"
+#include "crypt_manifest.h"
+#include "crypt_pool.h"
+#include "crypt_stats.h"
 #include "cryptheader.h"
 #include "exception.h"
 #include "cryptopp/base64.h"  
@@ -34,7 +53,13 @@ GNU General Public License for more details.
 
 enum class Action : unsigned
 {
-	encrypt, decrypt, hash
+	encrypt, decrypt, hash, calibrate, bench
+};
+
+/* --format of bench and --stats */
+enum class Format : unsigned
+{
+	table, json, csv
 };
 
 struct Arguments
@@ -53,6 +78,19 @@ struct Arguments
 	std::string salt;
 	std::string hmac;
 	std::string hash_key;
+	std::string segment_size;
+	std::string scrypt_memory;
+	std::string target;
+	std::string memory;
+	std::string sizes;
+	std::string format;
+	std::vector<std::string> files;
+	std::string from_list;
+	std::string jobs;
+	std::string recursive;
+	std::string check;
+	std::string manifest;
+	std::string keyfile;
 };
 
 struct CLIOptions
@@ -70,14 +108,36 @@ struct CLIOptions
 	CLI::Option* salt;
 	CLI::Option* hmac;
 	CLI::Option* hash_key;
+	CLI::Option* segment_size;
+	CLI::Option* scrypt_memory;
+	CLI::Option* target;
+	CLI::Option* memory;
+	CLI::Option* sizes;
+	CLI::Option* format;
+	CLI::Option* files;
+	CLI::Option* batch;
+	CLI::Option* from_list;
+	CLI::Option* jobs;
+	CLI::Option* recursive;
+	CLI::Option* check;
+	CLI::Option* manifest;
+	CLI::Option* rekey;
+	CLI::Option* keyfile;
+	CLI::Option* stats;
 	CLI::Option* action;
 	CLI::Option* noheader;
 	CLI::Option* silent;
 	CLI::Option* nointeraction;
 };
 
-Arguments	args;
-CLIOptions	opt;
+Arguments		args;
+CLIOptions		opt;
+std::ostream*	info = &std::cout;		// messages: std::cerr if the output data goes to stdout
+
+const size_t	stream_block_size = 1048576;	// input "-" or output "-": bytes read and encrypted/decrypted at once
+const size_t	batch_group_size = 1048576;		// -j: smaller files are grouped into tasks of about this many bytes
+const size_t	batch_group_files = 64;			// -j: max files per task
+const size_t	batch_split_size = 16777216;	// -j: larger files are processed one after the other, split across all workers
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -101,6 +161,11 @@ public:
 		struct stat buffer;
 		return (stat(path.c_str(), &buffer) == 0);
 	};
+	/* "-": stdin as input, stdout as output */
+	static bool isStdStream(const std::string& path)
+	{
+		return (path.compare("-") == 0);
+	};
 
 protected:
 	BOM	bom;
@@ -109,97 +174,66 @@ protected:
 class FileReader : public File
 {
 public:
-	FileReader(const std::string& path)
+	/* the file is memory mapped if possible, the data is never copied */
+	FileReader(const std::string& path) : offset(0)
 	{
-		try {
-			fs.open(path, std::ios::in | std::ios::binary);
-			if (!fs.is_open()) {
-				throw std::exception();
-			}
-			fs.exceptions(std::ifstream::badbit);
-
-			fs.seekg(0, fs.end);
-			data_length = fs.tellg();
-			if (!data_length) {
-				throw std::exception();
-			}
-			fs.seekg(0, fs.beg);
-
-			if (data_length > 4) {
-				unsigned char temp[4];
-				fs.read(reinterpret_cast<char*>(temp), 4);
-				for (size_t i = 0; i < BOMbytes.size(); i++) {
-					unsigned char c = 0;
-					while (c < BOMbytes[i][0] + 1 && BOMbytes[i][c + 1] == temp[c]) {
-						c++;
-					}
-					if (c == BOMbytes[i][0]) {
-						fs.seekg(BOMbytes[i][0], fs.beg);
-						bom = (BOM)i;
-						data_length -= BOMbytes[i][0];
-						break;
-					}
+		crypt::Stats::Timer timer(crypt::Stats::Phase::read);
+		if (file.open(path, crypt::MappedFile::sequential | crypt::MappedFile::hugepages) && file.size() > 4) {
+			const byte* temp = file.data();
+			for (size_t i = 0; i < BOMbytes.size(); i++) {
+				unsigned char c = 0;
+				while (c < BOMbytes[i][0] + 1 && BOMbytes[i][c + 1] == temp[c]) {
+					c++;
+				}
+				if (c == BOMbytes[i][0]) {
+					offset = BOMbytes[i][0];
+					bom = (BOM)i;
+					break;
 				}
 			}
-		} catch (...) {
-			if (fs.is_open()) {
-				fs.close();
-			}
-		}
-	};
-
-	~FileReader()
-	{
-		if (fs.is_open()) {
-			fs.close();
 		}
+		timer.addBytes(file.size());
 	};
 
 	bool ready()
 	{
-		return (fs.is_open() && fs.good());
-	};
-
-	bool getData(std::basic_string<unsigned char>& buf)
-	{
-		if (fs.is_open() && data_length) {
-			try {
-				buf.resize(data_length);
-				fs.seekg(BOMbytes[(int)bom][0], fs.beg);
-				fs.read(reinterpret_cast<char*>(&buf[0]), data_length);
-				return true;
-			}
-			catch (...) {}
-		}
-		return false;
+		return (file.size() > offset);
 	};
 
-	std::ifstream& getStream()
+	/* view of the file data without BOM, valid for the lifetime of the reader */
+	bool getData(const byte*& data, size_t& length)
 	{
-		if (fs.is_open()) {
-			fs.seekg(BOMbytes[(int)bom][0], fs.beg);
+		if (!ready()) {
+			return false;
 		}
-		return fs;
+		data = file.data() + offset;
+		length = file.size() - offset;
+		return true;
 	};
 
 	BOM getBOM() { return bom; };
 
 private:
-	std::ifstream		fs;
-	unsigned long long	data_length;
+	crypt::MappedFile	file;
+	size_t				offset;
 };
 
 class FileWriter : public File
 {
 public:
-	FileWriter(const std::string& path, BOM bom = BOM::none)
+	/* path "-": stdout */
+	FileWriter(const std::string& path, BOM bom = BOM::none) : os(&fs)
 	{
 		this->bom = bom;
 		try {
-			fs.open(path, std::ios::out | std::ios::binary);
-			fs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			if (isStdStream(path)) {
+				os = &std::cout;
+			} else {
+				fs.open(path, std::ios::out | std::ios::binary);
+				fs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			}
 			if (bom != BOM::none) {
-				fs.write((const char*)&BOMbytes[static_cast<unsigned>(bom)][1], BOMbytes[static_cast<unsigned>(bom)][0]);
+				os->write((const char*)&BOMbytes[static_cast<unsigned>(bom)][1], BOMbytes[static_cast<unsigned>(bom)][0]);
 			}
 		} catch (...) {
 			if (fs.is_open()) {
@@ -217,13 +251,14 @@ public:
 
 	bool write(const unsigned char* data, size_t length, const char* header = 0, size_t header_length = 0)
 	{
-		if (fs.is_open() && fs.good()) {
+		if ((fs.is_open() || os != &fs) && os->good()) {
+			crypt::Stats::Timer timer(crypt::Stats::Phase::write, length + header_length);
 			try {
 				if (header != NULL && header_length != 0) {
-					fs.write(header, header_length);
+					os->write(header, header_length);
 				}
-				fs.write((const char*)data, length);
-				return true;
+				os->write((const char*)data, length);
+				return os->good();
 			}
 			catch (...) {
 				if (fs.is_open()) {
@@ -234,19 +269,29 @@ public:
 		return false;
 	};
 
-	std::ofstream& getStream()
+	bool flush()
 	{
-		return fs;
+		return os->flush().good();
 	};
 
 private:
-	std::ofstream fs;
+	std::ofstream	fs;
+	std::ostream*	os;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 namespace help
 {
+	/* prompts read stdin and write stdout, not possible if the data goes through them */
+	bool interactive()
+	{
+		if (*opt.nointeraction || File::isStdStream(args.input) || (opt.output->count() && File::isStdStream(args.output))) {
+			return false;
+		}
+		return true;
+	}
+
 	bool cmpchars(const char* s1, size_t len1, const char* s2, size_t len2)
 	{
 		if (len1 <= len2) {
@@ -291,6 +336,60 @@ namespace help
 		return (d.size() > 0);
 	}
 
+	// size in bytes with optional suffix k, m or g (i.e. 64k), returns 0 on invalid input
+	size_t parseSize(const std::string& s)
+	{
+		char* end = NULL;
+		unsigned long long value = std::strtoull(s.c_str(), &end, 10);
+		if (end == s.c_str()) {
+			return 0;
+		}
+		if (*end == 'k' || *end == 'K') {
+			value *= 1024;
+			end++;
+		} else if (*end == 'm' || *end == 'M') {
+			value *= 1024 * 1024;
+			end++;
+		} else if (*end == 'g' || *end == 'G') {
+			value *= 1024 * 1024 * 1024;
+			end++;
+		}
+		if (*end != 0) {
+			return 0;
+		}
+		return (size_t)value;
+	}
+
+	bool getFormat(const std::string& s, Format& format)
+	{
+		if (s.compare("table") == 0) {
+			format = Format::table;
+		} else if (s.compare("json") == 0) {
+			format = Format::json;
+		} else if (s.compare("csv") == 0) {
+			format = Format::csv;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	// duration in seconds from milliseconds (i.e. 250 or 250ms) or seconds (i.e. 1.5s), returns 0 on invalid input
+	double parseDuration(const std::string& s)
+	{
+		char* end = NULL;
+		double value = std::strtod(s.c_str(), &end);
+		if (end == s.c_str() || !(value > 0)) {
+			return 0;
+		}
+		if (strcmp(end, "s") == 0) {
+			return value;
+		} else if (*end == 0 || strcmp(end, "ms") == 0) {
+			return value / 1000;
+		}
+		return 0;
+	}
+
 	bool getUserInput(const char* msg, crypt::UserData& data, crypt::Encoding default_enc, size_t trys, bool repeat, bool echo)
 	{
 		crypt::secure_string input1, input2;
@@ -328,9 +427,16 @@ namespace help
 
 namespace check
 {
-	/* -p --password , default encoding: utf8 */
+	/* -p --password , default encoding: utf8. --keyfile: the password as raw bytes (i.e. the key of -k hkdf or none) */
 	void password(crypt::Options::Crypt& options)
 	{
+		if (opt.keyfile->count()) {
+			crypt::MappedFile file;
+			if (!file.open(args.keyfile) || !file.size()) {
+				throw CExc(CExc::Code::keyfile_read_fail);
+			}
+			options.password.set(file.data(), file.size());
+		}
 		if (opt.password->count()) {
 			help::setUserData(args.password.c_str(), args.password.size(), options.password, crypt::Encoding::ascii);
 			for (size_t i = 0; i < args.password.size(); i++) {
@@ -338,7 +444,7 @@ namespace check
 			}
 		}
 		if (!options.password.size()) {
-			if (*opt.nointeraction) {
+			if (!help::interactive()) {
 				throw CExc(CExc::Code::password_missing);
 			}
 			if (!help::getUserInput("enter password", options.password, crypt::Encoding::ascii, 3, true, false)) {
@@ -410,6 +516,8 @@ namespace check
 			-k scrypt:13:8:3 [scrypt with N=2^13, r=8, p=3]
 			-k pbkdf2:sha3:256:1000 [pbkdf2 with sha3-256 and 1000 iterations]
 			-k bcrypt:7 [bcrypt with 2^7 iterations]
+			-k hkdf:sha2:512 [hkdf with sha2-512, the password is a key already]
+			-k none [the password is the key]
 	*/
 	void keyderivation(crypt::Options::Crypt& options)
 	{
@@ -475,6 +583,32 @@ namespace check
 				}
 				break;
 			}
+			case crypt::KeyDerivation::hkdf:
+			{
+				if (pos.size() > 1) {
+					crypt::Hash thash;
+					if (!crypt::help::getHash(&args.keyderivation[pos[1]], thash) || !crypt::help::checkProperty(thash, crypt::HMAC_SUPPORT)) {
+						throw CExc(CExc::Code::invalid_hkdf);
+					}
+					options.key.options[0] = static_cast<int>(thash);
+					if (pos.size() > 2) {
+						options.key.options[1] = std::atoi(&args.keyderivation[pos[2]]) / 8;
+					} else {
+						options.key.options[1] = crypt::help::checkHashDigest(thash, 32) ? 32 : (int)crypt::help::getHashDigestByIndex(thash, 0);
+					}
+				} else {
+					options.key.options[0] = static_cast<int>(crypt::Constants::hkdf_default_hash);
+					options.key.options[1] = crypt::Constants::hkdf_default_hash_digest;
+				}
+				break;
+			}
+			case crypt::KeyDerivation::none:
+			{
+				if (options.iv == crypt::IV::keyderivation || options.iv == crypt::IV::zero) {
+					throw CExc(CExc::Code::invalid_raw_key_iv);
+				}
+				break;
+			}
 			}
 		}
 	}
@@ -503,7 +637,7 @@ namespace check
 				help::setUserData(args.hash_key.c_str(), args.hash_key.size(), hmac.hash.key, crypt::Encoding::ascii);
 			}
 			if (!hmac.hash.key.size()) {
-				if (*opt.nointeraction) {
+				if (!help::interactive()) {
 					throw CExc(CExc::Code::hmac_key_missing);
 				}
 				if (!help::getUserInput("enter HMAC key", hmac.hash.key, crypt::Encoding::ascii, 2, true, false)) {
@@ -519,8 +653,8 @@ namespace check
 		if (opt.tag->count()) {
 			help::setUserData(args.tag.c_str(), args.tag.size(), tag, crypt::Encoding::base64);
 		}
-		if (!crypt::help::checkProperty(options.cipher, crypt::STREAM) && (options.mode == crypt::Mode::ccm || options.mode == crypt::Mode::gcm || options.mode == crypt::Mode::eax) && !tag.size()) {
-			if (*opt.nointeraction) {
+		if (!crypt::help::checkProperty(options.cipher, crypt::STREAM) && (options.mode == crypt::Mode::ccm || options.mode == crypt::Mode::gcm || options.mode == crypt::Mode::eax) && !options.segment_size && !tag.size()) {
+			if (!help::interactive()) {
 				throw CExc(CExc::Code::invalid_tag);
 			}
 			if (!help::getUserInput("please specify tag", tag, crypt::Encoding::base64, 2, false, true)) {
@@ -550,7 +684,7 @@ namespace check
 			}
 		}
 		if (decryption && (options.iv != crypt::IV::zero && options.iv != crypt::IV::keyderivation) && !iv.size()) {
-			if (*opt.nointeraction) {
+			if (!help::interactive()) {
 				throw CExc(CExc::Code::iv_missing);
 			}
 			if (!help::getUserInput("IV data missing. please specify", iv, crypt::Encoding::base64, 2, false, true)) {
@@ -567,7 +701,7 @@ namespace check
 			options.key.salt_bytes = salt.size();
 		}
 		if (options.key.salt_bytes > 0 && !salt.size()) {
-			if (*opt.nointeraction) {
+			if (!help::interactive()) {
 				throw CExc(CExc::Code::salt_missing);
 			}
 			if (!help::getUserInput("salt data missing. please specify", salt, crypt::Encoding::base64, 2, false, true)) {
@@ -576,18 +710,60 @@ namespace check
 		}
 	}
 
-	/* -s --salt [encryption] */
-	void salt(crypt::Options::Crypt& options)
+	/* -s --salt [encryption] (batch: the salt expands the key of the file from the master key) */
+	void salt(crypt::Options::Crypt& options, bool batch)
 	{
 		if (opt.salt->count()) {
 			options.key.salt_bytes = std::atoi(args.salt.c_str());
 		}
+		// none: the key is used as it is, a salt would be written to the header for nothing
+		if (options.key.algorithm == crypt::KeyDerivation::none && !batch) {
+			options.key.salt_bytes = 0;
+		}
+	}
+
+	/* --segment-size , i.e. --segment-size 64k [gcm/ccm/eax: authenticate every segment on its own] */
+	void segmentsize(crypt::Options::Crypt& options)
+	{
+		if (opt.segment_size->count()) {
+			options.segment_size = help::parseSize(args.segment_size);
+			if (options.segment_size < crypt::Constants::segment_size_min || options.segment_size > crypt::Constants::segment_size_max) {
+				throw CExc(CExc::Code::invalid_segment_size);
+			}
+		}
+	}
+
+	/* --scrypt-memory , i.e. --scrypt-memory 1G [scrypt parameters needing more scratch memory are rejected] */
+	void scryptmemory()
+	{
+		if (opt.scrypt_memory->count()) {
+			crypt::ScryptMemory settings;
+			settings.limit = help::parseSize(args.scrypt_memory);
+			if (!settings.limit) {
+				throw CExc(CExc::Code::invalid_scrypt);
+			}
+			crypt::setScryptMemory(settings);
+		}
+	}
+
+	/* -j --jobs , i.e. -j 8 [default: 1, 0: number of cores] */
+	size_t jobs()
+	{
+		if (!opt.jobs->count()) {
+			return 1;
+		}
+		char* end = NULL;
+		unsigned long value = std::strtoul(args.jobs.c_str(), &end, 10);
+		if (end == args.jobs.c_str() || *end != 0 || value > 1024) {
+			throw CExc(CExc::Code::invalid_jobs);
+		}
+		return value ? (size_t)value : std::max(std::thread::hardware_concurrency(), 1u);
 	}
 
 	/* output file */
 	void outputfile()
 	{
-		if (opt.output->count()) {
+		if (opt.output->count() && !File::isStdStream(args.output)) {
 			std::fstream f(args.output, std::ios::out | std::ios::binary);
 			if (!f.is_open()) {
 				throw CExc(CExc::Code::outputfile_write_fail);
@@ -596,17 +772,17 @@ namespace check
 		}
 	}
 
-	/* -h --hash */
-	void hash(crypt::Options::Hash& options)
+	/* -a --algorithm , i.e. -a sha3:512 (algorithm is one entry of a comma separated list) */
+	void hash(crypt::Options::Hash& options, std::string& algorithm)
 	{
 		std::vector<size_t> pos;
-		help::splitArgument(args.hash, pos, ':');
+		help::splitArgument(algorithm, pos, ':');
 
-		if (!crypt::help::getHash(args.hash.c_str(), options.algorithm)) {
+		if (!crypt::help::getHash(algorithm.c_str(), options.algorithm)) {
 			throw CExc(CExc::Code::invalid_hash);
 		}
 		if (pos.size() > 1) {
-			options.digest_length = std::atoi(&args.hash[pos[1]]) / 8;
+			options.digest_length = std::atoi(&algorithm[pos[1]]) / 8;
 			if (!crypt::help::checkHashDigest(options.algorithm, options.digest_length)) {
 				throw CExc(CExc::Code::invalid_hash);
 			}
@@ -616,7 +792,7 @@ namespace check
 
 		if (opt.hash_key->count()) {
 			if (!help::setUserData(args.hash_key.c_str(), args.hash_key.size(), options.key, crypt::Encoding::ascii)) {
-				if (*opt.nointeraction) {
+				if (!help::interactive()) {
 					throw CExc(CExc::Code::invalid_hashkey);
 				}
 				if (!help::getUserInput("enter key", options.key, crypt::Encoding::ascii, 2, true, false)) {
@@ -629,11 +805,11 @@ namespace check
 			if (!crypt::help::checkProperty(options.algorithm, crypt::KEY_SUPPORT)) {
 				if (crypt::help::checkProperty(options.algorithm, crypt::HMAC_SUPPORT)) {
 					if (!*opt.silent) {
-						std::cout << crypt::help::getString(options.algorithm) << " does not support key input. using HMAC ..." << std::endl;
+						*info << crypt::help::getString(options.algorithm) << " does not support key input. using HMAC ..." << std::endl;
 					}
 				} else {
 					if (!*opt.silent) {
-						std::cout << crypt::help::getString(options.algorithm) << " does not support key input. ignoring --hash-key ..." << std::endl;
+						*info << crypt::help::getString(options.algorithm) << " does not support key input. ignoring --hash-key ..." << std::endl;
 					}
 					options.use_key = false;
 				}
@@ -654,29 +830,41 @@ namespace print
 		size_t c_ivlen, c_blocksize;
 		getCipherInfo(options.cipher, options.mode, c_keylen, c_ivlen, c_blocksize);
 
-		std::cout << "options: " << crypt::help::getString(options.cipher) << "-" << c_keylen * 8;
+		*info << "options: " << crypt::help::getString(options.cipher) << "-" << c_keylen * 8;
 		if (!crypt::help::checkProperty(options.cipher, crypt::STREAM)) {
-			std::cout << "-" << crypt::help::getString(options.mode);
+			*info << "-" << crypt::help::getString(options.mode);
 		}
-		std::cout << ", iv: " << c_ivlen << " bytes (" << crypt::help::getString(options.iv) << "), " << crypt::help::getString(options.key.algorithm);;
+		*info << ", iv: " << c_ivlen << " bytes (" << crypt::help::getString(options.iv) << "), " << crypt::help::getString(options.key.algorithm);;
 
 		switch (options.key.algorithm) {
 		case crypt::KeyDerivation::pbkdf2:
 		{
-			std::cout << " (" << crypt::help::getString(crypt::Hash(options.key.options[0])) << "-" << options.key.options[1] * 8 << ", " << options.key.options[2] << " iterations)";
+			*info << " (" << crypt::help::getString(crypt::Hash(options.key.options[0])) << "-" << options.key.options[1] * 8 << ", " << options.key.options[2] << " iterations)";
 			break;
 		}
 		case crypt::KeyDerivation::bcrypt:
 		{
-			std::cout << " (2^" << options.key.options[0] << " iterations)";
+			*info << " (2^" << options.key.options[0] << " iterations)";
 			break;
 		}
 		case crypt::KeyDerivation::scrypt:
 		{
-			std::cout << " (N:2^" << options.key.options[0] << ", r:" << options.key.options[1] << ", p:" << options.key.options[2] << ")";
+			*info << " (N:2^" << options.key.options[0] << ", r:" << options.key.options[1] << ", p:" << options.key.options[2] << ")";
+			break;
+		}
+		case crypt::KeyDerivation::hkdf:
+		{
+			*info << " (" << crypt::help::getString(crypt::Hash(options.key.options[0])) << "-" << options.key.options[1] * 8 << ")";
+			break;
+		}
+		case crypt::KeyDerivation::none:
+			break;
 		}
+		*info << ", encoding: " << crypt::help::getString(options.encoding.enc);
+		if (options.segment_size) {
+			*info << ", segments: " << options.segment_size << " bytes";
 		}
-		std::cout << ", encoding: " << crypt::help::getString(options.encoding.enc) << std::endl;
+		*info << std::endl;
 	}
 
 	void initdata(const crypt::Options::Crypt& options, const crypt::InitData& initdata)
@@ -685,223 +873,1761 @@ namespace print
 		secure_string tstr;
 		if (options.key.salt_bytes && initdata.salt.size()) {
 			initdata.salt.get(tstr, crypt::Encoding::base64);
-			std::cout << "Salt: " << tstr << std::endl;;
+			*info << "Salt: " << tstr << std::endl;;
 		}
 		if ((options.mode == Mode::gcm || options.mode == Mode::ccm || options.mode == Mode::eax) && initdata.tag.size()) {
 			initdata.tag.get(tstr, crypt::Encoding::base64);
-			std::cout << "Tag: " << tstr << std::endl;
+			*info << "Tag: " << tstr << std::endl;
 		}
 		if (options.iv == IV::random && initdata.iv.size()) {
 			initdata.iv.get(tstr, crypt::Encoding::base64);
-			std::cout << "IV: " << tstr << std::endl;
+			*info << "IV: " << tstr << std::endl;
 		}
 	}
 
 	void outputfile()
 	{
-		if (opt.output->count()) {
-			std::cout << "output file: " << args.output << std::endl;
+		if (opt.output->count() && File::isStdStream(args.output)) {
+			*info << "output: stdout" << std::endl;
+		} else if (opt.output->count()) {
+			*info << "output file: " << args.output << std::endl;
 		}
 	}
 }
 
-void hash(const std::string& filename)
+/* -k argument for the calibrated options */
+std::string keyArgument(const crypt::Options::Crypt::Key& key)
 {
-	std::basic_string<byte>		buffer;
-	std::vector<std::string>	digests;
-	crypt::Options::Hash		options;
-	std::ostringstream			out;
-	/* default algorithms */
-	static const crypt::Hash	thashes[5] = { crypt::Hash::crc32, crypt::Hash::md5, crypt::Hash::sha1, crypt::Hash::sha2, crypt::Hash::sha3 };
-	static const size_t			thashes_digests[5] = { 4, 16, 20, 32, 32 };
-
-	if (opt.encoding->count() && !crypt::help::getEncoding(args.encoding.c_str(), options.encoding)) {
-		throw CExc(CExc::Code::invalid_encoding);
+	std::ostringstream out;
+	out << crypt::help::getString(key.algorithm);
+	switch (key.algorithm) {
+	case crypt::KeyDerivation::pbkdf2:
+		out << ":" << crypt::help::getString(crypt::Hash(key.options[0])) << ":" << key.options[1] * 8 << ":" << key.options[2];
+		break;
+	case crypt::KeyDerivation::bcrypt:
+		out << ":" << key.options[0];
+		break;
+	case crypt::KeyDerivation::scrypt:
+		out << ":" << key.options[0] << ":" << key.options[1] << ":" << key.options[2];
+		break;
+	case crypt::KeyDerivation::hkdf:
+		out << ":" << crypt::help::getString(crypt::Hash(key.options[0])) << ":" << key.options[1] * 8;
+		break;
+	case crypt::KeyDerivation::none:
+		break;
 	}
+	return out.str();
+}
 
-	if (opt.hash->count()) {
-		check::hash(options);
-		crypt::hash(options, buffer, filename);
-		digests.push_back(std::string(buffer.begin(), buffer.end()));
-		out << crypt::help::getString(options.algorithm) << "-" << options.digest_length * 8 << ": " << (const char*)buffer.c_str() << std::endl;
+std::string sizeString(size_t bytes)
+{
+	std::ostringstream out;
+	if (bytes >= 1048576) {
+		out << (bytes + 524288) / 1048576 << " MiB";
+	} else if (bytes >= 1024) {
+		out << (bytes + 512) / 1024 << " KiB";
 	} else {
-		for (size_t i = 0; i < 5; i++) {
-			options.algorithm = thashes[i];
-			options.digest_length = thashes_digests[i];
-			crypt::hash(options, buffer, filename);
-			out << crypt::help::getString(options.algorithm) << ": " << (const char*)buffer.c_str() << std::endl;
-		}
+		out << bytes << " B";
 	}
+	return out.str();
+}
 
-	if (opt.output->count()) {
-		std::string temp = out.str();
-		FileWriter fout(args.output);
-		if (!fout.write((const byte*)temp.c_str(), temp.size())) {
-			throw CExc(CExc::Code::outputfile_write_fail);
+/* i.e. calibrate --target 250ms --memory 256M [-k scrypt:14:8:2]: without -k every non-weak pbkdf2 hash, bcrypt and scrypt */
+void calibrate()
+{
+	std::vector<crypt::Options::Crypt::Key>	keys;
+	double									target = 0.25;
+	size_t									memory = 0;
+	std::ostringstream						out;
+
+	if (opt.target->count()) {
+		target = help::parseDuration(args.target);
+		if (!target) {
+			throw CExc(CExc::Code::invalid_calibration);
 		}
+	}
+	if (opt.memory->count()) {
+		memory = help::parseSize(args.memory);
+		if (!memory) {
+			throw CExc(CExc::Code::invalid_calibration);
+		}
+	}
+	if (opt.keyderivation->count()) {
+		crypt::Options::Crypt options;
+		check::keyderivation(options);
+		if (options.key.algorithm == crypt::KeyDerivation::hkdf || options.key.algorithm == crypt::KeyDerivation::none) {
+			throw CExc(CExc::Code::calibration_no_cost);
+		}
+		keys.push_back(options.key);
 	} else {
-		std::cout << out.str();
-		if (!*opt.nointeraction) {
-			std::string input;
-			std::getline(std::cin, input);
-			if (input.size()) {
-				std::transform(input.begin(), input.end(), input.begin(), ::tolower);
-				size_t i;
-				for (i = 0; i < digests.size(); i++) {
-					std::transform(digests[i].begin(), digests[i].end(), digests[i].begin(), ::tolower);
-					if (input.compare(digests[i]) == 0) {
-						break;
-					}
-				}
-				if (i == digests.size()) {
-					std::cout << "no match." << std::endl;
-				} else {
-					if (opt.hash->count()) {
-						std::cout << crypt::help::getString(options.algorithm) << " matches." << std::endl;
-					} else {
-						std::cout << crypt::help::getString(thashes[i]) << " matches." << std::endl;
-					}
-				}
+		crypt::Options::Crypt::Key key;
+		key.algorithm = crypt::KeyDerivation::pbkdf2;
+		for (size_t i = 0; i < (size_t)crypt::Hash::COUNT; i++) {
+			crypt::Hash h = crypt::Hash(i);
+			if (crypt::help::checkProperty(h, crypt::HMAC_SUPPORT) && !crypt::help::checkProperty(h, crypt::WEAK)) {
+				key.options[0] = static_cast<int>(h);
+				key.options[1] = 0;
+				keys.push_back(key);
 			}
 		}
+		key.algorithm = crypt::KeyDerivation::bcrypt;
+		keys.push_back(key);
+		keys.push_back(crypt::Options::Crypt::Key());
 	}
-}
-
-void hash(const byte* input, size_t input_length)
-{
-	std::basic_string<byte>		buffer;
-	crypt::Options::Hash		options;
-	std::ostringstream			out;
-
-	if (opt.encoding->count() && !crypt::help::getEncoding(args.encoding.c_str(), options.encoding)) {
-		throw CExc(CExc::Code::invalid_encoding);
+	if (!*opt.silent) {
+		std::cout << "target: " << target * 1000 << " ms";
+		if (memory) {
+			std::cout << ", scrypt memory: " << sizeString(memory);
+		}
+		std::cout << std::endl;
 	}
 
-	if (opt.hash->count()) {
-		check::hash(options);
-		crypt::hash(options, buffer, { { input, input_length } });
-		out << crypt::help::getString(options.algorithm) << "-" << options.digest_length * 8 << ": " << (const char*)buffer.c_str() << std::endl;
-	} else {
-		throw CExc(CExc::Code::invalid_hash);
+	for (size_t i = 0; i < keys.size(); i++) {
+		crypt::Options::Crypt::Key& key = keys[i];
+		if (key.algorithm == crypt::KeyDerivation::pbkdf2 && !key.options[1]) {
+			// default digest of the hash: 256 bit if available
+			crypt::Hash h = crypt::Hash(key.options[0]);
+			key.options[1] = crypt::help::checkHashDigest(h, 32) ? 32 : (int)crypt::help::getHashDigestByIndex(h, 0);
+		}
+		crypt::Calibration result;
+		crypt::calibrateKey(key, target, memory, result);
+		out << "-k " << keyArgument(key) << "\t" << (int)(result.seconds * 1000 + 0.5) << " ms\t";
+		out << (result.memory ? sizeString(result.memory) : "-") << std::endl;
+		if (!opt.output->count()) {
+			std::cout << out.str();
+			out.str("");
+		}
 	}
-	
+
 	if (opt.output->count()) {
 		std::string temp = out.str();
 		FileWriter fout(args.output);
 		if (!fout.write((const byte*)temp.c_str(), temp.size())) {
 			throw CExc(CExc::Code::outputfile_write_fail);
 		}
-	} else {
-		std::cout << out.str();
 	}
 }
 
-void decrypt(const byte* input, size_t input_length, File::BOM bom)
+namespace benchmark
 {
-	std::basic_string<byte>	outputData;
-	crypt::Options::Crypt	options;
-	CryptHeader::HMAC		hmac;
-	CryptHeaderReader		header(options, hmac);
-	crypt::InitData&		init(header.initData());
+	/* one row of the benchmark, seconds: mean time of one call (0 if the combination failed, i.e. ccm with more than 64 KiB) */
+	struct Result
+	{
+		Result(const char* op, const std::string& alg, size_t bytes) : operation(op), algorithm(alg), size(bytes), seconds(0) {};
+		const char*	operation;
+		std::string	algorithm;
+		size_t		size;			// input bytes, 0 for key derivations
+		double		seconds;
+	};
 
-	if (bom != File::BOM::utf8 && bom != File::BOM::none) {
-		throw CExc(CExc::Code::only_utf8_decrypt);
+	/* mean seconds of one call of f: the first call only warms up unless it already took longer than min_time */
+	template<typename F> double measure(F f, double min_time)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= min_time) {
+			return elapsed;
+		}
+		size_t runs = 0;
+		start = std::chrono::steady_clock::now();
+		do {
+			f();
+			runs++;
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (elapsed < min_time);
+		return elapsed / runs;
 	}
 
-	bool verbose = !*opt.silent;
-	bool write_to_file = (opt.output->count() > 0);
-	bool user_interaction = !*opt.nointeraction;
-	bool got_header = header.parse(input, input_length);
-
-	check::password(options);
-	check::cipher(options);
-	check::keyderivation(options);
-	check::tag(options, init.tag);
-	check::iv(options, init.iv, true);
-	check::salt(options, init.salt);
-	check::outputfile();
-	check::hmac(hmac);
+	/* writes the results as they come in, rates are MB/s (10^6 bytes) of the unencoded data */
+	class Report
+	{
+	public:
+		Report(std::ostream& stream, Format f) : out(stream), format(f), rows(0) {};
 
-	crypt::help::validateCryptOptions(options);
+		void begin(double min_time)
+		{
+			switch (format) {
+			case Format::table:
+				if (!*opt.silent) {
+					out << "cores: " << std::thread::hardware_concurrency() << ", min. time per measurement: " << min_time * 1000 << " ms" << std::endl;
+				}
+				out << std::left << std::setw(10) << "operation" << std::setw(28) << "algorithm" << std::right << std::setw(10) << "size" << std::setw(14) << "rate" << std::endl;
+				break;
+			case Format::json:
+				out << "{" << std::endl << "\t\"cores\": " << std::thread::hardware_concurrency() << "," << std::endl << "\t\"results\": [";
+				break;
+			case Format::csv:
+				out << "operation,algorithm,size,seconds,mb_per_s" << std::endl;
+				break;
+			}
+		}
 
-	if (verbose) {
-		print::outputfile();
-		print::options(options);
-		print::initdata(options, init);
-	}
+		void add(const Result& r)
+		{
+			switch (format) {
+			case Format::table:
+			{
+				std::ostringstream value;
+				if (!r.seconds) {
+					value << "failed";
+				} else if (r.size) {
+					value << std::fixed << std::setprecision(1) << r.size / r.seconds / 1e6 << " MB/s";
+				} else {
+					value << std::fixed << std::setprecision(1) << r.seconds * 1000 << " ms";
+				}
+				out << std::left << std::setw(10) << r.operation << std::setw(28) << r.algorithm << std::right << std::setw(10) << (r.size ? sizeString(r.size) : "-") << std::setw(14) << value.str() << std::endl;
+				break;
+			}
+			case Format::json:
+				out << (rows ? "," : "") << std::endl << "\t\t{ \"operation\": \"" << r.operation << "\", \"algorithm\": \"" << r.algorithm << "\", \"size\": " << r.size << ", \"seconds\": ";
+				if (r.seconds) {
+					out << r.seconds;
+				} else {
+					out << "null";
+				}
+				out << ", \"mb_per_s\": ";
+				if (r.seconds && r.size) {
+					out << r.size / r.seconds / 1e6;
+				} else {
+					out << "null";
+				}
+				out << " }";
+				break;
+			case Format::csv:
+				out << r.operation << "," << r.algorithm << "," << r.size << ",";
+				if (r.seconds) {
+					out << r.seconds;
+				}
+				out << ",";
+				if (r.seconds && r.size) {
+					out << r.size / r.seconds / 1e6;
+				}
+				out << std::endl;
+				break;
+			}
+			rows++;
+		}
 
-	if (got_header) {
-		if (hmac.enable) {
-			if (hmac.keypreset_id >= 0) {
-				std::cout << "hmac authentication skipped (presets not available)." << std::endl;
-			} else if (!header.checkHMAC()) {
-				throw CExc(CExc::Code::hmac_auth_failed);
+		void end()
+		{
+			if (format == Format::json) {
+				out << std::endl << "\t]" << std::endl << "}" << std::endl;
 			}
 		}
-		crypt::decrypt(header.encryptedData(), header.encryptedDataLength(), outputData, options, init);
-	} else {
-		crypt::decrypt(input, input_length, outputData, options, init);
+
+	private:
+		std::ostream&	out;
+		Format			format;
+		size_t			rows;
+	};
+
+	std::string cipherName(const crypt::Options::Crypt& options)
+	{
+		size_t key_length = options.key.length;
+		size_t iv_length, block_size;
+		crypt::getCipherInfo(options.cipher, options.mode, key_length, iv_length, block_size);
+		std::ostringstream name;
+		name << crypt::help::getString(options.cipher) << "-" << key_length * 8;
+		if (!crypt::help::checkProperty(options.cipher, crypt::STREAM)) {
+			name << "-" << crypt::help::getString(options.mode);
+		}
+		return name.str();
 	}
-	if (opt.output->count()) {
-		FileWriter fout(args.output, bom);
-		if (!fout.write(outputData.c_str(), outputData.size())) {
-			throw CExc(CExc::Code::outputfile_write_fail);
+
+	/* defaults of the digest length and a dummy key if one is required */
+	void prepareHash(crypt::Options::Hash& options)
+	{
+		size_t key_length;
+		if (!crypt::getHashInfo(options.algorithm, options.digest_length, key_length)) {
+			throw CExc(CExc::Code::invalid_hash);
+		}
+		if (crypt::help::checkProperty(options.algorithm, crypt::KEY_REQUIRED)) {
+			options.use_key = true;
+		}
+		if (options.use_key && key_length && options.key.size() != key_length) {
+			options.key.zero(key_length);
 		}
-	} else {
-		std::cout << outputData.c_str() << std::endl;
 	}
 }
 
-void encrypt(const byte* input, size_t input_length)
+/* i.e. bench --sizes 1k,1M --format json -o host.json [--target 100ms]: every cipher/mode, hash, encoding and the default of every key derivation.
+   with -c, -a, -e or -k only the given algorithms: -c without mode runs all modes of the cipher */
+void bench()
 {
-	std::basic_string<byte>	outputData;
-	crypt::Options::Crypt	options;
-	CryptHeader::HMAC		hmac;
-	CryptHeaderWriter		header(options, hmac);
-	crypt::InitData&		init(header.initData());
-
-	bool verbose = !*opt.silent;
-	bool create_header = !*opt.noheader;
-	bool write_to_file = (opt.output->count() > 0);
+	std::vector<size_t>					sizes = { 1024, 65536, 1048576 };
+	double								min_time = 0.1;
+	Format								format = Format::table;
+	std::vector<crypt::Options::Crypt>	ciphers;
+	std::vector<crypt::Options::Hash>	hashes;
+	std::vector<crypt::Options::Convert> encodings;
+	std::vector<crypt::Options::Crypt::Key>	keys;
+	std::ostringstream					buffer;
+
+	if (opt.sizes->count()) {
+		std::vector<size_t> pos;
+		help::splitArgument(args.sizes, pos, ',');
+		sizes.clear();
+		for (size_t i = 0; i < pos.size(); i++) {
+			size_t size = help::parseSize(&args.sizes[pos[i]]);
+			if (size < 1024 || size > 1073741824) {
+				throw CExc(CExc::Code::invalid_benchmark);
+			}
+			sizes.push_back(size);
+		}
+	}
+	if (opt.format->count() && !help::getFormat(args.format, format)) {
+		throw CExc(CExc::Code::invalid_benchmark);
+	}
+	if (opt.target->count()) {
+		min_time = help::parseDuration(args.target);
+		if (!min_time) {
+			throw CExc(CExc::Code::invalid_benchmark);
+		}
+	}
 
+	bool all = !opt.cipher->count() && !opt.hash->count() && !opt.encoding->count() && !opt.keyderivation->count();
+	if (all || opt.cipher->count()) {
+		// binary output and the cheapest key derivation: only the cipher is measured
+		crypt::Options::Crypt options;
+		options.password.set("nppcrypt-benchmark", 18, crypt::Encoding::ascii);
+		options.encoding.enc = crypt::Encoding::ascii;
+		options.key.algorithm = crypt::KeyDerivation::pbkdf2;
+		options.key.options[0] = static_cast<int>(crypt::Hash::sha2);
+		options.key.options[1] = 32;
+		options.key.options[2] = crypt::Constants::pbkdf2_iter_min;
+		size_t first = 0, last = (size_t)crypt::Cipher::COUNT;
+		bool all_modes = true;
+		if (opt.cipher->count()) {
+			all_modes = (std::count(args.cipher.begin(), args.cipher.end(), ':') < 2);
+			check::cipher(options);
+			first = (size_t)options.cipher;
+			last = first + 1;
+		}
+		for (size_t c = first; c < last; c++) {
+			options.cipher = crypt::Cipher(c);
+			size_t key_length = 0, iv_length, block_size;
+			crypt::getCipherInfo(options.cipher, options.mode, key_length, iv_length, block_size);
+			bool stream = crypt::help::checkProperty(options.cipher, crypt::STREAM);
+			if (!stream && !block_size) {
+				// btea: no usable mode of operation
+				continue;
+			}
+			if (stream || !all_modes) {
+				ciphers.push_back(options);
+				continue;
+			}
+			for (size_t m = 0; m < (size_t)crypt::Mode::COUNT; m++) {
+				options.mode = crypt::Mode(m);
+				if (crypt::help::checkCipherMode(options.cipher, options.mode)) {
+					ciphers.push_back(options);
+				}
+			}
+		}
+	}
+	if (all || opt.hash->count()) {
+		if (opt.hash->count()) {
+			std::vector<size_t> pos;
+			help::splitArgument(args.hash, pos, ',');
+			for (size_t i = 0; i < pos.size(); i++) {
+				std::string algorithm(&args.hash[pos[i]]);
+				crypt::Hash h;
+				hashes.push_back(crypt::Options::Hash());
+				// keyed hashes get a dummy key instead of the key_required error
+				if (crypt::help::getHash(algorithm.substr(0, algorithm.find(':')).c_str(), h) && crypt::help::checkProperty(h, crypt::KEY_REQUIRED)) {
+					hashes.back().use_key = true;
+				}
+				check::hash(hashes.back(), algorithm);
+			}
+		} else {
+			for (size_t i = 0; i < (size_t)crypt::Hash::COUNT; i++) {
+				hashes.push_back(crypt::Options::Hash());
+				hashes.back().algorithm = crypt::Hash(i);
+				hashes.back().digest_length = 0;
+			}
+		}
+		for (size_t i = 0; i < hashes.size(); i++) {
+			benchmark::prepareHash(hashes[i]);
+		}
+	}
+	if (all || opt.encoding->count()) {
+		crypt::Options::Crypt options;
+		check::encoding(options);
+		crypt::Options::Convert convert;
+		convert.eol = options.encoding.eol;
+		convert.linebreaks = options.encoding.linebreaks;
+		convert.linelength = (int)options.encoding.linelength;
+		convert.uppercase = options.encoding.uppercase;
+		for (size_t i = 0; i < (size_t)crypt::Encoding::COUNT; i++) {
+			convert.to = crypt::Encoding(i);
+			if (convert.to != crypt::Encoding::ascii && (!opt.encoding->count() || convert.to == options.encoding.enc)) {
+				encodings.push_back(convert);
+			}
+		}
+	}
+	if (all || opt.keyderivation->count()) {
+		if (opt.keyderivation->count()) {
+			crypt::Options::Crypt options;
+			check::keyderivation(options);
+			keys.push_back(options.key);
+		} else {
+			crypt::Options::Crypt::Key key;
+			key.algorithm = crypt::KeyDerivation::pbkdf2;
+			key.options[0] = static_cast<int>(crypt::Constants::pbkdf2_default_hash);
+			key.options[1] = crypt::Constants::pbkdf2_default_hash_digest;
+			key.options[2] = crypt::Constants::pbkdf2_iter_default;
+			keys.push_back(key);
+			key.algorithm = crypt::KeyDerivation::bcrypt;
+			key.options[0] = crypt::Constants::bcrypt_iter_default;
+			keys.push_back(key);
+			keys.push_back(crypt::Options::Crypt::Key());
+		}
+	}
+
+	// pseudo random input, every size uses the beginning of the buffer
+	std::basic_string<byte> data(*std::max_element(sizes.begin(), sizes.end()), 0);
+	std::mt19937_64 random;
+	for (size_t i = 0; i + 8 <= data.size(); i += 8) {
+		uint64_t x = random();
+		memcpy(&data[i], &x, 8);
+	}
+
+	std::ostream& out = opt.output->count() ? buffer : std::cout;
+	benchmark::Report report(out, format);
+	report.begin(min_time);
+
+	std::basic_string<byte> output, temp;
+	for (size_t i = 0; i < ciphers.size(); i++) {
+		std::string name = benchmark::cipherName(ciphers[i]);
+		for (size_t s = 0; s < sizes.size(); s++) {
+			benchmark::Result encryption("encrypt", name, sizes[s]), decryption("decrypt", name, sizes[s]);
+			crypt::InitData init;
+			try {
+				encryption.seconds = benchmark::measure([&]() { output.clear(); crypt::encrypt(data.c_str(), sizes[s], output, ciphers[i], init); }, min_time);
+				decryption.seconds = benchmark::measure([&]() { temp.clear(); crypt::decrypt(output.c_str(), output.size(), temp, ciphers[i], init); }, min_time);
+			} catch (CExc&) {
+			}
+			report.add(encryption);
+			report.add(decryption);
+		}
+	}
+	for (size_t i = 0; i < hashes.size(); i++) {
+		std::ostringstream name;
+		name << crypt::help::getString(hashes[i].algorithm) << "-" << hashes[i].digest_length * 8;
+		for (size_t s = 0; s < sizes.size(); s++) {
+			benchmark::Result result("hash", name.str(), sizes[s]);
+			try {
+				result.seconds = benchmark::measure([&]() { output.clear(); crypt::hash(hashes[i], output, { { data.c_str(), sizes[s] } }); }, min_time);
+			} catch (CExc&) {
+			}
+			report.add(result);
+		}
+	}
+	for (size_t i = 0; i < encodings.size(); i++) {
+		crypt::Options::Convert decode(encodings[i]);
+		decode.from = encodings[i].to;
+		decode.to = crypt::Encoding::ascii;
+		for (size_t s = 0; s < sizes.size(); s++) {
+			benchmark::Result encoding("encode", crypt::help::getString(encodings[i].to), sizes[s]), decoding("decode", crypt::help::getString(encodings[i].to), sizes[s]);
+			try {
+				encoding.seconds = benchmark::measure([&]() { output.clear(); crypt::convert(data.c_str(), sizes[s], output, encodings[i]); }, min_time);
+				decoding.seconds = benchmark::measure([&]() { temp.clear(); crypt::convert(output.c_str(), output.size(), temp, decode); }, min_time);
+			} catch (CExc&) {
+			}
+			report.add(encoding);
+			report.add(decoding);
+		}
+	}
+	for (size_t i = 0; i < keys.size(); i++) {
+		crypt::Options::Crypt::Key& key = keys[i];
+		if (key.algorithm == crypt::KeyDerivation::pbkdf2 && !key.options[1]) {
+			crypt::Hash h = crypt::Hash(key.options[0]);
+			key.options[1] = crypt::help::checkHashDigest(h, 32) ? 32 : (int)crypt::help::getHashDigestByIndex(h, 0);
+		}
+		benchmark::Result result("key", keyArgument(key), 0);
+		try {
+			result.seconds = benchmark::measure([&]() { crypt::measureKey(key); }, min_time);
+		} catch (CExc&) {
+		}
+		crypt::freeScryptMemory();
+		report.add(result);
+	}
+	report.end();
+
+	if (opt.output->count()) {
+		std::string text = buffer.str();
+		FileWriter fout(args.output);
+		if (!fout.write((const byte*)text.c_str(), text.size())) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+	}
+}
+
+/* --stats: time and bytes of every phase to stderr, other is the time outside of all phases (i.e. password input) */
+void stats(double total)
+{
+	if (!crypt::Stats::available()) {
+		std::cerr << "statistics are not available in this build." << std::endl;
+		return;
+	}
+	Format format = Format::table;
+	if (opt.format->count() && !help::getFormat(args.format, format)) {
+		throw CExc(CExc::Code::invalid_benchmark);
+	}
+
+	std::vector<crypt::Stats::Entry> entries;
+	double other = total;
+	for (size_t i = 0; i < (size_t)crypt::Stats::Phase::COUNT; i++) {
+		entries.push_back(crypt::Stats::get(crypt::Stats::Phase(i)));
+		other -= entries.back().seconds;
+	}
+	other = std::max(other, 0.0);
+
+	std::ostream& out = std::cerr;
+	switch (format) {
+	case Format::table:
+	{
+		out << std::left << std::setw(15) << "phase" << std::right << std::setw(12) << "time" << std::setw(9) << "share" << std::setw(11) << "bytes" << std::setw(14) << "rate" << std::endl;
+		for (size_t i = 0; i < entries.size(); i++) {
+			crypt::Stats::Phase phase = crypt::Stats::Phase(i);
+			if (!entries[i].calls) {
+				continue;
+			}
+			std::ostringstream time, share, rate;
+			time << std::fixed << std::setprecision(3) << entries[i].seconds * 1000 << " ms";
+			share << std::fixed << std::setprecision(1) << (total > 0 ? entries[i].seconds / total * 100 : 0) << "%";
+			// read: files are memory mapped, the pages are loaded by the phase that touches them first
+			if (entries[i].bytes && entries[i].seconds > 0 && phase != crypt::Stats::Phase::read && phase != crypt::Stats::Phase::keyderivation && phase != crypt::Stats::Phase::header) {
+				rate << std::fixed << std::setprecision(1) << entries[i].bytes / entries[i].seconds / 1e6 << " MB/s";
+			}
+			out << std::left << std::setw(15) << crypt::Stats::getString(phase) << std::right << std::setw(12) << time.str() << std::setw(9) << share.str();
+			out << std::setw(11) << sizeString((size_t)entries[i].bytes) << std::setw(14) << rate.str() << std::endl;
+		}
+		std::ostringstream time_other, share_other, time_total;
+		time_other << std::fixed << std::setprecision(3) << other * 1000 << " ms";
+		share_other << std::fixed << std::setprecision(1) << (total > 0 ? other / total * 100 : 0) << "%";
+		time_total << std::fixed << std::setprecision(3) << total * 1000 << " ms";
+		out << std::left << std::setw(15) << "other" << std::right << std::setw(12) << time_other.str() << std::setw(9) << share_other.str() << std::endl;
+		out << std::left << std::setw(15) << "total" << std::right << std::setw(12) << time_total.str() << std::endl;
+		break;
+	}
+	case Format::json:
+	{
+		out << "{ \"total\": " << total << ", \"other\": " << other << ", \"phases\": [";
+		for (size_t i = 0; i < entries.size(); i++) {
+			out << (i ? ", " : " ") << "{ \"phase\": \"" << crypt::Stats::getString(crypt::Stats::Phase(i)) << "\", \"seconds\": " << entries[i].seconds;
+			out << ", \"bytes\": " << entries[i].bytes << ", \"calls\": " << entries[i].calls << " }";
+		}
+		out << " ] }" << std::endl;
+		break;
+	}
+	case Format::csv:
+	{
+		out << "phase,seconds,bytes,calls" << std::endl;
+		for (size_t i = 0; i < entries.size(); i++) {
+			out << crypt::Stats::getString(crypt::Stats::Phase(i)) << "," << entries[i].seconds << "," << entries[i].bytes << "," << entries[i].calls << std::endl;
+		}
+		out << "other," << other << ",," << std::endl;
+		out << "total," << total << ",," << std::endl;
+		break;
+	}
+	}
+}
+
+/* hash of files: the algorithms of -a or the default ones */
+void hashOptions(std::vector<crypt::Options::Hash>& hashes)
+{
+	crypt::Encoding				encoding = crypt::Encoding::base16;
+	/* default algorithms */
+	static const crypt::Hash	thashes[5] = { crypt::Hash::crc32, crypt::Hash::md5, crypt::Hash::sha1, crypt::Hash::sha2, crypt::Hash::sha3 };
+	static const size_t			thashes_digests[5] = { 4, 16, 20, 32, 32 };
+
+	if (opt.encoding->count() && !crypt::help::getEncoding(args.encoding.c_str(), encoding)) {
+		throw CExc(CExc::Code::invalid_encoding);
+	}
+
+	if (opt.hash->count()) {
+		std::vector<size_t> pos;
+		help::splitArgument(args.hash, pos, ',');
+		for (size_t i = 0; i < pos.size(); i++) {
+			std::string algorithm(&args.hash[pos[i]]);
+			hashes.push_back(crypt::Options::Hash());
+			hashes.back().encoding = encoding;
+			check::hash(hashes.back(), algorithm);
+		}
+	} else {
+		for (size_t i = 0; i < 5; i++) {
+			hashes.push_back(crypt::Options::Hash());
+			hashes.back().encoding = encoding;
+			hashes.back().algorithm = thashes[i];
+			hashes.back().digest_length = thashes_digests[i];
+		}
+	}
+}
+
+void hash(const std::string& filename)
+{
+	std::vector<crypt::Options::Hash>		hashes;
+	std::vector<std::basic_string<byte>>	buffers;
+	std::vector<std::string>				digests;
+	std::ostringstream						out;
+
+	hashOptions(hashes);
+
+	// the file is read only once for all algorithms
+	if (File::isStdStream(filename)) {
+		crypt::hashMulti(hashes, buffers, std::cin);
+	} else {
+		crypt::hashMulti(hashes, buffers, filename);
+	}
+
+	for (size_t i = 0; i < hashes.size(); i++) {
+		digests.push_back(std::string(buffers[i].begin(), buffers[i].end()));
+		out << crypt::help::getString(hashes[i].algorithm);
+		if (opt.hash->count()) {
+			out << "-" << hashes[i].digest_length * 8;
+		}
+		out << ": " << digests.back() << std::endl;
+	}
+
+	if (opt.output->count()) {
+		std::string temp = out.str();
+		FileWriter fout(args.output);
+		if (!fout.write((const byte*)temp.c_str(), temp.size())) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+	} else {
+		std::cout << out.str();
+		if (help::interactive()) {
+			std::string input;
+			std::getline(std::cin, input);
+			if (input.size()) {
+				std::transform(input.begin(), input.end(), input.begin(), ::tolower);
+				size_t i;
+				for (i = 0; i < digests.size(); i++) {
+					std::transform(digests[i].begin(), digests[i].end(), digests[i].begin(), ::tolower);
+					if (input.compare(digests[i]) == 0) {
+						break;
+					}
+				}
+				if (i == digests.size()) {
+					std::cout << "no match." << std::endl;
+				} else {
+					std::cout << crypt::help::getString(hashes[i].algorithm) << " matches." << std::endl;
+				}
+			}
+		}
+	}
+}
+
+void hash(const byte* input, size_t input_length)
+{
+	std::basic_string<byte>		buffer;
+	crypt::Encoding				encoding = crypt::Encoding::base16;
+	std::ostringstream			out;
+
+	if (opt.encoding->count() && !crypt::help::getEncoding(args.encoding.c_str(), encoding)) {
+		throw CExc(CExc::Code::invalid_encoding);
+	}
+
+	if (opt.hash->count()) {
+		std::vector<size_t> pos;
+		help::splitArgument(args.hash, pos, ',');
+		for (size_t i = 0; i < pos.size(); i++) {
+			std::string algorithm(&args.hash[pos[i]]);
+			crypt::Options::Hash options;
+			options.encoding = encoding;
+			check::hash(options, algorithm);
+			crypt::hash(options, buffer, { { input, input_length } });
+			out << crypt::help::getString(options.algorithm) << "-" << options.digest_length * 8 << ": " << (const char*)buffer.c_str() << std::endl;
+		}
+	} else {
+		throw CExc(CExc::Code::invalid_hash);
+	}
+	
+	if (opt.output->count()) {
+		std::string temp = out.str();
+		FileWriter fout(args.output);
+		if (!fout.write((const byte*)temp.c_str(), temp.size())) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+	} else {
+		std::cout << out.str();
+	}
+}
+
+void decrypt(const byte* input, size_t input_length, File::BOM bom)
+{
+	std::basic_string<byte>	outputData;
+	crypt::Options::Crypt	options;
+	CryptHeader::HMAC		hmac;
+	CryptHeaderReader		header(options, hmac);
+	crypt::InitData&		init(header.initData());
+
+	if (bom != File::BOM::utf8 && bom != File::BOM::none) {
+		throw CExc(CExc::Code::only_utf8_decrypt);
+	}
+
+	bool verbose = !*opt.silent;
+	bool write_to_file = (opt.output->count() > 0);
+	bool user_interaction = !*opt.nointeraction;
+	bool got_header = header.parse(input, input_length);
+
+	check::password(options);
+	check::cipher(options);
+	check::keyderivation(options);
+	check::scryptmemory();
+	check::segmentsize(options);
+	check::tag(options, init.tag);
+	check::iv(options, init.iv, true);
+	check::salt(options, init.salt);
+	check::outputfile();
+	check::hmac(hmac);
+
+	crypt::help::validateCryptOptions(options);
+
+	if (verbose) {
+		print::outputfile();
+		print::options(options);
+		print::initdata(options, init);
+	}
+
+	if (got_header) {
+		if (hmac.enable) {
+			if (hmac.keypreset_id >= 0) {
+				*info << "hmac authentication skipped (presets not available)." << std::endl;
+			} else if (!header.checkHMAC()) {
+				throw CExc(CExc::Code::hmac_auth_failed);
+			}
+		}
+		crypt::decrypt(header.encryptedData(), header.encryptedDataLength(), outputData, options, init);
+	} else {
+		crypt::decrypt(input, input_length, outputData, options, init);
+	}
+	// outputData does not wipe itself: crypt::decrypt() reserved the space upfront, so the plaintext is in this one block
+	try {
+		if (opt.output->count()) {
+			FileWriter fout(args.output, bom);
+			if (!fout.write(outputData.c_str(), outputData.size())) {
+				throw CExc(CExc::Code::outputfile_write_fail);
+			}
+		} else {
+			// the plaintext as it is: binary data may contain zeros, no line break is appended
+			crypt::Stats::Timer timer(crypt::Stats::Phase::write, outputData.size());
+			std::cout.write((const char*)outputData.data(), outputData.size());
+			std::cout.flush();
+		}
+	} catch (...) {
+		CryptoPP::SecureWipeBuffer(&outputData[0], outputData.size());
+		throw;
+	}
+	CryptoPP::SecureWipeBuffer(&outputData[0], outputData.size());
+}
+
+void encrypt(const byte* input, size_t input_length)
+{
+	std::basic_string<byte>	outputData;
+	crypt::Options::Crypt	options;
+	CryptHeader::HMAC		hmac;
+	CryptHeaderWriter		header(options, hmac);
+	crypt::InitData&		init(header.initData());
+
+	bool verbose = !*opt.silent;
+	bool create_header = !*opt.noheader;
+	bool write_to_file = (opt.output->count() > 0);
+
+	check::password(options);
+	check::cipher(options);
+	check::iv(options, init.iv, false);
+	check::keyderivation(options);
+	check::scryptmemory();
+	check::salt(options, false);
+	check::encoding(options);
+	check::segmentsize(options);
+	check::hmac(hmac);
+	check::outputfile();
+
+	crypt::help::validateCryptOptions(options);
+
+	if (verbose) {
+		print::outputfile();
+		print::options(options);
+	}
+	
+	crypt::encrypt(input, input_length, outputData, options, header.initData());
+
+	if (create_header) {
+		header.create(outputData.c_str(), outputData.size());
+	}
+	if (write_to_file) {
+		FileWriter fout(args.output);
+		if (!fout.write(outputData.c_str(), outputData.size(), header.c_str(), header.size())) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+		if (verbose || !create_header) {
+			print::initdata(options, init);
+		}
+	} else {
+		crypt::Stats::Timer timer(crypt::Stats::Phase::write, header.size() + outputData.size());
+		if (header.size()) {
+			std::cout << header.c_str();
+		}
+		if (verbose && !create_header) {
+			print::initdata(options, init);
+		}
+		std::cout.write((const char*)outputData.data(), outputData.size());
+		// a line break would become part of binary (ascii encoded) data
+		if (options.encoding.enc != crypt::Encoding::ascii) {
+			std::cout << std::endl;
+		} else {
+			std::cout.flush();
+		}
+	}
+}
+
+/* input "-" or output "-": the data is read in blocks of stream_block_size, so memory does not grow with its size.
+   the header is written before the data, tag and hmac are only known at the end and follow the data in a trailer */
+void encryptStream(std::istream& in)
+{
+	std::basic_string<byte>	outputData;
+	crypt::Options::Crypt	options;
+	CryptHeader::HMAC		hmac;
+	CryptHeaderWriter		header(options, hmac);
+	crypt::InitData&		init(header.initData());
+
+	bool verbose = !*opt.silent;
+	bool create_header = !*opt.noheader;
+
+	check::password(options);
+	check::cipher(options);
+	check::iv(options, init.iv, false);
+	check::keyderivation(options);
+	check::scryptmemory();
+	check::salt(options, false);
+	check::encoding(options);
+	check::segmentsize(options);
+	check::hmac(hmac);
+	check::outputfile();
+
+	crypt::help::validateCryptOptions(options);
+
+	if (verbose) {
+		print::outputfile();
+		print::options(options);
+	}
+
+	bool write_to_file = (opt.output->count() > 0 && !File::isStdStream(args.output));
+
+	std::unique_ptr<FileWriter> fout(new FileWriter(opt.output->count() ? args.output : "-"));
+	try {
+		crypt::Encryptor	encryptor(options, init);
+		crypt::SecureBlock	block(stream_block_size);
+
+		if (create_header) {
+			header.createStreaming();
+			if (!fout->write(NULL, 0, header.c_str(), header.size())) {
+				throw CExc(CExc::Code::outputfile_write_fail);
+			}
+		}
+		while (true) {
+			size_t length;
+			{
+				crypt::Stats::Timer timer(crypt::Stats::Phase::read);
+				in.read((char*)block.BytePtr(), block.size());
+				if (in.bad()) {
+					throw CExc(CExc::Code::inputfile_read_fail);
+				}
+				length = (size_t)in.gcount();
+				timer.addBytes(length);
+			}
+			outputData.clear();
+			if (length) {
+				encryptor.update(block.BytePtr(), length, outputData);
+			} else {
+				encryptor.finish(outputData);
+			}
+			header.update(outputData.data(), outputData.size());
+			if (!fout->write(outputData.data(), outputData.size())) {
+				throw CExc(CExc::Code::outputfile_write_fail);
+			}
+			if (!length) {
+				break;
+			}
+		}
+		if (create_header) {
+			header.finish();
+			if (!fout->write(NULL, 0, header.trailer_c_str(), header.trailerSize())) {
+				throw CExc(CExc::Code::outputfile_write_fail);
+			}
+		}
+		if (!fout->flush()) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+		if (verbose || !create_header) {
+			print::initdata(options, init);
+		}
+	} catch (...) {
+		// no header-only or truncated output file is left behind
+		fout.reset();
+		if (write_to_file) {
+			std::remove(args.output.c_str());
+		}
+		throw;
+	}
+}
+
+/* counterpart of encryptStream(): the plaintext is written before the end of the data is reached, tag and hmac are checked at the end.
+   a failed check removes the output file, data already written to stdout can not be taken back (--segment-size authenticates every segment before it is written) */
+void decryptStream(std::istream& in)
+{
+	std::basic_string<byte>	inputData;
+	std::basic_string<byte>	outputData;
+	std::basic_string<byte>	held;
+	crypt::Options::Crypt	options;
+	CryptHeader::HMAC		hmac;
+	CryptHeaderReader		header(options, hmac);
+	crypt::InitData&		init(header.initData());
+
+	bool verbose = !*opt.silent;
+	bool write_to_file = (opt.output->count() > 0 && !File::isStdStream(args.output));
+
+	auto read = [&in, &inputData]() -> size_t {
+		crypt::Stats::Timer timer(crypt::Stats::Phase::read);
+		inputData.resize(stream_block_size);
+		in.read((char*)&inputData[0], inputData.size());
+		if (in.bad()) {
+			throw CExc(CExc::Code::inputfile_read_fail);
+		}
+		inputData.resize((size_t)in.gcount());
+		timer.addBytes(inputData.size());
+		return inputData.size();
+	};
+
+	// the first block holds the header (and the utf8 BOM of a file saved by an editor)
+	read();
+	size_t bom = 0;
+	if (inputData.size() >= BOMbytes[0][0] && std::equal(&BOMbytes[0][1], &BOMbytes[0][1] + BOMbytes[0][0], inputData.begin())) {
+		bom = BOMbytes[0][0];
+	}
+	const byte*	data = inputData.data() + bom;
+	size_t		data_length = inputData.size() - bom;
+	if (header.parse(data, data_length, false)) {
+		data = header.encryptedData();
+		data_length = header.encryptedDataLength();
+	}
+
+	check::password(options);
+	check::cipher(options);
+	check::keyderivation(options);
+	check::scryptmemory();
+	check::segmentsize(options);
+	check::tag(options, init.tag);
+	check::iv(options, init.iv, true);
+	check::salt(options, init.salt);
+	check::outputfile();
+	check::hmac(hmac);
+
+	crypt::help::validateCryptOptions(options);
+
+	if (verbose) {
+		print::outputfile();
+		print::options(options);
+	}
+
+	bool check_hmac = hmac.enable;
+	if (hmac.enable && hmac.keypreset_id >= 0) {
+		*info << "hmac authentication skipped (presets not available)." << std::endl;
+		check_hmac = false;
+	}
+
+	std::unique_ptr<FileWriter> fout(new FileWriter(opt.output->count() ? args.output : "-", bom ? File::BOM::utf8 : File::BOM::none));
+	try {
+		crypt::Decryptor decryptor(options, init);
+		size_t trailer = header.trailerLength();
+
+		auto decrypt = [&](const byte* in, size_t in_len, bool last) {
+			if (check_hmac) {
+				header.update(in, in_len);
+			}
+			outputData.clear();
+			if (last) {
+				decryptor.finish(outputData);
+			} else {
+				decryptor.update(in, in_len, outputData);
+			}
+			bool written = fout->write(outputData.data(), outputData.size());
+			CryptoPP::SecureWipeBuffer(&outputData[0], outputData.size());
+			if (!written) {
+				throw CExc(CExc::Code::outputfile_write_fail);
+			}
+		};
+
+		// the last bytes of the input (the trailer) are held back until the end is reached
+		do {
+			if (data_length >= trailer) {
+				decrypt(held.data(), held.size(), false);
+				decrypt(data, data_length - trailer, false);
+				held.assign(data + data_length - trailer, trailer);
+			} else {
+				held.append(data, data_length);
+				size_t excess = (held.size() > trailer) ? held.size() - trailer : 0;
+				decrypt(held.data(), excess, false);
+				held.erase(0, excess);
+			}
+			data_length = read();
+			data = inputData.data();
+		} while (data_length);
+
+		if (trailer) {
+			if (held.size() != trailer) {
+				throw CExc(CExc::Code::invalid_header);
+			}
+			header.parseTrailer(held.data(), held.size());
+		}
+		if (check_hmac && !header.checkHMAC()) {
+			throw CExc(CExc::Code::hmac_auth_failed);
+		}
+		decrypt(NULL, 0, true);
+		if (!fout->flush()) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+		if (verbose) {
+			print::initdata(options, init);
+		}
+	} catch (...) {
+		fout.reset();
+		if (write_to_file) {
+			std::remove(args.output.c_str());
+		}
+		throw;
+	}
+}
+
+/* --batch, --from-list: output next to the input or in the directory -o, encryption appends the extension of nppcrypt files and decryption removes it */
+std::string batchOutput(const std::string& path, bool encryption)
+{
+	static const std::string extension = std::string(".") + NPPC_DEF_FILE_EXT;
+	std::string name(path);
+	if (encryption) {
+		name.append(extension);
+	} else if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+		name.erase(name.size() - extension.size());
+	} else {
+		name.append(".decrypted");
+	}
+	if (opt.output->count()) {
+#ifdef _WIN32
+		size_t pos = name.find_last_of("/\\");
+#else
+		size_t pos = name.find_last_of('/');
+#endif
+		if (pos != std::string::npos) {
+			name.erase(0, pos + 1);
+		}
+		if (args.output.size() && args.output.back() != '/' && args.output.back() != '\\') {
+			name.insert(0, 1, '/');
+		}
+		name.insert(0, args.output);
+	}
+	return name;
+}
+
+/* --batch, --from-list, hash of several files: -j workers process the files, their messages are printed in input order.
+   files of batch_split_size bytes or more come first, one after the other with all workers inside the cipher (ctr/gcm, segments)
+   or the digest threads. the other files are grouped into tasks of about batch_group_size bytes that the workers steal from each other */
+class BatchRunner
+{
+public:
+	/* process(file, worker, threads, out): threads for Options::Crypt::threads, messages go to out, errors are thrown */
+	typedef std::function<void(size_t file, size_t worker, size_t threads, std::ostream& out)> Process;
+
+	BatchRunner(const std::vector<std::string>& files, std::ostream& messages, size_t jobs) : files(files), messages(messages), pool(jobs), next(0), failed(0)
+	{
+		results.resize(files.size());
+	}
+
+	size_t workers() const
+	{
+		return pool.size();
+	}
+
+	/* returns the number of files that failed */
+	size_t run(const Process& process)
+	{
+		// without -j the cipher keeps its own default
+		size_t split_threads = pool.size() > 1 ? pool.size() : 0;
+		size_t group_threads = pool.size() > 1 ? 1 : 0;
+
+		std::vector<size_t>					large;
+		std::vector<std::vector<size_t>>	groups;
+		size_t								group_bytes = 0;
+		for (size_t i = 0; i < files.size(); i++) {
+			struct stat buffer;
+			size_t size = (stat(files[i].c_str(), &buffer) == 0) ? (size_t)buffer.st_size : 0;
+			if (pool.size() > 1 && size >= batch_split_size) {
+				large.push_back(i);
+				continue;
+			}
+			if (!groups.size() || group_bytes >= batch_group_size || groups.back().size() >= batch_group_files) {
+				groups.push_back(std::vector<size_t>());
+				group_bytes = 0;
+			}
+			groups.back().push_back(i);
+			group_bytes += size;
+		}
+
+		for (size_t i : large) {
+			processFile(process, i, 0, split_threads);
+		}
+		pool.run(groups.size(), [&](size_t task, size_t worker) {
+			for (size_t i : groups[task]) {
+				processFile(process, i, worker, group_threads);
+			}
+		});
+		return failed;
+	}
+
+private:
+	struct Result
+	{
+		Result() : done(false) {};
+		bool		done;
+		std::string	message;
+		std::string	error;
+	};
+
+	void processFile(const Process& process, size_t file, size_t worker, size_t threads)
+	{
+		std::ostringstream	out;
+		std::string			error;
+		try {
+			process(file, worker, threads, out);
+		} catch (CExc& e) {
+			error = e.what();
+		} catch (std::exception& e) {
+			error = e.what();
+		}
+		report(file, out.str(), error);
+	}
+
+	/* prints the results of all files up to the first one still in progress */
+	void report(size_t file, const std::string& message, const std::string& error)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		results[file].done = true;
+		results[file].message = message;
+		results[file].error = error;
+		if (error.size()) {
+			failed++;
+		}
+		while (next < results.size() && results[next].done) {
+			messages << results[next].message;
+			if (results[next].error.size()) {
+				messages.flush();
+				std::cerr << "error: " << files[next] << ": " << results[next].error << std::endl;
+			}
+			results[next] = Result();
+			results[next].done = true;
+			next++;
+		}
+	}
+
+	const std::vector<std::string>&	files;
+	std::ostream&					messages;
+	crypt::WorkPool					pool;
+	std::mutex						mutex;
+	std::vector<Result>				results;
+	size_t							next;
+	size_t							failed;
+};
+
+/* --manifest: everything that ends up in the header. outputs encrypted with other options are out of date (the password: see the key check in encryptBatch) */
+std::string headerParams(const crypt::Options::Crypt& options, const CryptHeader::HMAC& hmac)
+{
+	std::ostringstream s;
+	s << (unsigned)options.cipher << ',' << (unsigned)options.mode << ',' << (unsigned)options.iv << ',' << options.segment_size << ',' << (unsigned)options.key.algorithm
+		<< ',' << options.key.length << ',' << options.key.salt_bytes;
+	for (size_t i = 0; i < 3; i++) {
+		s << ',' << options.key.options[i];
+	}
+	s << ',' << (unsigned)options.encoding.enc << ',' << options.encoding.linelength << ',' << options.encoding.linebreaks << ',' << (unsigned)options.encoding.eol
+		<< ',' << options.encoding.uppercase << ',' << hmac.enable;
+	if (hmac.enable) {
+		s << ',' << (unsigned)hmac.hash.algorithm << ',' << hmac.hash.digest_length << ',' << hmac.keypreset_id;
+	}
+	return s.str();
+}
+
+/* the password is derived only once into a master key, the key (and iv) of every file is expanded from it with hkdf and the salt of the file.
+   errors are reported per file, the other files are processed anyway (returns false if a file failed). --manifest: unchanged files are skipped
+   without a key derivation, the password is derived with the master salt of the manifest only if a file has to be encrypted. its key check
+   then tells the files that were encrypted with another password (--rekey: derived first, these files are encrypted again) */
+bool encryptBatch(const std::vector<std::string>& files)
+{
+	crypt::Options::Crypt	options;
+	CryptHeader::HMAC		hmac;
+	crypt::MasterKey		master;
+	crypt::UserData			iv;
+
+	bool verbose = !*opt.silent;
+
+	if (*opt.noheader) {
+		throw CExc(CExc::Code::batch_header_required);
+	}
 	check::password(options);
 	check::cipher(options);
-	check::iv(options, init.iv, false);
+	check::iv(options, iv, false);
 	check::keyderivation(options);
-	check::salt(options);
+	check::scryptmemory();
+	check::salt(options, true);
 	check::encoding(options);
+	check::segmentsize(options);
 	check::hmac(hmac);
-	check::outputfile();
+	size_t jobs = check::jobs();
+
+	// every file needs a salt of its own, its iv is derived along with the key unless -v says otherwise (none: random)
+	if (!options.key.salt_bytes) {
+		throw CExc(CExc::Code::invalid_salt);
+	}
+	if (!opt.iv->count()) {
+		options.iv = (options.key.algorithm == crypt::KeyDerivation::none) ? crypt::IV::random : crypt::IV::keyderivation;
+	} else if (options.iv == crypt::IV::custom) {
+		throw CExc(CExc::Code::invalid_iv);
+	}
 
 	crypt::help::validateCryptOptions(options);
 
 	if (verbose) {
-		print::outputfile();
 		print::options(options);
 	}
-	
-	crypt::encrypt(input, input_length, outputData, options, header.initData());
 
-	if (create_header) {
+	std::unique_ptr<crypt::Manifest>	state;
+	byte								params[crypt::Manifest::params_size];
+	if (opt.manifest->count()) {
+		state.reset(new crypt::Manifest());
+		if (!state->load(args.manifest)) {
+			throw CExc(CExc::Code::invalid_manifest);
+		}
+		crypt::Manifest::paramsHash(headerParams(options, hmac), params);
+		// the master salt of the files already encrypted: their key check only holds for it, changed files are encrypted with it as well
+		crypt::Manifest::Entry entry;
+		for (size_t i = 0; i < files.size(); i++) {
+			if (state->find(files[i], entry)) {
+				master.salt.set(entry.salt, sizeof(entry.salt));
+				break;
+			}
+		}
+	}
+
+	// the password is derived only once, for the first file that needs it
+	std::mutex			derive_mutex;
+	std::exception_ptr	derive_error;
+	bool				derived = false;
+	byte				check[crypt::Manifest::check_size];
+	auto masterKey = [&]() {
+		std::lock_guard<std::mutex> lock(derive_mutex);
+		if (!derived && !derive_error) {
+			try {
+				crypt::deriveMasterKey(options, master);
+				crypt::Manifest::keyCheck(master, check);
+				derived = true;
+			} catch (...) {
+				derive_error = std::current_exception();
+			}
+		}
+		if (derive_error) {
+			std::rethrow_exception(derive_error);
+		}
+	};
+	// the output of an entry was encrypted with the current master key (not with another password): derives it
+	auto sameKey = [&](const crypt::Manifest::Entry& entry) {
+		masterKey();
+		return std::memcmp(entry.salt, master.salt.BytePtr(), sizeof(entry.salt)) == 0 && std::memcmp(entry.check, check, sizeof(check)) == 0;
+	};
+
+	BatchRunner runner(files, *info, jobs);
+	std::vector<std::basic_string<byte>>	buffers(runner.workers());
+	std::atomic<size_t>						unchanged(0);
+	std::vector<char>						skipped(files.size(), 0);
+
+	size_t failed = runner.run([&](size_t file, size_t worker, size_t threads, std::ostream& out) {
+		const std::string&			path = files[file];
+		std::basic_string<byte>&	outputData = buffers[worker];
+		crypt::Options::Crypt		file_options(options);
+		CryptHeader::HMAC			file_hmac(hmac);
+		crypt::Manifest::Entry		entry;
+		const byte*					inputData = NULL;
+		size_t						inputLength = 0;
+		uint64_t					size = 0;
+		int64_t						mtime = 0;
+
+		file_options.threads = threads;
+		if (!crypt::fileStatus(path, size, mtime)) {
+			throw CExc(CExc::Code::inputfile_read_fail);
+		}
+		std::string output = batchOutput(path, true);
+
+		// --manifest: same size and mtime or same content, encrypted with the same options to the same output that still exists
+		bool found = state && state->find(path, entry);
+		bool known = found && entry.output == output && std::memcmp(entry.params, params, sizeof(params)) == 0 && entry.size == size && File::exists(output);
+		if (known && *opt.rekey && !sameKey(entry)) {
+			known = false;
+		}
+		if (known && entry.mtime == mtime) {
+			if (verbose) {
+				out << path << ": unchanged" << std::endl;
+			}
+			skipped[file] = 1;
+			unchanged++;
+			return;
+		}
+
+		FileReader fin(path);
+		// before the key derivation it would take
+		if (!fin.getData(inputData, inputLength)) {
+			throw CExc(CExc::Code::input_null);
+		}
+
+		byte hash[crypt::Manifest::hash_size];
+		if (state) {
+			crypt::Manifest::contentHash(inputData, inputLength, hash);
+			if (known && std::memcmp(entry.hash, hash, sizeof(hash)) == 0) {
+				entry.mtime = mtime;
+				state->update(path, entry);
+				if (verbose) {
+					out << path << ": unchanged" << std::endl;
+				}
+				skipped[file] = 1;
+				unchanged++;
+				return;
+			}
+		}
+
+		masterKey();
+		file_options.master = &master;
+		bool rekey = found && !sameKey(entry);
+
+		CryptHeaderWriter header(file_options, file_hmac);
+		outputData.clear();
+		crypt::encrypt(inputData, inputLength, outputData, file_options, header.initData());
 		header.create(outputData.c_str(), outputData.size());
+
+		FileWriter fout(output);
+		if (!fout.write(outputData.c_str(), outputData.size(), header.c_str(), header.size())) {
+			throw CExc(CExc::Code::outputfile_write_fail);
+		}
+		if (state) {
+			entry.size = size;
+			entry.mtime = mtime;
+			std::memcpy(entry.hash, hash, sizeof(hash));
+			std::memcpy(entry.params, params, sizeof(params));
+			std::memcpy(entry.salt, master.salt.BytePtr(), sizeof(entry.salt));
+			std::memcpy(entry.check, check, sizeof(check));
+			entry.output = output;
+			state->update(path, entry);
+		}
+		if (verbose) {
+			out << path << " -> " << output << (rekey ? " (key changed)" : "") << std::endl;
+		}
+	});
+	// the key was derived anyway: the key checks of the skipped files cost nothing
+	size_t other_key = 0;
+	if (state && derived && !*opt.rekey) {
+		crypt::Manifest::Entry entry;
+		for (size_t i = 0; i < files.size(); i++) {
+			if (skipped[i] && state->find(files[i], entry) && !sameKey(entry)) {
+				other_key++;
+			}
+		}
 	}
-	if (write_to_file) {
+	if (state && !state->save()) {
+		throw CExc(CExc::Code::manifest_write_fail);
+	}
+	if (other_key) {
+		std::cerr << "warning: " << other_key << " unchanged file" << (other_key > 1 ? "s were" : " was") << " encrypted with another password, --rekey encrypts "
+			<< (other_key > 1 ? "them" : "it") << " again." << std::endl;
+	}
+	if (verbose) {
+		*info << files.size() - failed - unchanged << " of " << files.size() << " files encrypted";
+		if (state) {
+			*info << ", " << unchanged << " unchanged";
+		}
+		*info << "." << std::endl;
+	}
+	return !failed;
+}
+
+/* the master key of every master salt found in the headers is derived only once. files that were not encrypted as part of a batch
+   still need a key derivation of their own. returns false if a file failed */
+bool decryptBatch(const std::vector<std::string>& files)
+{
+	/* derived master keys: the key options have to match as well */
+	struct Master
+	{
+		crypt::Options::Crypt::Key	key;
+		crypt::MasterKey			master;
+	};
+
+	crypt::Options::Crypt					base;
+	crypt::UserData							hmac_key;
+	std::vector<std::unique_ptr<Master>>	masters;
+	std::mutex								shared;		// masters and hmac_key: the workers ask for the hmac key and derive master keys one at a time
+
+	bool verbose = !*opt.silent;
+
+	check::password(base);
+	check::scryptmemory();
+	size_t jobs = check::jobs();
+
+	BatchRunner runner(files, *info, jobs);
+	std::vector<std::basic_string<byte>> buffers(runner.workers());
+
+	size_t failed = runner.run([&](size_t file, size_t worker, size_t threads, std::ostream& out) {
+		const std::string&			path = files[file];
+		std::basic_string<byte>&	outputData = buffers[worker];
+		crypt::Options::Crypt		options(base);
+		CryptHeader::HMAC			hmac;
+		CryptHeaderReader			header(options, hmac);
+		crypt::InitData&			init(header.initData());
+		const byte*					inputData = NULL;
+		size_t						inputLength = 0;
+
+		if (!File::exists(path)) {
+			throw CExc(CExc::Code::inputfile_read_fail);
+		}
+		FileReader fin(path);
+		if (fin.getBOM() != File::BOM::utf8 && fin.getBOM() != File::BOM::none) {
+			throw CExc(CExc::Code::only_utf8_decrypt);
+		}
+		fin.getData(inputData, inputLength);
+		if (!header.parse(inputData, inputLength)) {
+			throw CExc(CExc::Code::batch_header_required);
+		}
+		if (hmac.enable && hmac.keypreset_id >= 0) {
+			out << path << ": hmac authentication skipped (presets not available)." << std::endl;
+		} else if (hmac.enable) {
+			// the hmac key is asked for once
+			{
+				std::lock_guard<std::mutex> lock(shared);
+				if (hmac_key.size()) {
+					hmac.hash.key.set(hmac_key);
+				} else {
+					check::hmac(hmac);
+					hmac_key.set(hmac.hash.key);
+				}
+			}
+			if (!header.checkHMAC()) {
+				throw CExc(CExc::Code::hmac_auth_failed);
+			}
+		}
+		crypt::help::validateCryptOptions(options);
+
+		if (init.master_salt.size()) {
+			std::lock_guard<std::mutex> lock(shared);
+			Master* m = NULL;
+			for (auto& i : masters) {
+				if (i->master.salt.size() == init.master_salt.size() && memcmp(i->master.salt.BytePtr(), init.master_salt.BytePtr(), init.master_salt.size()) == 0
+					&& i->key.algorithm == options.key.algorithm && std::equal(i->key.options, i->key.options + 3, options.key.options)) {
+					m = i.get();
+					break;
+				}
+			}
+			if (!m) {
+				masters.emplace_back(new Master());
+				m = masters.back().get();
+				m->key = options.key;
+				m->master.salt.set(init.master_salt);
+				crypt::deriveMasterKey(options, m->master);
+			}
+			options.master = &m->master;
+		}
+
+		options.threads = threads;
+		outputData.clear();
+		crypt::decrypt(header.encryptedData(), header.encryptedDataLength(), outputData, options, init);
+		try {
+			std::string output = batchOutput(path, false);
+			FileWriter fout(output, fin.getBOM());
+			if (!fout.write(outputData.c_str(), outputData.size())) {
+				throw CExc(CExc::Code::outputfile_write_fail);
+			}
+			if (verbose) {
+				out << path << " -> " << output << std::endl;
+			}
+		} catch (...) {
+			CryptoPP::SecureWipeBuffer(&outputData[0], outputData.size());
+			throw;
+		}
+		CryptoPP::SecureWipeBuffer(&outputData[0], outputData.size());
+	});
+	if (verbose) {
+		*info << files.size() - failed << " of " << files.size() << " files decrypted." << std::endl;
+	}
+	return !failed;
+}
+
+/* checksum files as written and read by sha256sum & co: "digest  path" with one algorithm, "TAG (path) = digest" (the --tag format) with several.
+   a path with a backslash or a newline is escaped and its line starts with a backslash */
+namespace manifest
+{
+	struct Entry
+	{
+		std::string	path;
+		std::string	algorithm;		// argument of -a (i.e. sha2:256), empty: not part of the line
+		std::string	digest;			// lowercase base16
+	};
+
+	/* names of coreutils (md5sum, sha*sum, b2sum) where they exist, otherwise NAME-BITS */
+	std::string tag(crypt::Hash algorithm, size_t bits)
+	{
+		std::string name(crypt::help::getString(algorithm));
+		switch (algorithm) {
+		case crypt::Hash::md5: return "MD5";
+		case crypt::Hash::sha1: return "SHA1";
+		case crypt::Hash::sha2: return "SHA" + std::to_string(bits);
+		case crypt::Hash::sha3: return "SHA3-" + std::to_string(bits);
+		case crypt::Hash::blake2b: return (bits == 512) ? "BLAKE2b" : "BLAKE2b-" + std::to_string(bits);
+		case crypt::Hash::blake2s: return (bits == 256) ? "BLAKE2s" : "BLAKE2s-" + std::to_string(bits);
+		default: break;
+		}
+		std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+		return name + "-" + std::to_string(bits);
+	}
+
+	/* reverse of tag(): the argument of -a */
+	std::string algorithm(const std::string& tag)
+	{
+		std::string name(tag);
+		std::string bits;
+		size_t pos = tag.find_last_of('-');
+		if (pos != std::string::npos && pos + 1 < tag.size() && tag.find_first_not_of("0123456789", pos + 1) == std::string::npos) {
+			name = tag.substr(0, pos);
+			bits = tag.substr(pos + 1);
+		}
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		if (name == "md5" || name == "sha1") {
+			return name;
+		}
+		if (name.size() > 3 && name.compare(0, 3, "sha") == 0 && name[3] != '3' && name.find_first_not_of("0123456789", 3) == std::string::npos) {
+			return "sha2:" + name.substr(3);
+		}
+		return bits.size() ? name + ":" + bits : name;
+	}
+
+	/* untagged lines: the algorithm of sha*sum or md5sum with this digest length */
+	std::string algorithm(size_t hex_length)
+	{
+		switch (hex_length) {
+		case 32: return "md5";
+		case 40: return "sha1";
+		case 56: return "sha2:224";
+		case 64: return "sha2:256";
+		case 96: return "sha2:384";
+		case 128: return "sha2:512";
+		default: return "";
+		}
+	}
+
+	/* tag empty: untagged line */
+	std::string line(const std::string& tag, const std::string& digest, const std::string& path)
+	{
+		std::string name;
+		bool escaped = false;
+		for (char c : path) {
+			if (c == '\\') {
+				name.append("\\\\");
+				escaped = true;
+			} else if (c == '\n') {
+				name.append("\\n");
+				escaped = true;
+			} else {
+				name.push_back(c);
+			}
+		}
+		std::string result(escaped ? "\\" : "");
+		if (tag.size()) {
+			result.append(tag + " (" + name + ") = " + digest);
+		} else {
+			result.append(digest + "  " + name);
+		}
+		return result + "\n";
+	}
+
+	bool parse(std::string line, Entry& entry)
+	{
+		bool escaped = (line.size() && line[0] == '\\');
+		if (escaped) {
+			line.erase(0, 1);
+		}
+		size_t open = line.find(" (");
+		size_t close = line.rfind(") = ");
+		if (open != std::string::npos && close != std::string::npos && close > open && line.find(' ') == open) {
+			entry.algorithm = algorithm(line.substr(0, open));
+			entry.path = line.substr(open + 2, close - open - 2);
+			entry.digest = line.substr(close + 4);
+		} else {
+			// "digest  path" (text mode) or "digest *path" (binary mode)
+			size_t space = line.find(' ');
+			if (space == std::string::npos || space + 2 > line.size() || (line[space + 1] != ' ' && line[space + 1] != '*')) {
+				return false;
+			}
+			entry.algorithm.clear();
+			entry.digest = line.substr(0, space);
+			entry.path = line.substr(space + 2);
+		}
+		if (escaped) {
+			std::string name;
+			for (size_t i = 0; i < entry.path.size(); i++) {
+				if (entry.path[i] == '\\' && i + 1 < entry.path.size()) {
+					i++;
+					name.push_back(entry.path[i] == 'n' ? '\n' : entry.path[i]);
+				} else {
+					name.push_back(entry.path[i]);
+				}
+			}
+			entry.path = name;
+		}
+		if (!entry.path.size() || !entry.digest.size() || entry.digest.size() % 2 || entry.digest.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+			return false;
+		}
+		std::transform(entry.digest.begin(), entry.digest.end(), entry.digest.begin(), ::tolower);
+		return true;
+	}
+}
+
+/* checksum file of the files: sha256sum format with one algorithm, its --tag format with several. returns false if a file could not be read */
+bool hashBatch(const std::vector<std::string>& files)
+{
+	std::vector<crypt::Options::Hash>	hashes;
+	std::ostringstream					results;
+
+	hashOptions(hashes);
+	for (auto& h : hashes) {
+		h.encoding = crypt::Encoding::base16;
+	}
+	size_t jobs = check::jobs();
+
+	BatchRunner runner(files, opt.output->count() ? results : std::cout, jobs);
+	std::vector<std::vector<crypt::Options::Hash>>			options(runner.workers(), hashes);
+	std::vector<std::vector<std::basic_string<byte>>>		buffers(runner.workers());
+
+	size_t failed = runner.run([&](size_t file, size_t worker, size_t threads, std::ostream& out) {
+		const std::string& path = files[file];
+		if (!File::exists(path)) {
+			throw CExc(CExc::Code::inputfile_read_fail);
+		}
+		crypt::hashMulti(options[worker], buffers[worker], path, threads != 1);
+		for (size_t i = 0; i < hashes.size(); i++) {
+			std::string digest(buffers[worker][i].begin(), buffers[worker][i].end());
+			std::transform(digest.begin(), digest.end(), digest.begin(), ::tolower);
+			out << manifest::line(hashes.size() > 1 ? manifest::tag(hashes[i].algorithm, digest.size() * 4) : "", digest, path);
+		}
+	});
+
+	if (opt.output->count()) {
+		std::string temp = results.str();
 		FileWriter fout(args.output);
-		if (!fout.write(outputData.c_str(), outputData.size(), header.c_str(), header.size())) {
+		if (!fout.write((const byte*)temp.c_str(), temp.size())) {
 			throw CExc(CExc::Code::outputfile_write_fail);
 		}
-		if (verbose || !create_header) {
-			print::initdata(options, init);
+	}
+	return !failed;
+}
+
+/* hash --check: every file of the checksum file is read once for all of its algorithms. untagged lines use the first algorithm of -a
+   or the one of sha*sum/md5sum with the length of the digest. returns false if a digest did not match or a file could not be read */
+bool checkManifest()
+{
+	std::vector<std::string>						files;
+	std::vector<std::vector<manifest::Entry>>		entries;		// per file
+	std::vector<std::vector<crypt::Options::Hash>>	options;		// per file
+	std::map<std::string, size_t>					index;
+	std::string										fallback;
+	size_t											improper = 0;
+
+	std::ifstream in(args.check, std::ios::in | std::ios::binary);
+	if (!in.is_open()) {
+		throw CExc(CExc::Code::inputfile_read_fail);
+	}
+	if (opt.hash->count()) {
+		fallback = args.hash.substr(0, args.hash.find(','));
+	}
+	std::string text;
+	while (std::getline(in, text)) {
+		if (text.size() && text.back() == '\r') {
+			text.pop_back();
 		}
-	} else {
-		if (header.size()) {
-			std::cout << header.c_str();
+		manifest::Entry entry;
+		if (!text.size()) {
+			continue;
 		}
-		if (verbose && !create_header) {
-			print::initdata(options, init);
+		if (!manifest::parse(text, entry)) {
+			improper++;
+			continue;
+		}
+		if (!entry.algorithm.size()) {
+			entry.algorithm = fallback.size() ? fallback : manifest::algorithm(entry.digest.size());
+		}
+		crypt::Options::Hash hash;
+		hash.encoding = crypt::Encoding::base16;
+		try {
+			std::string temp(entry.algorithm);
+			check::hash(hash, temp);
+		} catch (CExc&) {
+			improper++;
+			continue;
+		}
+		auto i = index.find(entry.path);
+		if (i == index.end()) {
+			i = index.insert(std::make_pair(entry.path, files.size())).first;
+			files.push_back(entry.path);
+			entries.push_back(std::vector<manifest::Entry>());
+			options.push_back(std::vector<crypt::Options::Hash>());
+		}
+		entries[i->second].push_back(entry);
+		options[i->second].push_back(hash);
+	}
+	if (!files.size()) {
+		std::cerr << "error: " << args.check << ": no properly formatted checksum lines found." << std::endl;
+		return false;
+	}
+
+	size_t jobs = check::jobs();
+	BatchRunner runner(files, std::cout, jobs);
+	std::vector<std::vector<std::basic_string<byte>>>	buffers(runner.workers());
+	std::atomic<size_t>									mismatched(0);
+
+	size_t failed = runner.run([&](size_t file, size_t worker, size_t threads, std::ostream& out) {
+		const std::string& path = files[file];
+		if (!File::exists(path)) {
+			throw CExc(CExc::Code::inputfile_read_fail);
+		}
+		crypt::hashMulti(options[file], buffers[worker], path, threads != 1);
+		bool match = true;
+		for (size_t i = 0; i < entries[file].size(); i++) {
+			std::string digest(buffers[worker][i].begin(), buffers[worker][i].end());
+			std::transform(digest.begin(), digest.end(), digest.begin(), ::tolower);
+			match = match && (digest == entries[file][i].digest);
 		}
-		std::cout << outputData.c_str() << std::endl;
+		if (!match) {
+			mismatched++;
+			out << path << ": FAILED" << std::endl;
+		} else if (!*opt.silent) {
+			out << path << ": OK" << std::endl;
+		}
+	});
+
+	std::cout.flush();
+	if (improper) {
+		std::cerr << "warning: " << improper << " line" << (improper > 1 ? "s are" : " is") << " improperly formatted." << std::endl;
+	}
+	if (failed) {
+		std::cerr << "warning: " << failed << " listed file" << (failed > 1 ? "s" : "") << " could not be read." << std::endl;
+	}
+	if (mismatched) {
+		std::cerr << "warning: " << mismatched << " computed checksum" << (mismatched > 1 ? "s" : "") << " did NOT match." << std::endl;
 	}
+	return !failed && !mismatched;
 }
 
 int main(int argc, char** argv)
@@ -913,26 +2639,51 @@ int main(int argc, char** argv)
 		Action		action;
 
 		// setup CLI11 parser
-		opt.action = app.add_option("action", args.action, "(enc|dec|hash)");
-		opt.input = app.add_option("input", args.input, "input (file or string)");
-		opt.hash = app.add_option("-a,--algorithm", args.hash, "*hash-algorithm*[:Digestlength] i.e.: sha3:512 (adler32|blake2b|blake2s|cmac_aes|crc32|keccak|md2|md4|md5|ripemd|sha1|sha2|sha3|siphash24|siphash48|sm3|tiger|whirlpool)");
+		opt.action = app.add_option("action", args.action, "(enc|dec|hash|calibrate|bench)");
+		opt.input = app.add_option("input", args.input, "input (file or string), - : stdin");
+		opt.files = app.add_option("files", args.files, "--batch: further input files");
+		opt.hash = app.add_option("-a,--algorithm", args.hash, "*hash-algorithm*[:Digestlength][,...] i.e.: sha3:512 or sha2:256,sha3:512,blake2b (adler32|blake2b|blake2s|cmac_aes|crc32|keccak|md2|md4|md5|ripemd|sha1|sha2|sha3|siphash24|siphash48|sm3|tiger|whirlpool)");
 		opt.password = app.add_option("-p,--password", args.password, "[(utf8|hex|base32|base64):]*password* , default encoding: utf8");		
-		opt.output = app.add_option("-o,--output", args.output, "output file");
+		opt.output = app.add_option("-o,--output", args.output, "output file, - : stdout (enc/dec of stdin write to stdout by default)");
 		opt.cipher = app.add_option("-c,--cipher", args.cipher, "cipher[:keylength[:mode]] i.e. camellia:256:cbc, default: rijndael:256:gcm\nciphers: (threeway|aria|blowfish|btea|camellia|cast128|cast256|chacha20|des|des_ede2|des_ede3|desx|gost|idea|kalyna128|kalyna256|kalyna512|mars|panama|rc2|rc4|rc5|rc6|rijndael|saferk|safersk|salsa20|seal|seed|serpent|shacal2|shark|simon128|skipjack|sm4|sosemanuk|speck128|square|tea|threefish256|threefish512|threefish1024|twofish|wake|xsalsa20|xtea),\nmodes: (ecb|cbc|cbc_cts|cfb|ofb|ctr|eax|ccm|gcm)");
-		opt.keyderivation = app.add_option("-k,--key-derivation", args.keyderivation, "key derivation algorithm [default: scrypt]: (pbkdf2|bcrypt|scrypt)[:*option1*[:*option2*[:*option3*]]]");
+		opt.keyderivation = app.add_option("-k,--key-derivation", args.keyderivation, "key derivation algorithm [default: scrypt]: (pbkdf2|bcrypt|scrypt|hkdf|none)[:*option1*[:*option2*[:*option3*]]], hkdf and none take a key instead of a password (i.e. --keyfile), none needs a random or custom iv");
 		opt.encoding = app.add_option("-e,--encoding", args.encoding, "encoding [default:base64]: (ascii|base16|base32|base64)[:(windows|unix)[:*linelength*[:*uppercase(true|false)*]]]");
 		opt.tag = app.add_option("-t,--tag", args.tag, "tag-value: [(utf8|hex|base32|base64):]*tagdata* , default-encoding: base64");
 		opt.salt = app.add_option("-s,--salt", args.salt, "salt-value: [(utf8|hex|base32|base64):]*saltdata* , default-encoding: base64");
 		opt.iv = app.add_option("-v,--iv", args.iv, "IV: (random|keyderivation|zero) OR [(utf8|hex|base32|base64):]*ivdata* , default encoding: base64");
 		opt.hmac = app.add_option("--hmac", args.hmac, "create hmac to authenticate header and encrypted data: hash:length i.e. sha3:256");
 		opt.hash_key = app.add_option("--hash-key", args.hash_key, "hash-key: [(utf8|hex|base32|base64):]*key* , default-encoding: utf8");
+		opt.segment_size = app.add_option("--segment-size", args.segment_size, "gcm/ccm/eax: plaintext bytes per authenticated segment i.e. 1M (1k-256M, ccm: max 65535), segments can be decrypted independently");
+		opt.scrypt_memory = app.add_option("--scrypt-memory", args.scrypt_memory, "scrypt: max scratch memory i.e. 512M, fewer lanes run in parallel to stay below, larger N/r/p are rejected");
+		opt.target = app.add_option("--target", args.target, "calibrate: time of one key derivation i.e. 250ms or 1s [default: 250ms], bench: min. time per measurement [default: 100ms]");
+		opt.memory = app.add_option("--memory", args.memory, "calibrate: max scrypt scratch memory i.e. 256M");
+		opt.sizes = app.add_option("--sizes", args.sizes, "bench: buffer sizes from 1k to 1G i.e. 1k,64k,1M,64M [default: 1k,64k,1M]");
+		opt.format = app.add_option("--format", args.format, "bench, --stats: output format (table|json|csv) [default: table]");
+		opt.batch = app.add_flag("--batch", "enc/dec: several files with only one password derivation, the keys (and ivs) of the files are derived from it with hkdf. output: next to the input (." NPPC_DEF_FILE_EXT ") or in the directory -o. hash: checksum file (sha256sum format, its --tag format with several algorithms)");
+		opt.from_list = app.add_option("--from-list", args.from_list, "enc/dec/hash: like --batch, file with one input path per line");
+		opt.recursive = app.add_option("-r,--recursive", args.recursive, "hash: checksum file of all files below the directory, i.e. hash -r dir -a sha2:256 -o dir.sha256");
+		opt.check = app.add_option("--check", args.check, "hash: verify the files of a checksum file (sha256sum format or its --tag format), --silent: report only failures");
+		opt.manifest = app.add_option("--manifest", args.manifest, "enc (implies --batch): state file with size, mtime and content hash of every input, its output, the options and a check of the key. unchanged inputs are skipped, keep it next to the input");
+		opt.rekey = app.add_flag("--rekey", "enc --manifest: derive the key first and encrypt unchanged inputs again if they were encrypted with another password")->needs(opt.manifest);
+		opt.keyfile = app.add_option("--keyfile", args.keyfile, "file with the password as raw bytes, i.e. a 32 byte key for -k hkdf or -k none")->excludes(opt.password);
+		opt.jobs = app.add_option("-j,--jobs", args.jobs, "--batch, --from-list, hash of several files: worker threads [default: 1], 0: number of cores");
 		opt.noheader = app.add_flag("--noheader", "no header output");
 		opt.silent = app.add_flag("--silent", "silent mode");
 		opt.nointeraction = app.add_flag("--auto", "no user interaction");
+		opt.stats = app.add_flag("--stats", "print time and bytes of every phase (read, keyderivation, cipher, encoding, header, hmac, write) to stderr");
 
 		app.parse(argc, argv);
 
-		if (!*opt.input) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		crypt::Stats::enable(*opt.stats);
+
+		bool batch = (*opt.batch || *opt.from_list || *opt.recursive || *opt.manifest);
+
+		if (!*opt.input && args.action.compare("calibrate") == 0) {
+			action = Action::calibrate;
+		} else if (!*opt.input && args.action.compare("bench") == 0) {
+			action = Action::bench;
+		} else if (!*opt.input && !batch && !*opt.check) {
 			// if only one positional argument is present: default to hash
 			// ( can probably be done more elegantly ... )
 			action = Action::hash;
@@ -949,57 +2700,177 @@ int main(int argc, char** argv)
 			}
 		}
 		
-		std::basic_string<byte>	inputData;
-		File::BOM bom = File::BOM::none;
+		if (action == Action::calibrate) {
+			calibrate();
+			return 0;
+		} else if (action == Action::bench) {
+			bench();
+			return 0;
+		}
+
+		if (*opt.check) {
+			if (action != Action::hash) {
+				throw CExc(CExc::Code::invalid_crypt_action);
+			}
+			bool ok = checkManifest();
+			if (*opt.stats) {
+				stats(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			}
+			return ok ? 0 : 1;
+		}
 
-		if (File::exists(args.input)) {
+		// hash takes several files without --batch
+		if (*opt.files && !batch) {
 			if (action != Action::hash) {
-				FileReader fin(args.input);
-				bom = fin.getBOM();
-				if (!fin.getData(inputData)) {
+				throw CLI::ExtrasError(args.files);
+			}
+			batch = true;
+		}
+
+		if (batch) {
+			std::vector<std::string> files;
+			if (*opt.input) {
+				files.push_back(args.input);
+			}
+			files.insert(files.end(), args.files.begin(), args.files.end());
+			if (*opt.manifest && action != Action::encrypt) {
+				throw CExc(CExc::Code::invalid_crypt_action);
+			}
+			if (*opt.recursive) {
+				if (action != Action::hash) {
+					throw CExc(CExc::Code::invalid_crypt_action);
+				}
+				if (!crypt::listFiles(args.recursive, files)) {
+					throw CExc(CExc::Code::inputfile_read_fail);
+				}
+			}
+			if (opt.from_list->count()) {
+				std::ifstream list(args.from_list);
+				if (!list.is_open()) {
+					throw CExc(CExc::Code::inputfile_read_fail);
+				}
+				std::string line;
+				while (std::getline(list, line)) {
+					if (line.size() && line.back() == '\r') {
+						line.pop_back();
+					}
+					if (line.size()) {
+						files.push_back(line);
+					}
+				}
+			}
+			bool ok;
+			if (action == Action::encrypt) {
+				ok = encryptBatch(files);
+			} else if (action == Action::decrypt) {
+				ok = decryptBatch(files);
+			} else {
+				ok = hashBatch(files);
+			}
+			if (*opt.stats) {
+				stats(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			}
+			return ok ? 0 : 1;
+		}
+
+		std::unique_ptr<FileReader>	fin;
+		const byte*					inputData = (const byte*)args.input.c_str();
+		size_t						inputLength = args.input.size();
+		File::BOM bom = File::BOM::none;
+
+		// "-" on either side: the data goes through stdin/stdout in blocks, messages go to stderr
+		bool stdin_input = File::isStdStream(args.input);
+		bool stdout_output = opt.output->count() && File::isStdStream(args.output);
+		bool streaming = (action != Action::hash) && (stdin_input || stdout_output);
+		if (stdin_input || stdout_output) {
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		}
+		if (stdout_output || (streaming && !opt.output->count())) {
+			info = &std::cerr;
+		}
+
+		if (stdin_input) {
+			if (!*opt.silent) {
+				*info << "input: stdin" << std::endl;
+			}
+		} else if (File::exists(args.input)) {
+			if (action != Action::hash && !streaming) {
+				fin.reset(new FileReader(args.input));
+				bom = fin->getBOM();
+				if (!fin->getData(inputData, inputLength)) {
 					throw CExc(CExc::Code::inputfile_read_fail);
 				}
 			}
 			if (!*opt.silent) {
-				std::cout << "input (file): " << args.input << std::endl;
+				*info << "input (file): " << args.input << std::endl;
 			}
 		} else {
-			inputData.assign(args.input.begin(), args.input.end());
 			if (!*opt.silent) {
-				std::cout << "input (string): " << args.input << std::endl;
+				*info << "input (string): " << args.input << std::endl;
 			}
 		}
 
-		switch (action) {
-		case Action::hash:
-		{
-			if (File::exists(args.input)) {
-				hash(args.input);
+		if (streaming) {
+			std::unique_ptr<std::istream> source;
+			if (!stdin_input && File::exists(args.input)) {
+				source.reset(new std::ifstream(args.input, std::ios::in | std::ios::binary));
+				if (!*source) {
+					throw CExc(CExc::Code::inputfile_read_fail);
+				}
+			} else if (!stdin_input) {
+				source.reset(new std::istringstream(args.input));
+			}
+			if (action == Action::encrypt) {
+				encryptStream(source ? *source : std::cin);
 			} else {
-				hash(inputData.c_str(), inputData.size());
+				decryptStream(source ? *source : std::cin);
+			}
+		} else {
+			switch (action) {
+			case Action::hash:
+			{
+				if (stdin_input || File::exists(args.input)) {
+					hash(args.input);
+				} else {
+					hash(inputData, inputLength);
+				}
+				break;
+			}
+			case Action::decrypt:
+			{
+				decrypt(inputData, inputLength, bom);
+				break;
+			}
+			case Action::encrypt:
+			{
+				encrypt(inputData, inputLength);
+				break;
+			}
+			case Action::calibrate:
+			case Action::bench:
+				// returned above
+				break;
 			}
-			break;
-		}
-		case Action::decrypt:
-		{
-			decrypt(inputData.c_str(), inputData.size(), bom);
-			break;
-		}
-		case Action::encrypt:
-		{
-			encrypt(inputData.c_str(), inputData.size());
-			break;
 		}
+
+		if (*opt.stats) {
+			stats(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 		}
 
 	} catch (const CLI::Error &e) {
 		return app.exit(e);
 	} catch (CExc& e) {
 		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
 	} catch (std::exception& e)	{
 		std::cerr << "error:" << e.what() << std::endl;
+		return 1;
 	} catch (...) {
 		std::cerr << "unexpected error." << std::endl;
+		return 1;
 	}
 	return 0;
 }
@@ -14,15 +14,29 @@ GNU General Public License for more details.
 */
 
 #include "crypt.h"
+#include "crypt_codec.h"
+#include "crypt_file.h"
+#include "crypt_stats.h"
 #include "exception.h"
 
 #include "bcrypt/crypt_blowfish.h"
 #include "keccak/KeccakHash.h"
+#include "keccak/KeccakSpongetimes4.h"
 
 extern "C" {
 #include "scrypt/crypto_scrypt.h"
+#include "scrypt/sha256.h"
 }
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
 #define CRYPTOPP_ENABLE_NAMESPACE_WEAK 1
 
 #include "cryptopp/md5.h"
@@ -39,6 +53,7 @@ extern "C" {
 #include "cryptopp/keccak.h"
 #include "cryptopp/blake2.h"
 #include "cryptopp/hmac.h"
+#include "cryptopp/hkdf.h"
 #include "cryptopp/aes.h"
 #include "cryptopp/gcm.h"
 #include "cryptopp/ccm.h"
@@ -85,6 +100,22 @@ extern "C" {
 #include "cryptopp/adler32.h"
 #include "cryptopp/crc.h"
 #include "cryptopp/siphash.h"
+#include "cryptopp/cpu.h"
+
+// the clmul functions of gcm-simd.cpp are internal to crypto++: their declarations are those of the vendored version 7.0,
+// other versions use the portable tables of GHash
+#if CRYPTOPP_CLMUL_AVAILABLE && (CRYPTOPP_VERSION == 700)
+#define NPPC_GHASH_CLMUL 1
+namespace CryptoPP
+{
+	// gcm-simd.cpp
+	extern void GCM_SetKeyWithoutResync_CLMUL(const byte *hashKey, byte *mulTable, unsigned int tableSize);
+	extern size_t GCM_AuthenticateBlocks_CLMUL(const byte *data, size_t len, const byte *mtable, byte *hbuffer);
+	extern void GCM_ReverseHashBufferIfNeeded_CLMUL(byte *hashBuffer);
+}
+#else
+#define NPPC_GHASH_CLMUL 0
+#endif
 
 template<typename T>
 T ipow(T base, T exp)
@@ -113,7 +144,117 @@ using namespace crypt;
 
 namespace intern
 {
-	CryptoPP::PasswordBasedKeyDerivationFunction* getKeyDerivation(Hash hash, int digest)
+	/* pbkdf2 engine, same output as CryptoPP::PKCS5_PBKDF2_HMAC */
+	class PBKDF2
+	{
+	public:
+		virtual ~PBKDF2() {};
+		/* threads: max threads for independent output blocks, 0: number of cores */
+		virtual void derive(byte* out, size_t out_len, const byte* password, size_t password_len, const byte* salt, size_t salt_len, unsigned int iterations, size_t threads) = 0;
+	};
+
+	/* pbkdf2 with hmac<H>: the hash states after the ipad and opad blocks are computed once per password and copied for every iteration.
+	   the output blocks are independent and computed on several threads */
+	template <class H>
+	class PBKDF2Hash : public PBKDF2
+	{
+	public:
+		void derive(byte* out, size_t out_len, const byte* password, size_t password_len, const byte* salt, size_t salt_len, unsigned int iterations, size_t threads)
+		{
+			using namespace CryptoPP;
+			H					inner, outer;
+			const size_t		block_size = inner.BlockSize();
+			const size_t		digest = inner.DigestSize();
+			SecByteBlock		pad(block_size);
+
+			// hmac key: hashed if longer than one block, padded with zeros
+			memset(pad, 0, block_size);
+			if (password_len > block_size) {
+				inner.CalculateDigest(pad, password, password_len);
+			} else if (password_len) {
+				memcpy(pad, password, password_len);
+			}
+			for (size_t i = 0; i < block_size; i++) {
+				pad[i] ^= 0x36;
+			}
+			inner.Update(pad, block_size);
+			for (size_t i = 0; i < block_size; i++) {
+				pad[i] ^= 0x36 ^ 0x5c;
+			}
+			outer.Update(pad, block_size);
+
+			if (!iterations) {
+				iterations = 1;
+			}
+			size_t blocks = (out_len + digest - 1) / digest;
+			if (!threads) {
+				threads = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			if (iterations < (unsigned int)Constants::pbkdf2_parallel_iter) {
+				threads = 1;
+			}
+			threads = std::min(threads, blocks);
+
+			std::atomic<size_t> next(0);
+			auto work = [&]() {
+				H				h, o;
+				SecByteBlock	U(digest), T(digest);
+				byte			ivec[4];
+				size_t			b;
+				while ((b = next++) < blocks) {
+					// U_1 = PRF(P, S || INT(b + 1))
+					PutWord(false, BIG_ENDIAN_ORDER, ivec, (word32)(b + 1));
+					h = inner;
+					h.Update(salt, salt_len);
+					h.Update(ivec, 4);
+					h.Final(U);
+					o = outer;
+					o.Update(U, digest);
+					o.Final(U);
+					memcpy(T, U, digest);
+					// T = U_1 ^ U_2 ^ ... ^ U_c
+					for (unsigned int j = 1; j < iterations; j++) {
+						h = inner;
+						h.Update(U, digest);
+						h.Final(U);
+						o = outer;
+						o.Update(U, digest);
+						o.Final(U);
+						xorbuf(T, U, digest);
+					}
+					memcpy(out + b * digest, T, std::min(digest, out_len - b * digest));
+				}
+			};
+			std::vector<std::thread> workers;
+			for (size_t i = 1; i < threads; i++) {
+				workers.push_back(std::thread(work));
+			}
+			work();
+			for (size_t i = 0; i < workers.size(); i++) {
+				workers[i].join();
+			}
+		}
+	};
+
+	/* pbkdf2 with hmac-sha256: several output blocks on several cores as PBKDF2Hash, otherwise the one of scrypt
+	   (precomputed hmac states as well, sha-ni or up to eight output blocks at once with avx2) */
+	class PBKDF2SHA256 : public PBKDF2
+	{
+	public:
+		void derive(byte* out, size_t out_len, const byte* password, size_t password_len, const byte* salt, size_t salt_len, unsigned int iterations, size_t threads)
+		{
+			if (!threads) {
+				threads = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			if (threads > 1 && out_len > 32 && iterations >= (unsigned int)Constants::pbkdf2_parallel_iter) {
+				PBKDF2Hash<CryptoPP::SHA256>().derive(out, out_len, password, password_len, salt, salt_len, iterations, threads);
+			} else {
+				PBKDF2_SHA256(password, password_len, salt, salt_len, iterations ? iterations : 1, out, out_len);
+			}
+		}
+	};
+
+	PBKDF2* getKeyDerivation(Hash hash, int digest)
 	{
 		using namespace CryptoPP;
 
@@ -121,58 +262,122 @@ namespace intern
 		{
 		case Hash::keccak:
 			if (digest == 28) {
-				return new PKCS5_PBKDF2_HMAC< Keccak_224 >;
+				return new PBKDF2Hash< Keccak_224 >;
 			} else if (digest == 48) {
-				return new PKCS5_PBKDF2_HMAC< Keccak_384 >;
+				return new PBKDF2Hash< Keccak_384 >;
 			} else if (digest == 64) {
-				return new PKCS5_PBKDF2_HMAC< Keccak_512 >;
+				return new PBKDF2Hash< Keccak_512 >;
 			} else {
-				return new PKCS5_PBKDF2_HMAC< Keccak_256 >;
+				return new PBKDF2Hash< Keccak_256 >;
 			}			
 		case Hash::md2:
-			return new PKCS5_PBKDF2_HMAC<Weak::MD2>;
+			return new PBKDF2Hash<Weak::MD2>;
 		case Hash::md4:
-			return new PKCS5_PBKDF2_HMAC<Weak::MD4>;
+			return new PBKDF2Hash<Weak::MD4>;
 		case Hash::md5:
-			return new PKCS5_PBKDF2_HMAC<Weak::MD5>;
+			return new PBKDF2Hash<Weak::MD5>;
 		case Hash::ripemd:
 			if (digest == 16) {
-				return new PKCS5_PBKDF2_HMAC< RIPEMD128 >;
+				return new PBKDF2Hash< RIPEMD128 >;
 			} else if (digest == 20) {
-				return new PKCS5_PBKDF2_HMAC< RIPEMD160 >;
+				return new PBKDF2Hash< RIPEMD160 >;
 			} else if (digest == 40) {
-				return new PKCS5_PBKDF2_HMAC< RIPEMD320 >;
+				return new PBKDF2Hash< RIPEMD320 >;
 			} else {
-				return new PKCS5_PBKDF2_HMAC< RIPEMD256 >;
+				return new PBKDF2Hash< RIPEMD256 >;
 			}			
 		case Hash::sha1:
-			return new PKCS5_PBKDF2_HMAC<SHA1>;
+			return new PBKDF2Hash<SHA1>;
 		case Hash::sha2:
 			if (digest == 28) {
-				return new PKCS5_PBKDF2_HMAC< SHA224 >;
+				return new PBKDF2Hash< SHA224 >;
 			} else if (digest == 48) {
-				return new PKCS5_PBKDF2_HMAC< SHA384 >;
+				return new PBKDF2Hash< SHA384 >;
 			} else if (digest == 64) {
-				return new PKCS5_PBKDF2_HMAC< SHA512 >;
+				return new PBKDF2Hash< SHA512 >;
 			} else {
-				return new PKCS5_PBKDF2_HMAC< SHA256 >;
+				return new PBKDF2SHA256;
 			}			
 		case Hash::sha3:
 			if (digest == 28) {
-				return new PKCS5_PBKDF2_HMAC< SHA3_224 >;
+				return new PBKDF2Hash< SHA3_224 >;
 			} else if (digest == 48) {
-				return new PKCS5_PBKDF2_HMAC< SHA3_384 >;
+				return new PBKDF2Hash< SHA3_384 >;
 			} else if (digest == 64) {
-				return new PKCS5_PBKDF2_HMAC< SHA3_512 >;
+				return new PBKDF2Hash< SHA3_512 >;
 			} else {
-				return new PKCS5_PBKDF2_HMAC< SHA3_256 >;
+				return new PBKDF2Hash< SHA3_256 >;
 			}			
 		case Hash::sm3:
-			return new PKCS5_PBKDF2_HMAC< SM3 >;
+			return new PBKDF2Hash< SM3 >;
+		case Hash::tiger:
+			return new PBKDF2Hash< Tiger >;
+		case Hash::whirlpool:
+			return new PBKDF2Hash< Whirlpool >;
+		}
+		return NULL;
+	}
+
+	CryptoPP::KeyDerivationFunction* getHKDF(Hash hash, int digest)
+	{
+		using namespace CryptoPP;
+
+		switch (hash)
+		{
+		case Hash::keccak:
+			if (digest == 28) {
+				return new HKDF< Keccak_224 >;
+			} else if (digest == 48) {
+				return new HKDF< Keccak_384 >;
+			} else if (digest == 64) {
+				return new HKDF< Keccak_512 >;
+			} else {
+				return new HKDF< Keccak_256 >;
+			}
+		case Hash::md2:
+			return new HKDF<Weak::MD2>;
+		case Hash::md4:
+			return new HKDF<Weak::MD4>;
+		case Hash::md5:
+			return new HKDF<Weak::MD5>;
+		case Hash::ripemd:
+			if (digest == 16) {
+				return new HKDF< RIPEMD128 >;
+			} else if (digest == 20) {
+				return new HKDF< RIPEMD160 >;
+			} else if (digest == 40) {
+				return new HKDF< RIPEMD320 >;
+			} else {
+				return new HKDF< RIPEMD256 >;
+			}
+		case Hash::sha1:
+			return new HKDF<SHA1>;
+		case Hash::sha2:
+			if (digest == 28) {
+				return new HKDF< SHA224 >;
+			} else if (digest == 48) {
+				return new HKDF< SHA384 >;
+			} else if (digest == 64) {
+				return new HKDF< SHA512 >;
+			} else {
+				return new HKDF< SHA256 >;
+			}
+		case Hash::sha3:
+			if (digest == 28) {
+				return new HKDF< SHA3_224 >;
+			} else if (digest == 48) {
+				return new HKDF< SHA3_384 >;
+			} else if (digest == 64) {
+				return new HKDF< SHA3_512 >;
+			} else {
+				return new HKDF< SHA3_256 >;
+			}
+		case Hash::sm3:
+			return new HKDF< SM3 >;
 		case Hash::tiger:
-			return new PKCS5_PBKDF2_HMAC< Tiger >;
+			return new HKDF< Tiger >;
 		case Hash::whirlpool:
-			return new PKCS5_PBKDF2_HMAC< Whirlpool >;
+			return new HKDF< Whirlpool >;
 		}
 		return NULL;
 	}
@@ -1068,18 +1273,82 @@ namespace intern
 		return NULL;
 	}
 
-	void calcKey(CryptoPP::SecByteBlock& key, const UserData& password, const UserData& salt, const crypt::Options::Crypt::Key& opt)
+	/* scrypt scratch memory of the current thread, enlarged on demand and wiped/freed on thread exit */
+	class ScryptWorkspace
+	{
+	public:
+		ScryptWorkspace() { scrypt_workspace_init(&ws, 0); };
+		~ScryptWorkspace() { scrypt_workspace_free(&ws); };
+		/* narrow: one lane per thread at a time, changing it keeps the memory */
+		scrypt_workspace* get(const ScryptMemory& settings, bool narrow)
+		{
+			int flags = (settings.hugepages ? SCRYPT_WORKSPACE_HUGEPAGES : 0) | (settings.lock ? SCRYPT_WORKSPACE_LOCK : 0);
+			if (flags != (ws.flags & ~SCRYPT_WORKSPACE_NARROW)) {
+				scrypt_workspace_free(&ws);
+				scrypt_workspace_init(&ws, flags);
+			}
+			ws.flags = flags | (narrow ? SCRYPT_WORKSPACE_NARROW : 0);
+			return &ws;
+		}
+		void free()
+		{
+			scrypt_workspace_free(&ws);
+		}
+	private:
+		scrypt_workspace ws;
+	};
+
+	thread_local ScryptWorkspace	scrypt_workspace_local;
+	std::mutex						scrypt_memory_mutex;
+	ScryptMemory					scrypt_memory;
+
+	/* scratch memory scrypt needs within limit: first one lane per thread at a time (no multi-lane smix), then fewer threads.
+	   returns 0 if even a single lane does not fit */
+	size_t scryptBudget(uint64_t N, int r, int p, size_t limit, size_t& threads, bool& narrow)
+	{
+		threads = std::min(threads, (size_t)p);
+		narrow = false;
+		size_t memory = crypto_scrypt_memory(N, r, p, (uint32_t)threads, 0);
+		while (limit && memory > limit && (!narrow || threads > 1)) {
+			if (!narrow) {
+				narrow = true;
+			} else {
+				threads--;
+			}
+			memory = crypto_scrypt_memory(N, r, p, (uint32_t)threads, narrow ? SCRYPT_WORKSPACE_NARROW : 0);
+		}
+		if (limit && memory > limit) {
+			return 0;
+		}
+		return memory;
+	}
+
+	/* hkdf (rfc 5869) with the hmac of hash: the password has to be a key already, only the salt makes the keys of two encryptions differ */
+	void hkdf(SecureBlock& key, const UserData& password, const UserData& salt, Hash hash, int digest)
+	{
+		static const byte info[] = { 'n', 'p', 'p', 'c', 'r', 'y', 'p', 't' };
+		std::unique_ptr<CryptoPP::KeyDerivationFunction> kdf(getHKDF(hash, digest));
+		if (!kdf || key.size() > kdf->MaxDerivedLength()) {
+			throw CExc(CExc::Code::invalid_hkdf);
+		}
+		kdf->DeriveKey(&key[0], key.size(), password.BytePtr(), password.size(),
+			CryptoPP::MakeParameters("Salt", CryptoPP::ConstByteArrayParameter(salt.BytePtr(), salt.size()))("Info", CryptoPP::ConstByteArrayParameter(info, sizeof(info))));
+	}
+
+	/* memory: scrypt settings to use instead of the ones of setScryptMemory() */
+	void calcKey(SecureBlock& key, const UserData& password, const UserData& salt, const crypt::Options::Crypt::Key& opt, size_t threads = 1, const ScryptMemory* memory = NULL)
 	{
 		using namespace CryptoPP;
+		Stats::Timer timer(Stats::Phase::keyderivation, key.size());
 		switch (opt.algorithm)
 		{
 		case KeyDerivation::pbkdf2:
 		{
-			std::unique_ptr<PasswordBasedKeyDerivationFunction> pbkdf2(getKeyDerivation(Hash(opt.options[0]), opt.options[1]));
+			std::unique_ptr<PBKDF2> pbkdf2(getKeyDerivation(Hash(opt.options[0]), opt.options[1]));
 			if (!pbkdf2) {
 				throw CExc(CExc::Code::invalid_pbkdf2_hash);
 			}
-			pbkdf2->DeriveKey(&key[0], key.size(), password.BytePtr(), password.size(),	MakeParameters(Name::Salt(), ConstByteArrayParameter(salt.BytePtr(), salt.size()))("Iterations", opt.options[2]));
+			pbkdf2->derive(&key[0], key.size(), password.BytePtr(), password.size(), salt.BytePtr(), salt.size(), (unsigned int)opt.options[2], threads);
 			break;
 		}
 		case KeyDerivation::bcrypt:
@@ -1092,7 +1361,7 @@ namespace intern
 			}
 			memset(output, 0, sizeof(output));
 			// _crypt_blowfish_rn need 0-terminated password...
-			std::string temp(password.size() + 1, 0);
+			secure_string temp(password.size() + 1, 0);
 			memcpy(&temp[0], password.BytePtr(), password.size());
 			if (_crypt_blowfish_rn(temp.c_str(), settings, output, 64) == NULL) {
 				throw CExc(CExc::Code::bcrypt_failed);
@@ -1103,21 +1372,527 @@ namespace intern
 			memset(output, 0, sizeof(output));
 			memset(settings, 0, sizeof(settings));
 			memset(hashdata, 0, sizeof(hashdata));
-			for (size_t i = 0; i < temp.size(); i++) {
-				temp[i] = 0;
-			}
 			break;
 		}
 		case KeyDerivation::scrypt:
 		{
-			if (crypto_scrypt(password.BytePtr(), password.size(), salt.BytePtr(), salt.size(), ipow(2, opt.options[0]), opt.options[1], opt.options[2], &key[0], key.size()) != 0) {
+			// the p lanes are independent: one thread each, 0 threads means number of cores
+			if (!threads) {
+				threads = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			ScryptMemory settings;
+			if (memory) {
+				settings = *memory;
+			} else {
+				std::lock_guard<std::mutex> lock(scrypt_memory_mutex);
+				settings = scrypt_memory;
+			}
+			// check the budget before anything is allocated, fewer lanes in parallel need less memory
+			uint64_t N = ipow<uint64_t>(2, opt.options[0]);
+			bool narrow;
+			if (!scryptBudget(N, opt.options[1], opt.options[2], settings.limit, threads, narrow)) {
+				throw CExc(CExc::Code::scrypt_memory_limit);
+			}
+			if (crypto_scrypt_ws(password.BytePtr(), password.size(), salt.BytePtr(), salt.size(), N, opt.options[1], opt.options[2], &key[0], key.size(), (uint32_t)threads, scrypt_workspace_local.get(settings, narrow)) != 0) {
 				throw CExc(CExc::Code::scrypt_failed);
 			}
 			break;
 		}
+		case KeyDerivation::hkdf:
+		{
+			hkdf(key, password, salt, Hash(opt.options[0]), opt.options[1]);
+			break;
+		}
+		case KeyDerivation::none:
+		{
+			if (password.size() != key.size()) {
+				throw CExc(CExc::Code::invalid_raw_key);
+			}
+			memcpy(&key[0], password.BytePtr(), key.size());
+			break;
+		}
+		}
+	}
+
+	/* batch: key (and iv) of one encryption from the master key and the salt of the data */
+	void expandKey(SecureBlock& key, const SecureBlock& master, const UserData& salt)
+	{
+		static const byte info[] = { 'n', 'p', 'p', 'c', 'r', 'y', 'p', 't', '-', 'b', 'a', 't', 'c', 'h' };
+		Stats::Timer timer(Stats::Phase::keyderivation, key.size());
+		CryptoPP::HKDF<CryptoPP::SHA256> hkdf;
+		hkdf.DeriveKey(&key[0], key.size(), master.data(), master.size(), salt.BytePtr(), salt.size(), info, sizeof(info));
+	}
+
+	/* seconds of one derivation with a dummy password and salt */
+	double timeKey(const crypt::Options::Crypt::Key& opt, size_t threads, const ScryptMemory* memory = NULL)
+	{
+		SecureBlock				key(opt.length ? opt.length : 32);
+		UserData				password("nppcrypt-calibration", Encoding::ascii);
+		UserData				salt;
+		salt.zero(16);
+		auto start = std::chrono::steady_clock::now();
+		calcKey(key, password, salt, opt, threads, memory);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/* searches opt.options[index] in [min, max] so that one derivation takes about target seconds and returns the measured time.
+	   exponent: the cost doubles with every step, else it grows linearly with the parameter */
+	double searchKey(crypt::Options::Crypt::Key& opt, size_t index, int min, int max, bool exponent, double target, size_t threads, const ScryptMemory* memory = NULL)
+	{
+		int		lo = 0, hi = 0;
+		double	t_lo = 0, t_hi = 0;
+		int		x = min;
+
+		// grow the parameter using the measured times until a derivation takes longer than target
+		while (true) {
+			opt.options[index] = x;
+			double t = timeKey(opt, threads, memory);
+			if (t > target) {
+				hi = x;
+				t_hi = t;
+				break;
+			}
+			lo = x;
+			t_lo = t;
+			if (x >= max) {
+				break;
+			}
+			double f = (t > 0) ? target / t : 64.0;
+			if (exponent) {
+				x += std::max(1, std::min(4, (int)std::floor(std::log2(f))));
+			} else {
+				x = (int)std::min((double)max, x * std::max(1.25, std::min(64.0, f)));
+				x = std::max(x, lo + 1);
+			}
+			x = std::min(x, max);
+		}
+		// bisection between the last derivation below and the first above target (linear: until 3% apart)
+		while (lo && hi && hi - lo > 1 && (exponent || hi - lo > lo / 32)) {
+			int mid = lo + (hi - lo) / 2;
+			opt.options[index] = mid;
+			double t = timeKey(opt, threads, memory);
+			if (t > target) {
+				hi = mid;
+				t_hi = t;
+			} else {
+				lo = mid;
+				t_lo = t;
+			}
+		}
+		// the closer one of both, compared as ratio
+		if (!hi || (lo && target / t_lo <= t_hi / target)) {
+			opt.options[index] = lo;
+			return t_lo;
+		}
+		opt.options[index] = hi;
+		return t_hi;
+	}
+
+	/* translates the exception currently handled into CExc */
+	void rethrow()
+	{
+		try {
+			throw;
+		} catch (CryptoPP::Exception& exc) {
+			switch (exc.GetErrorType()) {
+			case CryptoPP::Exception::NOT_IMPLEMENTED: throw CExc(CExc::Code::cryptopp_not_implemented); break;
+			case CryptoPP::Exception::INVALID_ARGUMENT: throw CExc(CExc::Code::cryptopp_invalid_argument); break;
+			case CryptoPP::Exception::CANNOT_FLUSH: throw CExc(CExc::Code::cryptopp_cannot_flush); break;
+			case CryptoPP::Exception::DATA_INTEGRITY_CHECK_FAILED: throw CExc(CExc::Code::cryptopp_bad_integrity); break;
+			case CryptoPP::Exception::INVALID_DATA_FORMAT: throw CExc(CExc::Code::cryptopp_invalid_data); break;
+			case CryptoPP::Exception::IO_ERROR: throw CExc(CExc::Code::cryptopp_io_error); break;
+			default: throw CExc(CExc::Code::cryptopp_other); break;
+			}
+		} catch (CExc&) {
+			throw;
+		} catch (...) {
+			throw CExc(CExc::Code::unexpected);
+		}
+	}
+
+	/* returns attachment itself for ascii */
+	CryptoPP::BufferedTransformation* getEncoder(const crypt::Options::Crypt::Encoding& enc, CryptoPP::BufferedTransformation* attachment)
+	{
+		if (enc.enc == Encoding::ascii) {
+			return attachment;
+		}
+		// unlike crypto++ Base64Encoder the last line is not terminated by an eol
+		size_t linelength = enc.linebreaks ? enc.linelength : 0;
+		return new Codec::Encoder(enc.enc, enc.uppercase, linelength, Strings::eol[(int)enc.eol], false, attachment);
+	}
+
+	/* returns attachment itself for ascii */
+	CryptoPP::BufferedTransformation* getDecoder(crypt::Encoding enc, CryptoPP::BufferedTransformation* attachment)
+	{
+		if (enc == Encoding::ascii) {
+			return attachment;
+		}
+		return new Codec::Decoder(enc, attachment);
+	}
+
+	/* bytes written by Codec::Encoder for bin_length bytes, linelength 0: no line breaks */
+	size_t encodedLength(crypt::Encoding enc, size_t bin_length, size_t linelength, size_t eol_length, bool terminate)
+	{
+		size_t chars;
+		switch (enc)
+		{
+		case Encoding::base16: chars = 2 * bin_length; break;
+		case Encoding::base32: chars = (8 * bin_length + 4) / 5; break;
+		case Encoding::base64: chars = 4 * ((bin_length + 2) / 3); break;
+		default: return bin_length;
+		}
+		size_t eols = (linelength && chars) ? (chars - 1) / linelength : 0;
+		if (terminate) {
+			eols++;
+		}
+		return chars + eols * eol_length;
+	}
+
+	/* max bytes Codec::Decoder returns for length characters */
+	size_t decodedLength(crypt::Encoding enc, size_t length)
+	{
+		switch (enc)
+		{
+		case Encoding::base16: return length / 2;
+		case Encoding::base32: return length / 8 * 5 + (length % 8) * 5 / 8;
+		case Encoding::base64: return length / 4 * 3 + (length % 4) * 3 / 4;
+		default: return length;
+		}
+	}
+
+	/* input bytes per step of the span versions of encrypt() and decrypt(): enough to keep all workers of Parallel and Segments busy */
+	size_t spanStep(const crypt::Options::Crypt& options)
+	{
+		size_t threads = options.threads ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+		return threads * std::max(Constants::parallel_segment_size, options.segment_size);
+	}
+
+	/* zeroes the whole capacity of a buffer without a wiping allocator that held plaintext */
+	void wipe(std::basic_string<byte>& s)
+	{
+		s.resize(s.capacity());
+		CryptoPP::SecureWipeBuffer(&s[0], s.size());
+		s.clear();
+	}
+
+	/* appends temp to out + written and clears it */
+	void spanCopy(std::basic_string<byte>& temp, byte* out, size_t out_len, size_t& written)
+	{
+		if (temp.size() > out_len - written) {
+			throw CExc(CExc::Code::output_buffer_too_small);
+		}
+		if (temp.size()) {
+			std::memcpy(out + written, temp.data(), temp.size());
+			written += temp.size();
+			temp.clear();
+		}
+	}
+
+	/* passes its input on unchanged and counts the time of the attached filters as phase (--stats) */
+	class StatsFilter : public CryptoPP::Bufferless<CryptoPP::Filter>
+	{
+	public:
+		StatsFilter(Stats::Phase p, CryptoPP::BufferedTransformation* attachment, bool count_bytes = true) : phase(p), count(count_bytes)
+		{
+			Detach(attachment);
+		}
+
+		size_t Put2(const byte* in, size_t length, int messageEnd, bool blocking)
+		{
+			Stats::Timer timer(phase, count ? length : 0);
+			return AttachedTransformation()->Put2(in, length, messageEnd, blocking);
+		}
+
+	private:
+		Stats::Phase	phase;
+		bool			count;
+	};
+
+	/* end of the filter chains of Encryptor and Decryptor: appends to the output of the running update()/finish() call
+	   or hands the data to process, so nothing is collected in between */
+	class OutputSink : public CryptoPP::Bufferless<CryptoPP::Sink>
+	{
+	public:
+		typedef std::function<void(const byte*, size_t, std::basic_string<byte>&)> Process;
+
+		OutputSink(std::basic_string<byte>*& out, const Process& p = Process()) : target(out), process(p)
+		{
+		}
+
+		size_t Put2(const byte* in, size_t length, int messageEnd, bool blocking)
+		{
+			if (process) {
+				process(in, length, *target);
+			} else {
+				target->append(in, length);
+			}
+			return 0;
+		}
+
+	private:
+		std::basic_string<byte>*&	target;
+		Process						process;
+	};
+
+	/* GHASH of gcm (NIST SP 800-38D). uses the clmul code of cryptopp if available, otherwise 4-bit tables.
+	   the state is passed in by the caller, so one instance can be shared by several threads */
+	class GHash
+	{
+	public:
+		GHash(const byte* h)
+		{
+			std::memcpy(hkey, h, 16);
+#if NPPC_GHASH_CLMUL
+			if (CryptoPP::HasCLMUL()) {
+				CryptoPP::GCM_SetKeyWithoutResync_CLMUL(hkey, mtable, (unsigned int)mtable.size());
+				return;
+			}
+#endif
+			uint64_t vh = CryptoPP::GetWord<uint64_t>(false, CryptoPP::BIG_ENDIAN_ORDER, h);
+			uint64_t vl = CryptoPP::GetWord<uint64_t>(false, CryptoPP::BIG_ENDIAN_ORDER, h + 8);
+			HH[0] = HL[0] = 0;
+			HH[8] = vh;
+			HL[8] = vl;
+			for (int i = 4; i > 0; i >>= 1) {
+				uint64_t t = (vl & 1) ? 0xe100000000000000ULL : 0;
+				vl = (vh << 63) | (vl >> 1);
+				vh = (vh >> 1) ^ t;
+				HH[i] = vh;
+				HL[i] = vl;
+			}
+			for (int i = 2; i <= 8; i <<= 1) {
+				for (int j = 1; j < i; j++) {
+					HH[i + j] = HH[i] ^ HH[j];
+					HL[i + j] = HL[i] ^ HL[j];
+				}
+			}
+		}
+
+		/* y = (((y ^ x1) * H ^ x2) * H ...), len must be a multiple of 16 */
+		void update(byte* y, const byte* data, size_t len) const
+		{
+#if NPPC_GHASH_CLMUL
+			if (CryptoPP::HasCLMUL()) {
+				CryptoPP::FixedSizeAlignedSecBlock<byte, 16> buf;
+				std::memcpy(buf, y, 16);
+				CryptoPP::GCM_ReverseHashBufferIfNeeded_CLMUL(buf);
+				CryptoPP::GCM_AuthenticateBlocks_CLMUL(data, len, mtable, buf);
+				CryptoPP::GCM_ReverseHashBufferIfNeeded_CLMUL(buf);
+				std::memcpy(y, buf, 16);
+				return;
+			}
+#endif
+			static const uint64_t last4[16] = {
+				0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+				0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+			};
+			byte x[16];
+			for (size_t offset = 0; offset < len; offset += 16) {
+				for (int i = 0; i < 16; i++) {
+					x[i] = y[i] ^ data[offset + i];
+				}
+				uint64_t zh = HH[x[15] & 0xf];
+				uint64_t zl = HL[x[15] & 0xf];
+				for (int i = 15; i >= 0; i--) {
+					byte lo = x[i] & 0xf;
+					byte hi = x[i] >> 4;
+					byte rem;
+					if (i != 15) {
+						rem = (byte)(zl & 0xf);
+						zl = (zh << 60) | (zl >> 4);
+						zh = (zh >> 4) ^ (last4[rem] << 48) ^ HH[lo];
+						zl ^= HL[lo];
+					}
+					rem = (byte)(zl & 0xf);
+					zl = (zh << 60) | (zl >> 4);
+					zh = (zh >> 4) ^ (last4[rem] << 48) ^ HH[hi];
+					zl ^= HL[hi];
+				}
+				CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, y, zh);
+				CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, y + 8, zl);
+			}
+		}
+
+		/* out = a * b in GF(2^128), bitwise: only used to combine partial hashes */
+		static void multiply(const byte* a, const byte* b, byte* out)
+		{
+			uint64_t vh = CryptoPP::GetWord<uint64_t>(false, CryptoPP::BIG_ENDIAN_ORDER, b);
+			uint64_t vl = CryptoPP::GetWord<uint64_t>(false, CryptoPP::BIG_ENDIAN_ORDER, b + 8);
+			uint64_t zh = 0, zl = 0;
+			for (int i = 0; i < 128; i++) {
+				if (a[i / 8] & (0x80 >> (i % 8))) {
+					zh ^= vh;
+					zl ^= vl;
+				}
+				uint64_t t = (vl & 1) ? 0xe100000000000000ULL : 0;
+				vl = (vh << 63) | (vl >> 1);
+				vh = (vh >> 1) ^ t;
+			}
+			CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, out, zh);
+			CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, out + 8, zl);
+		}
+
+		/* out = H^n */
+		void power(uint64_t n, byte* out) const
+		{
+			byte base[16];
+			std::memcpy(base, hkey, 16);
+			std::memset(out, 0, 16);
+			out[0] = 0x80;
+			while (n) {
+				if (n & 1) {
+					multiply(out, base, out);
+				}
+				multiply(base, base, base);
+				n >>= 1;
+			}
+		}
+
+	private:
+		CryptoPP::FixedSizeAlignedSecBlock<byte, 16>	hkey;		// read with aligned loads by GCM_SetKeyWithoutResync_CLMUL
+#if NPPC_GHASH_CLMUL
+		CryptoPP::FixedSizeAlignedSecBlock<byte, 128>	mtable;
+#endif
+		uint64_t	HH[16];
+		uint64_t	HL[16];
+	};
+
+	void encodeDigest(const CryptoPP::SecByteBlock& digest, crypt::Encoding enc, std::basic_string<byte>& buffer)
+	{
+		using namespace CryptoPP;
+
+		buffer.clear();
+		switch (enc)
+		{
+		case crypt::Encoding::ascii:
+		{
+			buffer.assign(digest.begin(), digest.end());
+			break;
+		}
+		case crypt::Encoding::base16:
+		{
+			StringSource(&digest[0], digest.size(), true, new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), true, 0));
+			break;
+		}
+		case crypt::Encoding::base32:
+		{
+			StringSource(&digest[0], digest.size(), true, new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), true, 0));
+			break;
+		}
+		case crypt::Encoding::base64:
+		{
+			StringSource(&digest[0], digest.size(), true, new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), false));
+			break;
+		}
+		}
+	}
+
+	/* hashMulti(): one transformation per algorithm, checked like hash() does */
+	void createHashes(std::vector<crypt::Options::Hash>& options, std::vector<std::unique_ptr<CryptoPP::HashTransformation>>& hashes)
+	{
+		for (crypt::Options::Hash& o : options) {
+			size_t keylength;
+			if (!crypt::getHashInfo(o.algorithm, o.digest_length, keylength)) {
+				throw CExc(CExc::Code::invalid_hash);
+			}
+			if (keylength != 0 && o.use_key && o.key.size() != keylength) {
+				throw CExc(CExc::Code::invalid_keylength);
+			}
+			hashes.emplace_back(getHashTransformation(o));
+			if (!hashes.back()) {
+				throw CExc(CExc::Code::invalid_hash);
+			}
+		}
+	}
+
+	void finalHashes(std::vector<crypt::Options::Hash>& options, std::vector<std::unique_ptr<CryptoPP::HashTransformation>>& hashes, std::vector<std::basic_string<byte>>& buffers)
+	{
+		buffers.resize(options.size());
+		for (size_t i = 0; i < hashes.size(); i++) {
+			CryptoPP::SecByteBlock digest(hashes[i]->DigestSize());
+			hashes[i]->Final(digest);
+			encodeDigest(digest, options[i].encoding, buffers[i]);
 		}
 	}
 
+	/* -- blocks of a file shared by several consumers: a slot is refilled after every consumer released it -- */
+	class HashRing
+	{
+	public:
+		HashRing(size_t slots, size_t block_size, size_t consumers)
+			: blocks(slots), lengths(slots, 0), pending(slots, 0), consumers(consumers), head(0), closed(false)
+		{
+			// file contents are not wiped: the key of keyed hashes never passes the ring
+			for (auto& b : blocks) {
+				b.reset(new byte[block_size]);
+			}
+		}
+
+		/* producer: next free slot, waits for the slowest consumer */
+		byte* acquire()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			size_t slot = head % blocks.size();
+			cv.wait(lock, [&] { return pending[slot] == 0; });
+			return blocks[slot].get();
+		}
+
+		void publish(size_t len)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				size_t slot = head % blocks.size();
+				lengths[slot] = len;
+				pending[slot] = consumers;
+				head++;
+			}
+			cv.notify_all();
+		}
+
+		void close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				closed = true;
+			}
+			cv.notify_all();
+		}
+
+		/* consumer: block number pos, false if there are no more blocks */
+		bool get(uint64_t pos, const byte*& data, size_t& len)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&] { return pos < head || closed; });
+			if (pos >= head) {
+				return false;
+			}
+			data = blocks[pos % blocks.size()].get();
+			len = lengths[pos % blocks.size()];
+			return true;
+		}
+
+		void release(uint64_t pos)
+		{
+			bool empty;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				empty = (--pending[pos % blocks.size()] == 0);
+			}
+			if (empty) {
+				cv.notify_all();
+			}
+		}
+
+	private:
+		std::vector<std::unique_ptr<byte[]>>	blocks;
+		std::vector<size_t>						lengths;
+		std::vector<size_t>						pending;
+		size_t									consumers;
+		uint64_t								head;
+		bool									closed;
+		std::mutex								mutex;
+		std::condition_variable					cv;
+	};
 }
 // ===========================================================================================================================================================================================
 
@@ -1645,205 +2420,446 @@ bool crypt::getHashInfo(Hash h, size_t& length, size_t& keylength)
 	return true;
 }
 
-void crypt::encrypt(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Crypt& options, InitData& init)
+/* -- ctr and gcm with the keystream of counter-aligned segments generated by several threads. the gcm hash of every segment is calculated
+	  by its thread as well and afterwards combined with the help of H^(blocks per segment). the output is identical to cryptopp's gcm -- */
+class crypt::CryptStream::Parallel
 {
-	using namespace CryptoPP;
-
-	if (!in || !in_len) {
-		throw CExc(CExc::Code::input_null);
+public:
+	Parallel(const Options::Crypt& options, const byte* key, size_t key_len, const byte* iv, size_t iv_len, size_t block_size, bool encryption)
+		: gcm(options.mode == Mode::gcm), encryption(encryption), threads(options.threads), offset(0), aad_length(0)
+	{
+		if (!threads) {
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		for (size_t i = 0; i < threads; i++) {
+			workers.emplace_back(intern::getSymmetricCipher(options.cipher, Mode::ctr, true));
+			if (!workers.back()) {
+				throw CExc(CExc::Code::invalid_mode);
+			}
+		}
+		if (!gcm) {
+			workers[0]->SetKeyWithIV(key, key_len, iv, iv_len);
+			counter.Assign(iv, iv_len);
+			for (size_t i = 1; i < threads; i++) {
+				workers[i]->SetKeyWithIV(key, key_len, iv, iv_len);
+			}
+			return;
+		}
+		if (block_size != 16) {
+			throw CExc(CExc::Code::invalid_mode);
+		}
+		std::unique_ptr<CryptoPP::SymmetricCipher> ecb(intern::getSymmetricCipher(options.cipher, Mode::ecb, true));
+		if (!ecb) {
+			throw CExc(CExc::Code::invalid_mode);
+		}
+		ecb->SetKey(key, key_len);
+		byte h[16] = { 0 };
+		ecb->ProcessData(h, h, 16);
+		ghash.reset(new intern::GHash(h));
+
+		// J0 and the first counter block as done by CryptoPP::GCM_Base::Resync()
+		byte j0[16] = { 0 };
+		if (iv_len == 12) {
+			std::memcpy(j0, iv, 12);
+			j0[15] = 1;
+		} else {
+			CryptoPP::SecByteBlock temp(iv_len + (16 - iv_len % 16) % 16 + 16);
+			std::memset(temp, 0, temp.size());
+			std::memcpy(temp, iv, iv_len);
+			CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, temp.data() + temp.size() - 8, (uint64_t)iv_len * 8);
+			ghash->update(j0, temp, temp.size());
+		}
+		ecb->ProcessData(ej0, j0, 16);
+		CryptoPP::IncrementCounterByOne(j0, 16);
+		counter.Assign(j0, 16);
+		for (size_t i = 0; i < threads; i++) {
+			workers[i]->SetKeyWithIV(key, key_len, j0, 16);
+		}
+		ghash->power(Constants::parallel_segment_size / 16, hseg);
+		std::memset(y, 0, 16);
 	}
-	
-	SecByteBlock		tKey;
-	const byte*			ptVec = NULL;
-	const byte*			ptSalt = NULL;
-	size_t				key_len = options.key.length;
-	size_t				block_size, iv_len;
 
-	getCipherInfo(options.cipher, options.mode, key_len, iv_len, block_size);
+	size_t chunkSize() const
+	{
+		return threads * Constants::parallel_segment_size;
+	}
 
-	// --------------------------- prepare salt vector:
-	if (options.key.salt_bytes > 0)	{
-		if (options.key.algorithm == KeyDerivation::bcrypt && options.key.salt_bytes != 16) {
-			throw CExc(CExc::Code::invalid_bcrypt_saltlength);
-		}
-		init.salt.random(options.key.salt_bytes);
-		ptSalt = init.salt.BytePtr();
+	/* gcm: additional authenticated data, before any call to process() */
+	void authenticate(const byte* aad, size_t len)
+	{
+		aad_length += len;
+		hashPadded(aad, len);
 	}
-	// --------------------------- prepare iv & key vector
-	if (options.iv == crypt::IV::keyderivation)	{
-		tKey.resize(key_len + iv_len);
-		if (iv_len > 0) {
-			ptVec = &tKey[key_len];
+
+	void process(const byte* in, size_t len, std::basic_string<byte>& out)
+	{
+		if (gcm && tail.size()) {
+			size_t n = std::min(16 - tail.size(), len);
+			tail.append(in, n);
+			in += n;
+			len -= n;
+			if (tail.size() < 16) {
+				return;
+			}
+			processBlocks(tail.data(), 16, out);
+			tail.clear();
+		}
+		size_t bulk = gcm ? len - len % 16 : len;
+		processBlocks(in, bulk, out);
+		if (bulk < len) {
+			tail.assign(in + bulk, len - bulk);
 		}
-	} else if (options.iv == crypt::IV::random)	{
-		tKey.resize(key_len);
-		if (iv_len > 0)	{
-			init.iv.random(iv_len);
-			ptVec = init.iv.BytePtr();
+	}
+
+	/* gcm: returns the tag, the last incomplete block is appended to out */
+	void finish(std::basic_string<byte>& out, byte* tag, size_t tag_size)
+	{
+		if (!gcm) {
+			return;
+		}
+		if (tail.size()) {
+			size_t pos = out.size();
+			out.resize(pos + tail.size());
+			segment(0, tail.data(), &out[pos], tail.size(), offset);
+			hashPadded(encryption ? &out[pos] : tail.data(), tail.size());
+			offset += tail.size();
+			tail.clear();
+		}
+		byte lengths[16];
+		CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, lengths, (uint64_t)aad_length * 8);
+		CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, lengths + 8, (uint64_t)offset * 8);
+		ghash->update(y, lengths, 16);
+		for (size_t i = 0; i < tag_size && i < 16; i++) {
+			tag[i] = y[i] ^ ej0[i];
 		}
-	} else if (options.iv == crypt::IV::zero) {
-		tKey.resize(key_len);
-		if (iv_len)	{
-			init.iv.zero(iv_len);
-			ptVec = init.iv.BytePtr();
+	}
+
+private:
+	/* encrypts len bytes at stream position pos with worker w, gcm only increments the lower 32 bit of the counter */
+	void segment(size_t w, const byte* in, byte* out, size_t len, uint64_t pos)
+	{
+		CryptoPP::SymmetricCipher& cipher = *workers[w];
+		if (!gcm) {
+			cipher.Resynchronize(counter, (int)counter.size());
+			cipher.Seek(pos);
+			cipher.ProcessData(out, in, len);
+			return;
+		}
+		uint32_t low = CryptoPP::GetWord<uint32_t>(false, CryptoPP::BIG_ENDIAN_ORDER, counter.data() + 12) + (uint32_t)(pos / 16);
+		byte block[16];
+		std::memcpy(block, counter, 12);
+		while (len) {
+			// cryptopp's ctr mode carries into the upper 96 bit, so stop at the wrap-around of the lower 32 bit
+			size_t n = (size_t)std::min<uint64_t>(len, (((uint64_t)1 << 32) - low) * 16);
+			CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, block + 12, low);
+			cipher.Resynchronize(block, 16);
+			cipher.ProcessData(out, in, n);
+			in += n;
+			out += n;
+			len -= n;
+			low += (uint32_t)(n / 16);
 		}
-	} else if (options.iv == crypt::IV::custom) {
-		tKey.resize(key_len);
-		if (iv_len != init.iv.size()) {
-			throw CExc(CExc::Code::invalid_iv);
+	}
+
+	void hashPadded(const byte* data, size_t len)
+	{
+		size_t full = len - len % 16;
+		ghash->update(y, data, full);
+		if (full < len) {
+			byte last[16] = { 0 };
+			std::memcpy(last, data + full, len - full);
+			ghash->update(y, last, 16);
 		}
-		ptVec = init.iv.BytePtr();
 	}
-	intern::calcKey(tKey, options.password, init.salt, options.key);
 
-	try	{
-		if (block_size && (options.mode == Mode::gcm || options.mode == Mode::ccm || options.mode == Mode::eax)) {
-			std::unique_ptr<AuthenticatedSymmetricCipher> penc(intern::getAuthenticatedCipher(options.cipher, options.mode, true));
-			if (!penc) {
-				throw CExc(CExc::Code::invalid_mode);
+	void processBlocks(const byte* in, size_t len, std::basic_string<byte>& out)
+	{
+		const size_t seg_size = Constants::parallel_segment_size;
+		size_t pos = out.size();
+		out.resize(pos + len);
+		while (len) {
+			size_t count = std::min(threads, (len + seg_size - 1) / seg_size);
+			std::vector<std::thread>			pool;
+			std::vector<std::exception_ptr>		errors(count);
+			std::vector<CryptoPP::FixedSizeSecBlock<byte, 16>> partials(count);
+
+			auto job = [&](size_t i) {
+				try {
+					size_t seg_offset = i * seg_size;
+					size_t seg_len = std::min(seg_size, len - seg_offset);
+					byte* seg_out = &out[pos + seg_offset];
+					segment(i, in + seg_offset, seg_out, seg_len, offset + seg_offset);
+					if (gcm) {
+						std::memset(partials[i], 0, 16);
+						ghash->update(partials[i], encryption ? seg_out : in + seg_offset, seg_len);
+					}
+				} catch (...) {
+					errors[i] = std::current_exception();
+				}
+			};
+			for (size_t i = 1; i < count; i++) {
+				pool.emplace_back(job, i);
 			}
-			int tag_size;
-			switch (options.mode)
-			{
-			case Mode::gcm: tag_size = Constants::gcm_tag_size; break;
-			case Mode::ccm: tag_size = Constants::ccm_tag_size;  break;
-			case Mode::eax: tag_size = Constants::eax_tag_size;  break;
+			job(0);
+			for (auto& t : pool) {
+				t.join();
+			}
+			for (auto& e : errors) {
+				if (e) {
+					std::rethrow_exception(e);
+				}
 			}
 
-			penc->SetKeyWithIV(tKey.data(), key_len, ptVec, iv_len);
-			if (penc->NeedsPrespecifiedDataLengths()) {
-				penc->SpecifyDataLengths(init.salt.size() + init.iv.size(), in_len, 0);
+			size_t done = std::min(len, count * seg_size);
+			if (gcm) {
+				for (size_t i = 0; i < count; i++) {
+					size_t seg_len = std::min(seg_size, done - i * seg_size);
+					if (seg_len == seg_size) {
+						intern::GHash::multiply(y, hseg, y);
+					} else {
+						byte hpow[16];
+						ghash->power(seg_len / 16, hpow);
+						intern::GHash::multiply(y, hpow, y);
+					}
+					for (int k = 0; k < 16; k++) {
+						y[k] ^= partials[i][k];
+					}
+				}
 			}
+			in += done;
+			pos += done;
+			offset += done;
+			len -= done;
+		}
+	}
 
-			AuthenticatedEncryptionFilter ef(*penc, NULL, false, tag_size );
-			std::basic_string<byte> temp;
-			if (options.encoding.enc == Encoding::ascii) {
-				ef.Attach(new StringSinkTemplate<std::basic_string<byte>>(buffer));
-			} else {
-				ef.Attach(new StringSinkTemplate<std::basic_string<byte>>(temp));
+	bool										gcm;
+	bool										encryption;
+	size_t										threads;
+	uint64_t									offset;
+	uint64_t									aad_length;
+	std::vector<std::unique_ptr<CryptoPP::SymmetricCipher>>	workers;
+	std::unique_ptr<intern::GHash>				ghash;
+	CryptoPP::SecByteBlock						counter;
+	CryptoPP::FixedSizeSecBlock<byte, 16>		y;
+	CryptoPP::FixedSizeSecBlock<byte, 16>		ej0;
+	CryptoPP::FixedSizeSecBlock<byte, 16>		hseg;
+	std::basic_string<byte, std::char_traits<byte>, SecureAllocator<byte>>	tail;
+};
+
+/* -- gcm/ccm/eax in independently authenticated segments of Options::Crypt::segment_size bytes, every segment carries its own tag.
+	  the nonce of segment i is the iv xor the big-endian index, the last byte marks the final segment (as in the STREAM construction),
+	  so segments can neither be reordered nor truncated. consecutive segments are processed by several threads -- */
+class crypt::CryptStream::Segments
+{
+public:
+	Segments(const Options::Crypt& options, const byte* key, size_t key_len, const byte* iv, size_t iv_len, const byte* aad, size_t aad_len, size_t tag_size, bool encryption)
+		: encryption(encryption), size(options.segment_size), tag_size(tag_size), index(0), key(key, key_len), nonce(iv, iv_len), aad(aad, aad_len)
+	{
+		size_t threads = options.threads;
+		if (!threads) {
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		for (size_t i = 0; i < threads; i++) {
+			workers.emplace_back(intern::getAuthenticatedCipher(options.cipher, options.mode, encryption));
+			if (!workers.back()) {
+				throw CExc(CExc::Code::invalid_mode);
 			}
+		}
+		keyed.resize(threads, 0);
+	}
 
-			ef.ChannelPut( AAD_CHANNEL, init.salt.BytePtr(), init.salt.size());
-			ef.ChannelPut( AAD_CHANNEL, init.iv.BytePtr(), init.iv.size());
-			ef.ChannelMessageEnd( AAD_CHANNEL );
-			ef.ChannelPut(DEFAULT_CHANNEL, in, in_len);
-			ef.ChannelMessageEnd( DEFAULT_CHANNEL );
+	/* input bytes per segment */
+	size_t unitSize() const
+	{
+		return encryption ? size : size + tag_size;
+	}
 
-			switch (options.encoding.enc)
-			{
-			case Encoding::ascii:
-			{
-				init.tag.set(buffer.data() + buffer.size() - tag_size, tag_size);
-				buffer.resize(buffer.size() - tag_size);
-				break;
-			}
-			case Encoding::base16: case Encoding::base32:
-			{
-				int linelength = options.encoding.linebreaks ? (int)options.encoding.linelength : 0;
-				if (options.encoding.enc == Encoding::base16) {
-					StringSource(temp.data(), temp.size() - tag_size, true, new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer),
-						options.encoding.uppercase, linelength, Strings::eol[(int)options.encoding.eol]));
-				} else {
-					StringSource(temp.data(), temp.size() - tag_size, true, new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer),
-						options.encoding.uppercase, linelength, Strings::eol[(int)options.encoding.eol]));
-				}
-				init.tag.set(temp.data() + temp.size() - tag_size, tag_size);
-				break;
-			}
-			case Encoding::base64:
-			{
-				StringSource(temp.data(), temp.size() - tag_size, true, new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer),
-					options.encoding.linebreaks, (int)options.encoding.linelength, CryptoPP::EOL(options.encoding.eol)));
-				if (options.encoding.linebreaks) {
-					buffer.pop_back();
-					if (options.encoding.eol == crypt::EOL::windows) {
-						buffer.pop_back();
+	/* input bytes processed by all threads at once */
+	size_t batchSize() const
+	{
+		return workers.size() * unitSize();
+	}
+
+	void seek(size_t segment)
+	{
+		index = segment;
+	}
+
+	/* in has to consist of complete segments unless last is set: then the remainder (possibly empty) is the final segment */
+	void process(const byte* in, size_t len, bool last, std::basic_string<byte>& out)
+	{
+		const size_t unit = unitSize();
+		size_t count = (len + unit - 1) / unit;
+		if (last && !count) {
+			count = 1;
+		}
+		if ((!last && len % unit) || (uint64_t)index + count > 0xFFFFFFFFu) {
+			throw CExc(CExc::Code::unexpected);
+		}
+		if (!encryption && len < (count - 1) * unit + tag_size) {
+			throw CExc(CExc::Code::authentication_failed);
+		}
+		size_t pos = out.size();
+		out.resize(pos + (encryption ? len + count * tag_size : len - count * tag_size));
+		try {
+			for (size_t first = 0; first < count; first += workers.size()) {
+				size_t n = std::min(workers.size(), count - first);
+				std::vector<std::thread>			pool;
+				std::vector<std::exception_ptr>		errors(n);
+
+				auto job = [&](size_t w) {
+					try {
+						size_t k = first + w;
+						size_t in_len = std::min(unit, len - k * unit);
+						byte* seg_out = &out[pos + k * (encryption ? size + tag_size : size)];
+						segment(w, index + k, last && k == count - 1, in + k * unit, encryption ? in_len : in_len - tag_size, seg_out);
+					} catch (...) {
+						errors[w] = std::current_exception();
 					}
+				};
+				for (size_t i = 1; i < n; i++) {
+					pool.emplace_back(job, i);
 				}
-				init.tag.set(temp.data() + temp.size() - tag_size, tag_size);
-				break;
-			}
-			}
-		} else {
-			std::unique_ptr<SymmetricCipher> pEnc(intern::getSymmetricCipher(options.cipher, options.mode, true));
-			if (!pEnc) {
-				throw CExc(CExc::Code::invalid_mode);
-			}
-			if (options.mode == Mode::ecb) {
-				pEnc->SetKey(tKey.data(), key_len);
-			} else {
-				pEnc->SetKeyWithIV(tKey.data(), key_len, ptVec, iv_len);
-			}
-			switch (options.encoding.enc)
-			{
-			case Encoding::ascii:
-			{
-				StringSource(in, in_len, true, new StreamTransformationFilter(*pEnc, new StringSinkTemplate<std::basic_string<byte>>(buffer)));
-				break;
-			}
-			case Encoding::base16: case Encoding::base32:
-			{
-				int linelength = options.encoding.linebreaks ? (int)options.encoding.linelength : 0;
-				if (options.encoding.enc == Encoding::base16) {
-					StringSource(in, in_len, true, new StreamTransformationFilter(*pEnc,
-						new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.encoding.uppercase, linelength, Strings::eol[(int)options.encoding.eol])));
-				} else {
-					StringSource(in, in_len, true, new StreamTransformationFilter(*pEnc,
-							new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.encoding.uppercase, linelength, Strings::eol[(int)options.encoding.eol])));
+				job(0);
+				for (auto& t : pool) {
+					t.join();
 				}
-				break;
-			}
-			case crypt::Encoding::base64:
-			{
-				StringSource(in, in_len, true, new StreamTransformationFilter(*pEnc,
-						new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.encoding.linebreaks, (int)options.encoding.linelength, CryptoPP::EOL(options.encoding.eol))
-						));
-				if (options.encoding.linebreaks) {
-					buffer.pop_back();
-					if (options.encoding.eol == crypt::EOL::windows) {
-						buffer.pop_back();
+				for (auto& e : errors) {
+					if (e) {
+						std::rethrow_exception(e);
 					}
 				}
-				break;
-			}
 			}
+		} catch (...) {
+			// nothing of a failed batch is returned
+			out.resize(pos);
+			throw;
 		}
-	} catch (CryptoPP::Exception& exc) {
-		switch (exc.GetErrorType()) {
-		case CryptoPP::Exception::NOT_IMPLEMENTED: throw CExc(CExc::Code::cryptopp_not_implemented); break;
-		case CryptoPP::Exception::INVALID_ARGUMENT: throw CExc(CExc::Code::cryptopp_invalid_argument); break;
-		case CryptoPP::Exception::CANNOT_FLUSH: throw CExc(CExc::Code::cryptopp_cannot_flush); break;
-		case CryptoPP::Exception::DATA_INTEGRITY_CHECK_FAILED: throw CExc(CExc::Code::cryptopp_bad_integrity); break;
-		case CryptoPP::Exception::INVALID_DATA_FORMAT: throw CExc(CExc::Code::cryptopp_invalid_data); break;
-		case CryptoPP::Exception::IO_ERROR: throw CExc(CExc::Code::cryptopp_io_error); break;
-		default: throw CExc(CExc::Code::cryptopp_other); break;
+		index += count;
+	}
+
+private:
+	void segment(size_t w, size_t segment_index, bool final, const byte* in, size_t len, byte* out)
+	{
+		CryptoPP::AuthenticatedSymmetricCipher& aead = *workers[w];
+		CryptoPP::SecByteBlock iv(nonce);
+		byte be[4];
+		CryptoPP::PutWord(false, CryptoPP::BIG_ENDIAN_ORDER, be, (CryptoPP::word32)segment_index);
+		for (size_t i = 0; i < 4; i++) {
+			iv[iv.size() - 5 + i] ^= be[i];
+		}
+		if (final) {
+			iv[iv.size() - 1] ^= 1;
+		}
+		// eax does not allow to resynchronize twice, so the key is set together with the first nonce
+		if (keyed[w]) {
+			aead.Resynchronize(iv, (int)iv.size());
+		} else {
+			aead.SetKeyWithIV(key, key.size(), iv, iv.size());
+			keyed[w] = 1;
+		}
+		if (aead.NeedsPrespecifiedDataLengths()) {
+			aead.SpecifyDataLengths(aad.size(), len, 0);
+		}
+		aead.Update(aad, aad.size());
+		aead.ProcessData(out, in, len);
+		if (encryption) {
+			aead.TruncatedFinal(out + len, tag_size);
+		} else if (!aead.TruncatedVerify(in + len, tag_size)) {
+			throw CExc(CExc::Code::authentication_failed);
 		}
-	} catch(CExc& exc) {
-		throw exc;
-	} catch (...) {
-		throw CExc(CExc::Code::unexpected);
 	}
- }
 
-void crypt::decrypt(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Crypt& options, InitData& init)
+	bool										encryption;
+	size_t										size;
+	size_t										tag_size;
+	size_t										index;
+	SecureBlock									key;
+	CryptoPP::SecByteBlock						nonce;
+	CryptoPP::SecByteBlock						aad;
+	std::vector<std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher>>	workers;
+	std::vector<char>							keyed;
+};
+
+crypt::CryptStream::CryptStream(const Options::Crypt& opt, InitData& init_data)
+	: options(opt), init(init_data), ptVec(NULL), key_len(opt.key.length), tag_size(0), data_length(0), processed(0), finished(false), output(NULL)
 {
-	if (!in || !in_len) {
-		throw CExc(CExc::Code::input_null);
+	getCipherInfo(options.cipher, options.mode, key_len, iv_len, block_size);
+	if (block_size) {
+		switch (options.mode)
+		{
+		case Mode::gcm: tag_size = Constants::gcm_tag_size; break;
+		case Mode::ccm: tag_size = Constants::ccm_tag_size; break;
+		case Mode::eax: tag_size = Constants::eax_tag_size; break;
+		}
 	}
+}
 
-	using namespace crypt;
-	using namespace	CryptoPP;
+crypt::CryptStream::~CryptStream()
+{
+}
 
-	SecByteBlock		tKey;
-	const byte*			ptVec = NULL;
-	const byte*			ptSalt = NULL;
-	size_t				key_len = options.key.length;
-	size_t				block_size, iv_len;
+void crypt::CryptStream::initCipher(bool encryption, size_t length)
+{
+	using namespace CryptoPP;
 
-	getCipherInfo(options.cipher, options.mode, key_len, iv_len, block_size);
+	data_length = length;
+	SecByteBlock aad(init.salt.size() + init.iv.size());
+	if (init.salt.size()) {
+		std::memcpy(aad.data(), init.salt.BytePtr(), init.salt.size());
+	}
+	if (init.iv.size()) {
+		std::memcpy(aad.data() + init.salt.size(), init.iv.BytePtr(), init.iv.size());
+	}
+	size_t threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+	if (options.segment_size) {
+		if (!tag_size) {
+			throw CExc(CExc::Code::invalid_mode);
+		}
+		if (options.segment_size < Constants::segment_size_min || options.segment_size > Constants::segment_size_max
+			|| (options.mode == Mode::ccm && options.segment_size > Constants::segment_ccm_max)) {
+			throw CExc(CExc::Code::invalid_segment_size);
+		}
+		segments.reset(new Segments(options, tKey.data(), key_len, ptVec, iv_len, aad.data(), aad.size(), tag_size, encryption));
+	} else if (block_size && (options.mode == Mode::ctr || options.mode == Mode::gcm) && threads > 1
+		&& (!data_length || data_length >= Constants::parallel_min_size)) {
+		parallel.reset(new Parallel(options, tKey.data(), key_len, ptVec, iv_len, block_size, encryption));
+		if (tag_size) {
+			parallel->authenticate(aad.data(), aad.size());
+		}
+	} else if (tag_size) {
+		aead.reset(intern::getAuthenticatedCipher(options.cipher, options.mode, encryption));
+		if (!aead) {
+			throw CExc(CExc::Code::invalid_mode);
+		}
+		aead->SetKeyWithIV(tKey.data(), key_len, ptVec, iv_len);
+		// ccm without known length: lengths and aad are specified by finish()
+		if (!aead->NeedsPrespecifiedDataLengths() || data_length) {
+			if (aead->NeedsPrespecifiedDataLengths()) {
+				aead->SpecifyDataLengths(init.salt.size() + init.iv.size(), data_length, 0);
+			}
+			aead->Update(init.salt.BytePtr(), init.salt.size());
+			aead->Update(init.iv.BytePtr(), init.iv.size());
+		}
+	} else {
+		cipher.reset(intern::getSymmetricCipher(options.cipher, options.mode, encryption));
+		if (!cipher) {
+			throw CExc(CExc::Code::invalid_mode);
+		}
+		// rc4 and wake take no iv: crypto++ rejects unused parameters
+		if (options.mode == Mode::ecb || !iv_len) {
+			cipher->SetKey(tKey.data(), key_len);
+		} else {
+			cipher->SetKeyWithIV(tKey.data(), key_len, ptVec, iv_len);
+		}
+	}
+}
 
+void crypt::CryptStream::initDecryptionKey()
+{
 	// --------------------------- prepare salt vector:
-	if (options.key.salt_bytes > 0)	{
+	if (options.key.salt_bytes > 0) {
 		if (options.key.algorithm == crypt::KeyDerivation::bcrypt && options.key.salt_bytes != 16) {
 			throw CExc(CExc::Code::invalid_bcrypt_saltlength);
 		}
@@ -1853,7 +2869,6 @@ void crypt::decrypt(const byte* in, size_t in_len, std::basic_string<byte>& buff
 		if (init.salt.size() != (size_t)options.key.salt_bytes) {
 			throw CExc(CExc::Code::invalid_salt);
 		}
-		ptSalt = init.salt.BytePtr();
 	}
 	// --------------------------- prepare iv vector & key-block:
 	if (options.mode != Mode::ecb && iv_len > 0) {
@@ -1877,356 +2892,1008 @@ void crypt::decrypt(const byte* in, size_t in_len, std::basic_string<byte>& buff
 	} else {
 		tKey.resize(key_len);
 	}
-	intern::calcKey(tKey, options.password, init.salt, options.key);
+	deriveKey(false);
+}
 
-	try	{
-		if (block_size && (options.mode == Mode::gcm || options.mode == Mode::ccm || options.mode == Mode::eax)) {
-			std::unique_ptr<AuthenticatedSymmetricCipher> penc(intern::getAuthenticatedCipher(options.cipher, options.mode, false));
+void crypt::CryptStream::deriveKey(bool encryption)
+{
+	if (options.master) {
+		if (!init.salt.size()) {
+			throw CExc(CExc::Code::salt_missing);
+		}
+		if (encryption) {
+			init.master_salt.set(options.master->salt);
+		} else if (init.master_salt.size() != options.master->salt.size()
+			|| !CryptoPP::VerifyBufsEqual(init.master_salt.BytePtr(), options.master->salt.BytePtr(), init.master_salt.size())) {
+			throw CExc(CExc::Code::invalid_salt);
+		}
+		intern::expandKey(tKey, options.master->key, init.salt);
+	} else if (!encryption && init.master_salt.size()) {
+		// data of a batch decrypted on its own
+		MasterKey master;
+		master.salt.set(init.master_salt);
+		deriveMasterKey(options, master);
+		intern::expandKey(tKey, master.key, init.salt);
+	} else {
+		init.master_salt.clear();
+		intern::calcKey(tKey, options.password, init.salt, options.key, options.threads);
+	}
+}
 
-			int tag_size;
-			switch (options.mode)
-			{
-			case Mode::gcm: tag_size = Constants::gcm_tag_size; break;
-			case Mode::ccm: tag_size = Constants::ccm_tag_size;  break;
-			case Mode::eax: tag_size = Constants::eax_tag_size;  break;
-			}
-			penc->SetKeyWithIV(tKey.data(), key_len, ptVec, iv_len);
+// ===========================================================================================================================================================================================
 
-			std::basic_string<byte> temp;
-			const byte*				pEncrypted;
-			size_t					Encrypted_size;
-				
-			switch (options.encoding.enc)
-			{
-			case Encoding::ascii:
-			{
-				pEncrypted = in;
-				Encrypted_size = in_len;
-				break;
-			}
-			case Encoding::base16: case Encoding::base32: case Encoding::base64:
-			{
-				if (options.encoding.enc == Encoding::base16) {
-					StringSource(in, in_len, true, new HexDecoder(new StringSinkTemplate<std::basic_string<byte>>(temp)));
-				} else if (options.encoding.enc == Encoding::base32) {
-					StringSource(in, in_len, true, new Base32Decoder(new StringSinkTemplate<std::basic_string<byte>>(temp)));
-				} else {
-					StringSource(in, in_len, true, new Base64Decoder(new StringSinkTemplate<std::basic_string<byte>>(temp)));
-				}
-				pEncrypted = temp.c_str();
-				Encrypted_size = temp.size();
-				break;
-			}
-			}				
+crypt::Encryptor::Encryptor(const Options::Crypt& opt, InitData& init_data, size_t length) : CryptStream(opt, init_data)
+{
+	try {
+		using namespace CryptoPP;
+		Stats::Timer timer(Stats::Phase::cipher);
 
-			if (options.mode == Mode::ccm) {
-				penc->SpecifyDataLengths(init.salt.size() + init.iv.size(), Encrypted_size, 0);
+		// --------------------------- prepare salt vector:
+		if (options.key.salt_bytes > 0) {
+			if (options.key.algorithm == KeyDerivation::bcrypt && options.key.salt_bytes != 16) {
+				throw CExc(CExc::Code::invalid_bcrypt_saltlength);
 			}
-
-			AuthenticatedDecryptionFilter df(*penc, NULL, AuthenticatedDecryptionFilter::MAC_AT_BEGIN | AuthenticatedDecryptionFilter::THROW_EXCEPTION, tag_size);
-
-			secure_string temp2;
-			df.ChannelPut( DEFAULT_CHANNEL, init.tag.BytePtr(), init.tag.size());
-			df.ChannelPut( AAD_CHANNEL, init.salt.BytePtr(), init.salt.size());
-			df.ChannelPut( AAD_CHANNEL, init.iv.BytePtr(), init.iv.size());
-			df.ChannelPut( DEFAULT_CHANNEL, pEncrypted, Encrypted_size);
-			df.ChannelMessageEnd( AAD_CHANNEL );
-			df.ChannelMessageEnd( DEFAULT_CHANNEL );
-
-			if (!df.GetLastResult()) {
-				throw CExc(CExc::Code::authentication_failed);
+			init.salt.random(options.key.salt_bytes);
+		}
+		// --------------------------- prepare iv & key vector
+		if (options.iv == crypt::IV::keyderivation) {
+			tKey.resize(key_len + iv_len);
+			if (iv_len > 0) {
+				ptVec = &tKey[key_len];
 			}
-
-			df.SetRetrievalChannel("");
-			size_t n = (size_t)df.MaxRetrievable();
-			buffer.resize(n);
-
-			if (n > 0) { 
-				df.Get((byte*)buffer.data(), n);
+		} else if (options.iv == crypt::IV::random) {
+			tKey.resize(key_len);
+			if (iv_len > 0) {
+				init.iv.random(iv_len);
+				ptVec = init.iv.BytePtr();
 			}
-		} else {
-			std::unique_ptr<SymmetricCipher> pEnc(intern::getSymmetricCipher(options.cipher, options.mode, false));
-			if (!pEnc) {
-				throw CExc(CExc::Code::invalid_mode);
+		} else if (options.iv == crypt::IV::zero) {
+			tKey.resize(key_len);
+			if (iv_len) {
+				init.iv.zero(iv_len);
+				ptVec = init.iv.BytePtr();
 			}
-			if (options.mode == Mode::ecb) {
-				pEnc->SetKey(tKey.data(), key_len);
-			} else {
-				pEnc->SetKeyWithIV(tKey.data(), key_len, ptVec, iv_len);
+		} else if (options.iv == crypt::IV::custom) {
+			tKey.resize(key_len);
+			if (iv_len != init.iv.size()) {
+				throw CExc(CExc::Code::invalid_iv);
 			}
+			ptVec = init.iv.BytePtr();
+		}
+		deriveKey(true);
 
-			switch (options.encoding.enc)
-			{
-			case Encoding::ascii:
-			{
-				StringSource(in, in_len, true, 
-					new StreamTransformationFilter(*pEnc, 
-						new StringSinkTemplate<std::basic_string<byte>>(buffer)));
-				break;
-			}
-			case Encoding::base16:
-			{
-				StringSource(in, in_len, true, 
-					new HexDecoder(
-						new StreamTransformationFilter(*pEnc, new StringSinkTemplate<std::basic_string<byte>>(buffer))));
-				break;
-			}
-			case Encoding::base32:
-			{
-				StringSource(in, in_len, true,
-					new Base32Decoder(
-						new StreamTransformationFilter(*pEnc, new StringSinkTemplate<std::basic_string<byte>>(buffer))
-					)
-				);
-				break;
-			}
-			case Encoding::base64:
-			{
-				StringSource(in, in_len, true,
-					new Base64Decoder(
-						new StreamTransformationFilter(*pEnc, new StringSinkTemplate<std::basic_string<byte>>(buffer))
-					)
-				);
-				break;
-			}
+		initCipher(true, length);
+		BufferedTransformation* encoder = NULL;
+		if (options.encoding.enc != Encoding::ascii || cipher) {
+			encoder = intern::getEncoder(options.encoding, new intern::OutputSink(output));
+			if (options.encoding.enc != Encoding::ascii && Stats::enabled()) {
+				encoder = new intern::StatsFilter(Stats::Phase::encoding, encoder);
 			}
 		}
-	} catch (CryptoPP::Exception& exc) {
-		switch (exc.GetErrorType()) {
-		case CryptoPP::Exception::NOT_IMPLEMENTED: throw CExc(CExc::Code::cryptopp_not_implemented); break;
-		case CryptoPP::Exception::INVALID_ARGUMENT: throw CExc(CExc::Code::cryptopp_invalid_argument); break;
-		case CryptoPP::Exception::CANNOT_FLUSH: throw CExc(CExc::Code::cryptopp_cannot_flush); break;
-		case CryptoPP::Exception::DATA_INTEGRITY_CHECK_FAILED: throw CExc(CExc::Code::cryptopp_bad_integrity); break;
-		case CryptoPP::Exception::INVALID_DATA_FORMAT: throw CExc(CExc::Code::cryptopp_invalid_data); break;
-		case CryptoPP::Exception::IO_ERROR: throw CExc(CExc::Code::cryptopp_io_error); break;
-		default: throw CExc(CExc::Code::cryptopp_other); break;
+		if (cipher) {
+			filter.reset(new StreamTransformationFilter(*cipher, encoder));
+		} else {
+			filter.reset(encoder);
 		}
-	} catch (CExc& exc) {
-		throw exc;
 	} catch (...) {
-		throw CExc(CExc::Code::unexpected);
+		intern::rethrow();
 	}
 }
 
-void crypt::hash(Options::Hash& options, std::basic_string<byte>& buffer, std::initializer_list<std::pair<const byte*, size_t>> in)
+void crypt::Encryptor::update(const byte* in, size_t in_len, std::basic_string<byte>& out)
 {
-	try	{
-		using namespace CryptoPP;
-		using namespace std;
-
-		size_t keylength;
-		if (!getHashInfo(options.algorithm, options.digest_length, keylength)) {
-			throw CExc(CExc::Code::invalid_hash);
-		}
-		if (keylength != 0 && options.use_key && options.key.size() != keylength) {
-			throw CExc(CExc::Code::invalid_keylength);
-		}
-
-		SecByteBlock digest;
-		std::unique_ptr<HashTransformation> phash(intern::getHashTransformation(options));
-		if (!phash) {
-			throw CExc(CExc::Code::invalid_hash);
-		}
-		digest.resize(phash->DigestSize());
-		for (const std::pair<const byte*, size_t>& i : in) {
-			phash->Update(i.first, i.second);
+	if (finished) {
+		throw CExc(CExc::Code::unexpected);
+	}
+	Stats::Timer timer(Stats::Phase::cipher, in_len);
+	output = &out;
+	try {
+		if (segments) {
+			// at least one byte is kept back for the final segment
+			pending.append(in, in_len);
+			if (pending.size() > segments->batchSize()) {
+				size_t len = (pending.size() - 1) / options.segment_size * options.segment_size;
+				process(pending.data(), len, out);
+				pending.erase(0, len);
+			}
+		} else if (aead && aead->NeedsPrespecifiedDataLengths() && !data_length) {
+			pending.append(in, in_len);
+		} else {
+			process(in, in_len, out);
 		}
-		phash->Final(digest);
+	} catch (...) {
+		intern::rethrow();
+	}
+}
 
-		buffer.clear();
-		switch (options.encoding)
-		{
-		case crypt::Encoding::ascii:
-		{
-			buffer.assign(digest.begin(), digest.end());
-			break;
-		}
-		case crypt::Encoding::base16:
-		{
-			StringSource(&digest[0], digest.size(), true, new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), true, 0));
-			break;
+void crypt::Encryptor::process(const byte* in, size_t in_len, std::basic_string<byte>& out)
+{
+	processed += in_len;
+	// with an encoding the ciphertext goes through queue chunk by chunk and the encoder writes straight into out
+	if (segments) {
+		if (!filter) {
+			segments->process(in, in_len, false, out);
+		} else {
+			queue.clear();
+			segments->process(in, in_len, false, queue);
+			filter->Put(queue.data(), queue.size());
 		}
-		case crypt::Encoding::base32:
-		{
-			StringSource(&digest[0], digest.size(), true, new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), true, 0));
-			break;
+	} else if (parallel) {
+		if (!filter) {
+			parallel->process(in, in_len, out);
+		} else {
+			for (size_t offset = 0; offset < in_len; offset += parallel->chunkSize()) {
+				queue.clear();
+				parallel->process(in + offset, std::min(in_len - offset, parallel->chunkSize()), queue);
+				filter->Put(queue.data(), queue.size());
+			}
 		}
-		case crypt::Encoding::base64:
-		{
-			StringSource(&digest[0], digest.size(), true, new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), false));
-			break;
+	} else if (aead) {
+		if (!filter) {
+			size_t offset = out.size();
+			out.resize(offset + in_len);
+			aead->ProcessData(&out[offset], in, in_len);
+		} else {
+			queue.resize(std::min(in_len, Constants::stream_chunk_size));
+			for (size_t offset = 0; offset < in_len; offset += queue.size()) {
+				size_t len = std::min(in_len - offset, queue.size());
+				aead->ProcessData(&queue[0], in + offset, len);
+				filter->Put(queue.data(), len);
+			}
 		}
+	} else {
+		for (size_t offset = 0; offset < in_len; offset += Constants::stream_chunk_size) {
+			filter->Put(in + offset, std::min(in_len - offset, Constants::stream_chunk_size));
 		}
-	} catch (CExc& exc) {
-		throw exc;
-	} catch (...) {
-		throw CExc(CExc::Code::unexpected);
 	}
 }
 
-void crypt::hash(Options::Hash& options, std::basic_string<byte>& buffer, const std::string& path)
+void crypt::Encryptor::finish(std::basic_string<byte>& out)
 {
+	if (finished) {
+		throw CExc(CExc::Code::unexpected);
+	}
+	Stats::Timer timer(Stats::Phase::cipher);
+	output = &out;
 	try {
-		using namespace CryptoPP;
-		using namespace std;
+		if (aead) {
+			if (aead->NeedsPrespecifiedDataLengths() && !data_length) {
+				data_length = pending.size();
+				aead->SpecifyDataLengths(init.salt.size() + init.iv.size(), data_length, 0);
+				aead->Update(init.salt.BytePtr(), init.salt.size());
+				aead->Update(init.iv.BytePtr(), init.iv.size());
+				process(pending.data(), pending.size(), out);
+				pending.clear();
+			}
+			CryptoPP::SecByteBlock tag(tag_size);
+			aead->TruncatedFinal(tag, tag_size);
+			init.tag.set(tag, tag_size);
+		} else if (parallel) {
+			CryptoPP::SecByteBlock tag(tag_size);
+			queue.clear();
+			parallel->finish(filter ? queue : out, tag, tag_size);
+			if (filter) {
+				filter->Put(queue.data(), queue.size());
+			}
+			if (tag_size) {
+				init.tag.set(tag, tag_size);
+			}
+		} else if (segments) {
+			queue.clear();
+			segments->process(pending.data(), pending.size(), true, filter ? queue : out);
+			if (filter) {
+				filter->Put(queue.data(), queue.size());
+			}
+			processed += pending.size();
+			pending.clear();
+		}
+		if (filter) {
+			filter->MessageEnd();
+		}
+		queue.clear();
+		finished = true;
+	} catch (...) {
+		intern::rethrow();
+	}
+}
 
-		SecByteBlock digest;
-		std::unique_ptr<HashTransformation> phash(intern::getHashTransformation(options));
-		if (!phash) {
-			throw CExc(CExc::Code::invalid_hash);
-		}
-		digest.resize(phash->DigestSize());
+// ===========================================================================================================================================================================================
 
-		FileSource f(path.c_str(), true, new HashFilter(*phash, new ArraySink(digest, digest.size())));
+crypt::Decryptor::Decryptor(const Options::Crypt& opt, InitData& init_data, size_t length) : CryptStream(opt, init_data)
+{
+	try {
+		using namespace CryptoPP;
+		Stats::Timer timer(Stats::Phase::cipher);
 
-		buffer.clear();
-		switch (options.encoding)
-		{
-		case crypt::Encoding::ascii:
-		{
-			buffer.assign(digest.begin(), digest.end());
-			break;
+		if (tag_size && !options.segment_size && init.tag.size() != tag_size) {
+			throw CExc(CExc::Code::invalid_tag);
 		}
-		case crypt::Encoding::base16:
-		{
-			StringSource(&digest[0], digest.size(), true, new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), true, 0));
-			break;
+		initDecryptionKey();
+
+		initCipher(false, length);
+		BufferedTransformation* sink = NULL;
+		bool stats = (options.encoding.enc != Encoding::ascii && Stats::enabled());
+		if (cipher) {
+			sink = new StreamTransformationFilter(*cipher, new intern::OutputSink(output));
+		} else if (options.encoding.enc != Encoding::ascii) {
+			// the decoder feeds the aead cipher directly
+			sink = new intern::OutputSink(output, [this](const byte* in, size_t in_len, std::basic_string<byte>& out) { process(in, in_len, out); });
 		}
-		case crypt::Encoding::base32:
-		{
-			StringSource(&digest[0], digest.size(), true, new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), true, 0));
-			break;
+		if (sink && stats) {
+			// separates the time of the cipher from the decoder
+			sink = new intern::StatsFilter(Stats::Phase::cipher, sink, false);
 		}
-		case crypt::Encoding::base64:
-		{
-			StringSource(&digest[0], digest.size(), true, new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), false));
-			break;
+		if (sink) {
+			filter.reset(intern::getDecoder(options.encoding.enc, sink));
+			if (stats) {
+				filter.reset(new intern::StatsFilter(Stats::Phase::encoding, filter.release()));
+			}
 		}
+	} catch (...) {
+		intern::rethrow();
+	}
+}
+
+void crypt::Decryptor::update(const byte* in, size_t in_len, std::basic_string<byte>& out)
+{
+	if (finished) {
+		throw CExc(CExc::Code::unexpected);
+	}
+	// decrypted bytes are counted
+	Stats::Timer timer(Stats::Phase::cipher);
+	size_t length = out.size();
+	output = &out;
+	try {
+		if (!filter) {
+			process(in, in_len, out);
+		} else {
+			for (size_t offset = 0; offset < in_len; offset += Constants::stream_chunk_size) {
+				filter->Put(in + offset, std::min(in_len - offset, Constants::stream_chunk_size));
+			}
 		}
+		timer.addBytes(out.size() - length);
+	} catch (...) {
+		intern::rethrow();
 	}
-	catch (CExc& exc) {
-		throw exc;
+}
+
+void crypt::Decryptor::process(const byte* in, size_t in_len, std::basic_string<byte>& out)
+{
+	if (segments) {
+		// the last segment is only known at finish(), so at least one byte is kept back
+		queue.append(in, in_len);
+		if (queue.size() > segments->batchSize()) {
+			size_t len = (queue.size() - 1) / segments->unitSize() * segments->unitSize();
+			processed += len;
+			segments->process(queue.data(), len, false, out);
+			queue.erase(0, len);
+		}
+	} else if (parallel) {
+		if (filter) {
+			// the decoder passes on one chunk at a time: the threads get whole parallel chunks
+			queue.append(in, in_len);
+			if (queue.size() >= parallel->chunkSize()) {
+				processed += queue.size();
+				parallel->process(queue.data(), queue.size(), out);
+				queue.clear();
+			}
+		} else {
+			processed += in_len;
+			parallel->process(in, in_len, out);
+		}
+	} else if (aead->NeedsPrespecifiedDataLengths() && !data_length) {
+		queue.append(in, in_len);
+	} else if (in_len) {
+		processed += in_len;
+		size_t offset = out.size();
+		out.resize(offset + in_len);
+		aead->ProcessData(&out[offset], in, in_len);
 	}
-	catch (...) {
+}
+
+void crypt::Decryptor::finish(std::basic_string<byte>& out)
+{
+	if (finished) {
 		throw CExc(CExc::Code::unexpected);
 	}
+	Stats::Timer timer(Stats::Phase::cipher);
+	size_t length = out.size();
+	output = &out;
+	try {
+		if (filter) {
+			filter->MessageEnd();
+		}
+		if (aead) {
+			if (aead->NeedsPrespecifiedDataLengths() && !data_length) {
+				data_length = queue.size();
+				aead->SpecifyDataLengths(init.salt.size() + init.iv.size(), data_length, 0);
+				aead->Update(init.salt.BytePtr(), init.salt.size());
+				aead->Update(init.iv.BytePtr(), init.iv.size());
+				process(queue.data(), queue.size(), out);
+				queue.clear();
+			}
+			if (!aead->TruncatedVerify(init.tag.BytePtr(), tag_size)) {
+				throw CExc(CExc::Code::authentication_failed);
+			}
+		} else if (parallel) {
+			// rest of the decoded input
+			processed += queue.size();
+			parallel->process(queue.data(), queue.size(), out);
+			queue.clear();
+			CryptoPP::SecByteBlock tag(tag_size);
+			parallel->finish(out, tag, tag_size);
+			if (tag_size && !CryptoPP::VerifyBufsEqual(tag, init.tag.BytePtr(), tag_size)) {
+				throw CExc(CExc::Code::authentication_failed);
+			}
+		} else if (segments) {
+			processed += queue.size();
+			segments->process(queue.data(), queue.size(), true, out);
+			queue.clear();
+		}
+		timer.addBytes(out.size() - length);
+		finished = true;
+	} catch (...) {
+		intern::rethrow();
+	}
 }
 
-void crypt::shake128(const byte* in, size_t in_len, byte* out, size_t out_len)
+// ===========================================================================================================================================================================================
+
+crypt::SeekableReader::SeekableReader(const Options::Crypt& opt, InitData& init_data, const byte* in, size_t in_len)
+	: CryptStream(opt, init_data), data(in), data_len(in_len), line_length(0), eol_length(0), chars(in_len), bin_length(in_len), plain_length(0)
 {
-	Keccak_HashInstance keccak_inst;
-	if (Keccak_HashInitialize_SHAKE128(&keccak_inst) != 0) {
-		throw CExc(CExc::Code::keccak_shake_failed);
-	}
-	if (Keccak_HashUpdate(&keccak_inst, in, in_len * 8) != 0) {
-		throw CExc(CExc::Code::keccak_shake_failed);
+	try {
+		if (!in) {
+			throw CExc(CExc::Code::input_null);
+		}
+		if (!options.segment_size) {
+			throw CExc(CExc::Code::invalid_segment_size);
+		}
+		initDecryptionKey();
+		initCipher(false, 0);
+
+		if (options.encoding.enc != Encoding::ascii) {
+			while (data_len && (data[data_len - 1] == '\r' || data[data_len - 1] == '\n' || data[data_len - 1] == ' ')) {
+				data_len--;
+			}
+			// line length and eol are taken from the data itself, every line but the last is complete
+			for (size_t i = 0; i < data_len; i++) {
+				if (data[i] == '\r' || data[i] == '\n') {
+					line_length = i;
+					eol_length = (data[i] == '\r' && i + 1 < data_len && data[i + 1] == '\n') ? 2 : 1;
+					break;
+				}
+			}
+			chars = data_len;
+			if (line_length) {
+				chars -= (data_len - 1) / (line_length + eol_length) * eol_length;
+			}
+			switch (options.encoding.enc)
+			{
+			case Encoding::base16:
+				bin_length = chars / 2;
+				break;
+			case Encoding::base32:
+				bin_length = chars * 5 / 8;
+				break;
+			case Encoding::base64:
+			{
+				bin_length = chars / 4 * 3;
+				for (size_t i = data_len; i > 0 && data[i - 1] == '=' && bin_length; i--) {
+					bin_length--;
+				}
+				break;
+			}
+			}
+		}
+		size_t unit = options.segment_size + tag_size;
+		size_t count = std::max<size_t>((bin_length + unit - 1) / unit, 1);
+		if (bin_length < (count - 1) * unit + tag_size) {
+			throw CExc(CExc::Code::authentication_failed);
+		}
+		plain_length = bin_length - count * tag_size;
+	} catch (...) {
+		intern::rethrow();
 	}
-	if (Keccak_HashFinal(&keccak_inst, out) != 0) {
-		throw CExc(CExc::Code::keccak_shake_failed);
+}
+
+size_t crypt::SeekableReader::size() const
+{
+	return plain_length;
+}
+
+void crypt::SeekableReader::read(size_t offset, size_t length, std::basic_string<byte>& out)
+{
+	if (offset >= plain_length || !length) {
+		return;
 	}
-	if (Keccak_HashSqueeze(&keccak_inst, out, out_len * 8) != 0) {
-		throw CExc(CExc::Code::keccak_shake_failed);
+	try {
+		length = std::min(length, plain_length - offset);
+		size_t unit = options.segment_size + tag_size;
+		size_t count = std::max<size_t>((bin_length + unit - 1) / unit, 1);
+		size_t first = offset / options.segment_size;
+		size_t last = (offset + length - 1) / options.segment_size;
+
+		std::basic_string<byte> temp;
+		decode(first * unit, std::min((last + 1) * unit, bin_length) - first * unit, temp);
+		std::basic_string<byte> plain;
+		segments->seek(first);
+		segments->process(temp.data(), temp.size(), last == count - 1, plain);
+		out.append(plain, offset - first * options.segment_size, length);
+		intern::wipe(plain);
+	} catch (...) {
+		intern::rethrow();
 	}
 }
 
-void crypt::convert(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Convert& options)
+void crypt::SeekableReader::decode(size_t offset, size_t length, std::basic_string<byte>& out)
 {
 	using namespace CryptoPP;
-	using namespace crypt;
 
-	std::string s_seperator = (options.eol == crypt::EOL::windows) ? "\r\n" : "\n";
-	int groupsize = options.linebreaks ? options.linelength : 0;
-
-	switch (options.from)
+	size_t group_bytes, group_chars;
+	switch (options.encoding.enc)
 	{
-	case Encoding::ascii:
+	case Encoding::base16: group_bytes = 1; group_chars = 2; break;
+	case Encoding::base32: group_bytes = 5; group_chars = 8; break;
+	case Encoding::base64: group_bytes = 3; group_chars = 4; break;
+	default:
+		out.assign(data + offset, length);
+		return;
+	}
+	size_t first = offset / group_bytes;
+	size_t c_begin = first * group_chars;
+	size_t c_end = std::min((offset + length + group_bytes - 1) / group_bytes * group_chars, chars);
+	// position of a character in the data, counting the eols in front of it
+	auto position = [this](size_t c) { return line_length ? c + c / line_length * eol_length : c; };
+	size_t begin = position(c_begin);
+	size_t end = position(c_end - 1) + 1;
+
+	std::basic_string<byte> temp;
+	std::unique_ptr<BufferedTransformation> decoder(intern::getDecoder(options.encoding.enc, new StringSinkTemplate<std::basic_string<byte>>(temp)));
+	decoder->Put(data + begin, end - begin);
+	decoder->MessageEnd();
+	size_t skip = offset - first * group_bytes;
+	if (temp.size() < skip + length) {
+		throw CExc(CExc::Code::authentication_failed);
+	}
+	out.assign(temp, skip, length);
+}
+
+// ===========================================================================================================================================================================================
+
+void crypt::encrypt(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Crypt& options, InitData& init)
+{
+	if (!in || !in_len) {
+		throw CExc(CExc::Code::input_null);
+	}
+	buffer.reserve(buffer.size() + encryptedSize(options, in_len));
+	Encryptor encryptor(options, init, in_len);
+	encryptor.update(in, in_len, buffer);
+	encryptor.finish(buffer);
+}
+
+void crypt::decrypt(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Crypt& options, InitData& init)
+{
+	if (!in || !in_len) {
+		throw CExc(CExc::Code::input_null);
+	}
+	size_t offset = buffer.size();
+	buffer.reserve(offset + decryptedSizeBound(options, in_len));
+	try {
+		// the decoded length is only known upfront for ascii input
+		Decryptor decryptor(options, init, (options.encoding.enc == Encoding::ascii) ? in_len : 0);
+		decryptor.update(in, in_len, buffer);
+		decryptor.finish(buffer);
+	} catch (CExc&) {
+		buffer.resize(offset);
+		throw;
+	}
+}
+
+size_t crypt::getTagSize(const Options::Crypt& options)
+{
+	size_t key_len = options.key.length, iv_len, block_size;
+	if (options.segment_size || !getCipherInfo(options.cipher, options.mode, key_len, iv_len, block_size) || !block_size) {
+		return 0;
+	}
+	switch (options.mode)
 	{
-		switch (options.to)
-		{
-		case Encoding::base16:
+	case Mode::gcm: return Constants::gcm_tag_size;
+	case Mode::ccm: return Constants::ccm_tag_size;
+	case Mode::eax: return Constants::eax_tag_size;
+	default: return 0;
+	}
+}
+
+size_t crypt::encryptedSize(const Options::Crypt& options, size_t in_len)
+{
+	size_t key_len = options.key.length, iv_len, block_size, tag_size = 0;
+	if (!getCipherInfo(options.cipher, options.mode, key_len, iv_len, block_size)) {
+		throw CExc(CExc::Code::invalid_mode);
+	}
+	if (block_size) {
+		switch (options.mode)
 		{
-			StringSource(in, in_len, true, new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.uppercase, groupsize, s_seperator));
-			break;
+		case Mode::gcm: tag_size = Constants::gcm_tag_size; break;
+		case Mode::ccm: tag_size = Constants::ccm_tag_size; break;
+		case Mode::eax: tag_size = Constants::eax_tag_size; break;
+		case Mode::ecb: case Mode::cbc: in_len = (in_len / block_size + 1) * block_size; break;
 		}
-		case Encoding::base32:
-		{
-			StringSource(in, in_len, true, new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.uppercase, groupsize, s_seperator));
-			break;
+	}
+	// segments: every segment carries its own tag, empty input is one empty segment
+	if (tag_size && options.segment_size) {
+		in_len += std::max((in_len + options.segment_size - 1) / options.segment_size, (size_t)1) * tag_size;
+	}
+	const Options::Crypt::Encoding& enc = options.encoding;
+	return intern::encodedLength(enc.enc, in_len, enc.linebreaks ? enc.linelength : 0, Strings::eol[(int)enc.eol].size(), false);
+}
+
+size_t crypt::decryptedSizeBound(const Options::Crypt& options, size_t in_len)
+{
+	size_t length = intern::decodedLength(options.encoding.enc, in_len);
+	size_t key_len = options.key.length, iv_len, block_size;
+	if (options.segment_size && getCipherInfo(options.cipher, options.mode, key_len, iv_len, block_size) && block_size
+		&& (options.mode == Mode::gcm || options.mode == Mode::ccm || options.mode == Mode::eax)) {
+		// every complete segment and the rest of at least one tag
+		size_t tag_size = (options.mode == Mode::gcm) ? Constants::gcm_tag_size : ((options.mode == Mode::ccm) ? Constants::ccm_tag_size : Constants::eax_tag_size);
+		size_t rest = length % (options.segment_size + tag_size);
+		length = length / (options.segment_size + tag_size) * options.segment_size + ((rest > tag_size) ? rest - tag_size : 0);
+	}
+	return length;
+}
+
+size_t crypt::encrypt(const byte* in, size_t in_len, byte* out, size_t out_len, const Options::Crypt& options, InitData& init)
+{
+	if (!in || !in_len) {
+		throw CExc(CExc::Code::input_null);
+	}
+	if (!out || out_len < encryptedSize(options, in_len)) {
+		throw CExc(CExc::Code::output_buffer_too_small);
+	}
+	// the output of every step is copied out of temp, which keeps its capacity
+	size_t step = intern::spanStep(options);
+	std::basic_string<byte> temp;
+	temp.reserve(encryptedSize(options, std::min(in_len, step)));
+	size_t written = 0;
+	Encryptor encryptor(options, init, in_len);
+	for (size_t offset = 0; offset < in_len; offset += step) {
+		encryptor.update(in + offset, std::min(in_len - offset, step), temp);
+		intern::spanCopy(temp, out, out_len, written);
+	}
+	encryptor.finish(temp);
+	intern::spanCopy(temp, out, out_len, written);
+	return written;
+}
+
+size_t crypt::decrypt(const byte* in, size_t in_len, byte* out, size_t out_len, const Options::Crypt& options, InitData& init)
+{
+	if (!in || !in_len) {
+		throw CExc(CExc::Code::input_null);
+	}
+	if (!out) {
+		throw CExc(CExc::Code::output_buffer_too_small);
+	}
+	size_t step = intern::spanStep(options);
+	std::basic_string<byte> temp;
+	temp.reserve(decryptedSizeBound(options, std::min(in_len, step)));
+	size_t written = 0;
+	try {
+		Decryptor decryptor(options, init, (options.encoding.enc == Encoding::ascii) ? in_len : 0);
+		for (size_t offset = 0; offset < in_len; offset += step) {
+			decryptor.update(in + offset, std::min(in_len - offset, step), temp);
+			intern::spanCopy(temp, out, out_len, written);
 		}
-		case Encoding::base64:
-		{
-			StringSource(in, in_len, true, new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.linebreaks, options.linelength, CryptoPP::EOL(options.eol)));
-			break;
+		decryptor.finish(temp);
+		intern::spanCopy(temp, out, out_len, written);
+	} catch (...) {
+		intern::wipe(temp);
+		CryptoPP::SecureWipeBuffer(out, written);
+		throw;
+	}
+	intern::wipe(temp);
+	return written;
+}
+
+void crypt::hash(Options::Hash& options, std::basic_string<byte>& buffer, std::initializer_list<std::pair<const byte*, size_t>> in)
+{
+	try	{
+		using namespace CryptoPP;
+		using namespace std;
+
+		size_t keylength;
+		if (!getHashInfo(options.algorithm, options.digest_length, keylength)) {
+			throw CExc(CExc::Code::invalid_hash);
 		}
+		if (keylength != 0 && options.use_key && options.key.size() != keylength) {
+			throw CExc(CExc::Code::invalid_keylength);
 		}
-		break;
+
+		SecByteBlock digest;
+		std::unique_ptr<HashTransformation> phash(intern::getHashTransformation(options));
+		if (!phash) {
+			throw CExc(CExc::Code::invalid_hash);
+		}
+		digest.resize(phash->DigestSize());
+		for (const std::pair<const byte*, size_t>& i : in) {
+			phash->Update(i.first, i.second);
+		}
+		phash->Final(digest);
+		intern::encodeDigest(digest, options.encoding, buffer);
+	} catch (CExc& exc) {
+		throw exc;
+	} catch (...) {
+		throw CExc(CExc::Code::unexpected);
 	}
-	case Encoding::base16:
-	{
-		switch (options.to)
-		{
-		case Encoding::ascii:
-		{
-			StringSource(in, in_len, true, new HexDecoder(new StringSinkTemplate<std::basic_string<byte>>(buffer)));
-			break;
+}
+
+void crypt::hash(Options::Hash& options, std::basic_string<byte>& buffer, const std::string& path)
+{
+	try {
+		using namespace CryptoPP;
+		using namespace std;
+
+		SecByteBlock digest;
+		std::unique_ptr<HashTransformation> phash(intern::getHashTransformation(options));
+		if (!phash) {
+			throw CExc(CExc::Code::invalid_hash);
 		}
-		case Encoding::base32:
-		{
-			StringSource(in, in_len, true, new HexDecoder(new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.uppercase, groupsize, s_seperator)));
-			break;
+		digest.resize(phash->DigestSize());
+
+		MappedFile file;
+		if (file.open(path, MappedFile::sequential, false)) {
+			phash->Update(file.data(), file.size());
+			phash->Final(digest);
+		} else {
+			FileSource f(path.c_str(), true, new HashFilter(*phash, new ArraySink(digest, digest.size())));
 		}
-		case Encoding::base64:
-		{
-			StringSource(in, in_len, true, new HexDecoder(new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.linebreaks, options.linelength, CryptoPP::EOL(options.eol))));
-			break;
+
+		intern::encodeDigest(digest, options.encoding, buffer);
+	}
+	catch (CExc& exc) {
+		throw exc;
+	}
+	catch (...) {
+		throw CExc(CExc::Code::unexpected);
+	}
+}
+
+void crypt::hashMulti(std::vector<Options::Hash>& options, std::vector<std::basic_string<byte>>& buffers, const std::string& path, bool threads)
+{
+	MappedFile file;
+	if (!file.open(path, MappedFile::sequential, false)) {
+		// pipes and special files are read in blocks
+		std::ifstream f(path, std::ios::in | std::ios::binary);
+		if (!f.is_open()) {
+			throw CExc(CExc::Code::inputfile_read_fail);
+		}
+		hashMulti(options, buffers, f, threads);
+		return;
+	}
+	try {
+		std::vector<std::unique_ptr<CryptoPP::HashTransformation>> hashes;
+		intern::createHashes(options, hashes);
+		// every digest reads the mapping on its own
+		size_t own = threads ? 1 : hashes.size();
+		std::vector<std::thread> pool;
+		for (size_t i = own; i < hashes.size(); i++) {
+			pool.emplace_back([&file, &hashes, i] { hashes[i]->Update(file.data(), file.size()); });
 		}
+		// the digests of this thread take turns per block, so a file larger than the cache is read from disk only once
+		for (size_t pos = 0; own && pos < file.size(); pos += Constants::hash_block_size) {
+			size_t len = std::min(Constants::hash_block_size, file.size() - pos);
+			for (size_t i = 0; i < own; i++) {
+				hashes[i]->Update(file.data() + pos, len);
+			}
 		}
-		break;
+		for (auto& t : pool) {
+			t.join();
+		}
+		intern::finalHashes(options, hashes, buffers);
+	} catch (CExc& exc) {
+		throw exc;
+	} catch (...) {
+		throw CExc(CExc::Code::unexpected);
 	}
-	case Encoding::base32:
-	{
-		switch (options.to)
-		{
-		case Encoding::ascii:
-		{
-			StringSource(in, in_len, true, new Base32Decoder(new StringSinkTemplate<std::basic_string<byte>>(buffer)));
-			break;
+}
+
+void crypt::hashMulti(std::vector<Options::Hash>& options, std::vector<std::basic_string<byte>>& buffers, std::istream& in, bool threads)
+{
+	try {
+		std::vector<std::unique_ptr<CryptoPP::HashTransformation>> hashes;
+		intern::createHashes(options, hashes);
+
+		auto read = [&in](byte* data) -> size_t {
+			in.read(reinterpret_cast<char*>(data), Constants::hash_block_size);
+			if (in.bad()) {
+				throw CExc(CExc::Code::inputfile_read_fail);
+			}
+			return (size_t)in.gcount();
+		};
+
+		if (!threads || hashes.size() < 2) {
+			std::unique_ptr<byte[]> block(new byte[Constants::hash_block_size]);
+			size_t len;
+			while ((len = read(block.get())) > 0) {
+				for (auto& h : hashes) {
+					h->Update(block.get(), len);
+				}
+			}
+		} else {
+			// one thread per digest, so the slowest digest (or the disk) sets the pace
+			intern::HashRing ring(Constants::hash_ring_slots, Constants::hash_block_size, hashes.size());
+			std::vector<std::thread> pool;
+			for (size_t i = 0; i < hashes.size(); i++) {
+				pool.emplace_back([&ring, &hashes, i] {
+					const byte* data;
+					size_t len;
+					for (uint64_t pos = 0; ring.get(pos, data, len); pos++) {
+						hashes[i]->Update(data, len);
+						ring.release(pos);
+					}
+				});
+			}
+			try {
+				byte* block;
+				size_t len;
+				while ((len = read(block = ring.acquire())) > 0) {
+					ring.publish(len);
+				}
+			} catch (...) {
+				ring.close();
+				for (auto& t : pool) {
+					t.join();
+				}
+				throw;
+			}
+			ring.close();
+			for (auto& t : pool) {
+				t.join();
+			}
 		}
-		case Encoding::base16:
-		{
-			StringSource(in, in_len, true, new Base32Decoder(new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.uppercase, groupsize, s_seperator)));
-			break;
+		intern::finalHashes(options, hashes, buffers);
+	} catch (CExc& exc) {
+		throw exc;
+	} catch (...) {
+		throw CExc(CExc::Code::unexpected);
+	}
+}
+
+// ===========================================================================================================================================================================================
+
+crypt::Hasher::Hasher(const Options::Hash& opt) : encoding(opt.encoding)
+{
+	try {
+		size_t digest_length = opt.digest_length;
+		size_t keylength;
+		if (!getHashInfo(opt.algorithm, digest_length, keylength)) {
+			throw CExc(CExc::Code::invalid_hash);
 		}
-		case Encoding::base64:
-		{
-			StringSource(in, in_len, true, new Base32Decoder(new Base64Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.linebreaks, options.linelength, CryptoPP::EOL(options.eol))));
-			break;
+		if (keylength != 0 && opt.use_key && opt.key.size() != keylength) {
+			throw CExc(CExc::Code::invalid_keylength);
 		}
+		hash.reset(intern::getHashTransformation(opt));
+		if (!hash) {
+			throw CExc(CExc::Code::invalid_hash);
 		}
-		break;
+	} catch (CExc& exc) {
+		throw exc;
+	} catch (...) {
+		throw CExc(CExc::Code::unexpected);
 	}
-	case Encoding::base64:
-	{
-		switch (options.to)
+}
+
+crypt::Hasher::~Hasher()
+{
+}
+
+void crypt::Hasher::update(const byte* in, size_t in_len)
+{
+	if (!hash) {
+		throw CExc(CExc::Code::unexpected);
+	}
+	hash->Update(in, in_len);
+}
+
+void crypt::Hasher::final(std::basic_string<byte>& buffer)
+{
+	if (!hash) {
+		throw CExc(CExc::Code::unexpected);
+	}
+	try {
+		CryptoPP::SecByteBlock digest(hash->DigestSize());
+		hash->Final(digest);
+		hash.reset();
+		intern::encodeDigest(digest, encoding, buffer);
+	} catch (CExc& exc) {
+		throw exc;
+	} catch (...) {
+		throw CExc(CExc::Code::unexpected);
+	}
+}
+
+void crypt::deriveMasterKey(const Options::Crypt& options, MasterKey& master)
+{
+	try {
+		if (!master.salt.size()) {
+			master.salt.random(Constants::master_salt_size);
+		}
+		if (options.key.algorithm == KeyDerivation::bcrypt && master.salt.size() != 16) {
+			throw CExc(CExc::Code::invalid_bcrypt_saltlength);
+		}
+		// none: the key of every file is expanded from the raw key itself
+		master.key.resize(options.key.algorithm == KeyDerivation::none ? options.password.size() : Constants::master_key_size);
+		intern::calcKey(master.key, options.password, master.salt, options.key, options.threads);
+	} catch (CExc& exc) {
+		throw exc;
+	} catch (...) {
+		throw CExc(CExc::Code::unexpected);
+	}
+}
+
+void crypt::setScryptMemory(const ScryptMemory& settings)
+{
+	std::lock_guard<std::mutex> lock(intern::scrypt_memory_mutex);
+	intern::scrypt_memory = settings;
+}
+
+size_t crypt::getScryptMemory(const Options::Crypt::Key& key, size_t threads)
+{
+	if (!threads) {
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	return crypto_scrypt_memory(ipow<uint64_t>(2, key.options[0]), key.options[1], key.options[2], (uint32_t)std::min(threads, (size_t)64), 0);
+}
+
+void crypt::freeScryptMemory()
+{
+	intern::scrypt_workspace_local.free();
+}
+
+double crypt::measureKey(const Options::Crypt::Key& key, size_t threads)
+{
+	try {
+		return intern::timeKey(key, threads);
+	} catch (...) {
+		intern::rethrow();
+	}
+	return 0;
+}
+
+void crypt::calibrateKey(Options::Crypt::Key& key, double target, size_t memory, Calibration& result, size_t threads)
+{
+	if (!(target > 0)) {
+		throw CExc(CExc::Code::invalid_calibration);
+	}
+	if (!threads) {
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	try {
+		switch (key.algorithm)
 		{
-		case Encoding::ascii:
+		case KeyDerivation::pbkdf2:
 		{
-			StringSource(in, in_len, true, new Base64Decoder(new StringSinkTemplate<std::basic_string<byte>>(buffer)));
+			result.seconds = intern::searchKey(key, 2, Constants::pbkdf2_iter_min, Constants::pbkdf2_iter_max, false, target, threads);
+			result.memory = 0;
 			break;
 		}
-		case Encoding::base16:
+		case KeyDerivation::bcrypt:
 		{
-			StringSource(in, in_len, true, new Base64Decoder(new HexEncoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.uppercase, groupsize, s_seperator)));
+			result.seconds = intern::searchKey(key, 0, Constants::bcrypt_iter_min, Constants::bcrypt_iter_max, true, target, threads);
+			// S-boxes and P-array
+			result.memory = 4 * 256 * sizeof(uint32_t) + 18 * sizeof(uint32_t);
 			break;
 		}
-		case Encoding::base32:
+		case KeyDerivation::scrypt:
 		{
-			StringSource(in, in_len, true, new Base64Decoder(new Base32Encoder(new StringSinkTemplate<std::basic_string<byte>>(buffer), options.uppercase, groupsize, s_seperator)));
+			ScryptMemory settings;
+			{
+				std::lock_guard<std::mutex> lock(intern::scrypt_memory_mutex);
+				settings = intern::scrypt_memory;
+			}
+			if (memory && (!settings.limit || memory < settings.limit)) {
+				settings.limit = memory;
+			}
+			// largest N within the memory limit
+			size_t	t;
+			bool	narrow;
+			int		max = Constants::scrypt_N_min - 1;
+			for (int e = Constants::scrypt_N_min; e <= Constants::scrypt_N_max; e++) {
+				t = threads;
+				if (!intern::scryptBudget(ipow<uint64_t>(2, e), key.options[1], key.options[2], settings.limit, t, narrow)) {
+					break;
+				}
+				max = e;
+			}
+			if (max < Constants::scrypt_N_min) {
+				throw CExc(CExc::Code::scrypt_memory_limit);
+			}
+			result.seconds = intern::searchKey(key, 0, Constants::scrypt_N_min, max, true, target, threads, &settings);
+			t = threads;
+			result.memory = intern::scryptBudget(ipow<uint64_t>(2, key.options[0]), key.options[1], key.options[2], settings.limit, t, narrow);
+			intern::scrypt_workspace_local.free();
 			break;
 		}
+		default:
+			throw CExc(CExc::Code::calibration_no_cost);
 		}
-		break;
+	} catch (...) {
+		intern::rethrow();
+	}
+}
+
+void crypt::shake128(const byte* in, size_t in_len, byte* out, size_t out_len)
+{
+	Keccak_HashInstance keccak_inst;
+	if (Keccak_HashInitialize_SHAKE128(&keccak_inst) != 0) {
+		throw CExc(CExc::Code::keccak_shake_failed);
+	}
+	if (Keccak_HashUpdate(&keccak_inst, in, in_len * 8) != 0) {
+		throw CExc(CExc::Code::keccak_shake_failed);
+	}
+	if (Keccak_HashFinal(&keccak_inst, out) != 0) {
+		throw CExc(CExc::Code::keccak_shake_failed);
+	}
+	if (Keccak_HashSqueeze(&keccak_inst, out, out_len * 8) != 0) {
+		throw CExc(CExc::Code::keccak_shake_failed);
 	}
+}
+
+void crypt::shake128x4(const byte* const in[4], size_t in_len, byte* const out[4], size_t out_len)
+{
+	if (KeccakWidth1600times4_Sponge(1344, 256, in, in_len, 0x1F, out, out_len) != 0) {
+		throw CExc(CExc::Code::keccak_shake_failed);
+	}
+}
+
+void crypt::convert(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Convert& options)
+{
+	using namespace CryptoPP;
+	using namespace crypt;
+
+	if (options.from == options.to) {
+		return;
+	}
+	// base16 and base32 only know windows and unix line endings here, base64 all three
+	std::string eol = (options.to == Encoding::base64) ? Strings::eol[(int)options.eol] : ((options.eol == crypt::EOL::windows) ? "\r\n" : "\n");
+	size_t linelength = (options.linebreaks && options.linelength > 0) ? (size_t)options.linelength : 0;
+	Stats::Timer timer(Stats::Phase::encoding, in_len);
+
+	buffer.reserve(buffer.size() + convertedSize(options, in_len));
+	Codec::Decoder decoder(options.from, new Codec::Encoder(options.to, options.uppercase, linelength, eol, options.to == Encoding::base64 && options.linebreaks,
+		new StringSinkTemplate<std::basic_string<byte>>(buffer)));
+	decoder.Put(in, in_len);
+	decoder.MessageEnd();
+}
+
+size_t crypt::convert(const byte* in, size_t in_len, byte* out, size_t out_len, const Options::Convert& options)
+{
+	using namespace CryptoPP;
+	using namespace crypt;
+
+	if (options.from == options.to) {
+		return 0;
+	}
+	if (!out || out_len < convertedSize(options, in_len)) {
+		throw CExc(CExc::Code::output_buffer_too_small);
+	}
+	std::string eol = (options.to == Encoding::base64) ? Strings::eol[(int)options.eol] : ((options.eol == crypt::EOL::windows) ? "\r\n" : "\n");
+	size_t linelength = (options.linebreaks && options.linelength > 0) ? (size_t)options.linelength : 0;
+	Stats::Timer timer(Stats::Phase::encoding, in_len);
+
+	ArraySink* sink = new ArraySink(out, out_len);
+	Codec::Decoder decoder(options.from, new Codec::Encoder(options.to, options.uppercase, linelength, eol, options.to == Encoding::base64 && options.linebreaks, sink));
+	decoder.Put(in, in_len);
+	decoder.MessageEnd();
+	return (size_t)sink->TotalPutLength();
+}
+
+size_t crypt::convertedSize(const Options::Convert& options, size_t in_len)
+{
+	if (options.from == options.to) {
+		return 0;
 	}
+	size_t eol_length = (options.to == Encoding::base64) ? Strings::eol[(int)options.eol].size() : ((options.eol == crypt::EOL::windows) ? 2 : 1);
+	size_t linelength = (options.linebreaks && options.linelength > 0) ? (size_t)options.linelength : 0;
+	return intern::encodedLength(options.to, intern::decodedLength(options.from, in_len), linelength, eol_length, options.to == Encoding::base64 && options.linebreaks);
 }
 
@@ -17,13 +17,17 @@ GNU General Public License for more details.
 #define CRYPT_H_DEF
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <istream>
 #include "cryptopp/secblock.h"
+#include "crypt_arena.h"
 
 namespace crypt
 {
 	typedef CryptoPP::byte byte;
-	typedef std::basic_string<char, std::char_traits<char>, CryptoPP::AllocatorWithCleanup<char> > secure_string;
-	typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, CryptoPP::AllocatorWithCleanup<wchar_t> > secure_wstring;
+	typedef std::basic_string<char, std::char_traits<char>, SecureAllocator<char> > secure_string;
+	typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, SecureAllocator<wchar_t> > secure_wstring;
 
 	enum class Cipher : unsigned {		
 		threeway, aria, blowfish, btea, camellia, cast128, cast256, chacha20, des, des_ede2, des_ede3, desx, gost, idea, kalyna128, kalyna256, kalyna512, mars, panama, rc2, rc4, rc5, rc6, rijndael, saferk, safersk, salsa20, seal, seed, serpent, shacal2, shark, simon128, skipjack, sm4, sosemanuk, speck128, square, tea, threefish256, threefish512, threefish1024, twofish, wake, xsalsa20, xtea, COUNT
@@ -46,7 +50,7 @@ namespace crypt
 	};
 
 	enum class KeyDerivation : unsigned {
-		pbkdf2, bcrypt, scrypt, COUNT
+		pbkdf2, bcrypt, scrypt, hkdf, none, COUNT		// hkdf, none: the password is a key already (i.e. a keyfile), expanded with the salt or used as it is
 	};
 
 	enum class IV : unsigned {
@@ -61,6 +65,7 @@ namespace crypt
 		const int pbkdf2_iter_default = 5000;			// pbkdf2: default iterations
 		const int pbkdf2_iter_min =		1;				// pbkdf2: min iterations 
 		const int pbkdf2_iter_max =		10000000;		// pbkdf2: max iterations
+		const int pbkdf2_parallel_iter = 1000;			// pbkdf2: min iterations to compute the output blocks on several threads
 		const int bcrypt_iter_default = 8;				// bcrypt: default iterations (2^x)
 		const int bcrypt_iter_min =		4;				// bcrypt: min iterations (2^x)
 		const int bcrypt_iter_max =		32;				// bcrypt: max iterations (2^x)
@@ -73,12 +78,26 @@ namespace crypt
 		const int scrypt_p_default =	1;				// scrypt: default p
 		const int scrypt_p_min =		1;				// scrypt: min r
 		const int scrypt_p_max =		256;			// scrypt: max r
+		const Hash hkdf_default_hash = Hash::sha2;		// hkdf: default hash ( see enum Hash )
+		const int hkdf_default_hash_digest = 32;		// hkdf: hash digest length
 		const int gcm_iv_length =		16;				// IV-Length for gcm mode
 		const int ccm_iv_length =		13;				// IV-Length for ccm mode, possible values: 7-13
 		const int rand_char_max =		4096;			// max number of random bytes ( UserData::random() )
 		const int gcm_tag_size =		16;				// gcm tag size in bytes
 		const int ccm_tag_size =		16;				// ccm tag size in bytes
 		const int eax_tag_size =		16;				// eax tag size in bytes
+		const size_t stream_chunk_size = 65536;			// Encryptor/Decryptor: bytes processed per internal step
+		const size_t parallel_segment_size = 1048576;	// ctr/gcm: bytes per worker thread and step (multiple of 16)
+		const size_t parallel_min_size = 2097152;		// ctr/gcm: min input size for multi-threaded processing
+		const size_t segment_size_default = 1048576;	// segmented encryption: default plaintext bytes per segment
+		const size_t segment_size_min = 1024;			// segmented encryption: min segment size
+		const size_t segment_size_max = 268435456;		// segmented encryption: max segment size
+		const size_t segment_ccm_max = 65535;			// segmented encryption: max segment size for ccm (13 byte iv)
+		const size_t hash_block_size = 1048576;			// hashMulti: bytes read from the file at once
+		const size_t hash_ring_slots = 8;				// hashMulti: blocks buffered for the digest threads
+		const size_t secure_arena_size = 32768;			// SecureArena: locked bytes reserved for keys, passwords and plaintext
+		const size_t master_key_size = 32;				// MasterKey: bytes derived from the password
+		const size_t master_salt_size = 16;				// MasterKey: salt bytes (16: bcrypt)
 	};
 
 	class UserData
@@ -103,19 +122,30 @@ namespace crypt
 		void			clear();
 
 	private:
-		CryptoPP::SecByteBlock	data;
+		SecureBlock	data;
+	};
+
+	/* -- batch: the password is derived once (options.key and a salt of its own) into a master key. the key (and iv) of every
+		  encryption is expanded from it with hkdf-sha256 and the salt of the data (InitData::salt) -- */
+	struct MasterKey
+	{
+		SecureBlock		key;
+		UserData		salt;
 	};
 
 	namespace Options
 	{
 		struct Crypt
 		{
-			Crypt() : cipher(Cipher::rijndael), mode(Mode::gcm), iv(IV::random) {};
+			Crypt() : cipher(Cipher::rijndael), mode(Mode::gcm), iv(IV::random), threads(0), segment_size(0), master(NULL) {};
 
 			crypt::Cipher			cipher;
 			crypt::Mode				mode;
 			crypt::IV				iv;
 			crypt::UserData			password;
+			size_t					threads;		// worker threads for ctr/gcm, segments and scrypt lanes, 0: number of cores
+			size_t					segment_size;	// gcm/ccm/eax: plaintext bytes per authenticated segment, 0: one tag for all data
+			const MasterKey*		master;			// batch: key and iv are expanded from the master key instead of derived from the password
 
 			struct Key
 			{
@@ -169,8 +199,111 @@ namespace crypt
 		UserData		iv;
 		UserData		salt;
 		UserData		tag;
+		UserData		master_salt;	// salt of the MasterKey the key was expanded from, empty: key derived from the password
 	};
 	
+	/* -- common part of Encryptor and Decryptor -- */
+	class CryptStream
+	{
+	public:
+		virtual			~CryptStream();
+
+	protected:
+		class			Parallel;
+		class			Segments;
+
+						CryptStream(const Options::Crypt& opt, InitData& init_data);
+		void			initCipher(bool encryption, size_t data_length);
+		void			initDecryptionKey();
+		void			deriveKey(bool encryption);
+
+		const Options::Crypt&	options;
+		InitData&				init;
+		SecureBlock				tKey;
+		const byte*				ptVec;
+		size_t					key_len;
+		size_t					iv_len;
+		size_t					block_size;
+		size_t					tag_size;
+		size_t					data_length;
+		size_t					processed;
+		bool					finished;
+		std::unique_ptr<CryptoPP::SymmetricCipher>					cipher;
+		std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher>		aead;
+		std::unique_ptr<CryptoPP::BufferedTransformation>			filter;
+		std::unique_ptr<Parallel>									parallel;
+		std::unique_ptr<Segments>									segments;
+		std::basic_string<byte>*									output;		// out of the running update()/finish(): end of the filter chain
+		std::basic_string<byte>										queue;		// ciphertext only (public): not wiped
+		std::basic_string<byte, std::char_traits<byte>, SecureAllocator<byte>>	pending;	// plaintext held back by the Encryptor
+	};
+
+	/* -- incremental encryption: update() appends the output for every chunk, so memory does not grow with the input size.
+		  data_length is required upfront by ccm, without it ccm input is buffered until finish() -- */
+	class Encryptor : public CryptStream
+	{
+	public:
+				Encryptor(const Options::Crypt& options, InitData& init, size_t data_length = 0);
+		void	update(const byte* in, size_t in_len, std::basic_string<byte>& out);
+		void	finish(std::basic_string<byte>& out);
+
+	private:
+		void	process(const byte* in, size_t in_len, std::basic_string<byte>& out);
+	};
+
+	/* -- incremental decryption: data_length is the (decoded) length of the ciphertext, only needed by ccm.
+		  for gcm/ccm/eax the output must not be trusted before finish() returned -- */
+	class Decryptor : public CryptStream
+	{
+	public:
+				Decryptor(const Options::Crypt& options, InitData& init, size_t data_length = 0);
+		void	update(const byte* in, size_t in_len, std::basic_string<byte>& out);
+		void	finish(std::basic_string<byte>& out);
+
+	private:
+		void	process(const byte* in, size_t in_len, std::basic_string<byte>& out);
+	};
+
+	/* -- random access to data encrypted with Options::Crypt::segment_size: only the segments covering the requested range are decoded,
+		  decrypted and authenticated. in must stay valid for the lifetime of the reader -- */
+	class SeekableReader : public CryptStream
+	{
+	public:
+				SeekableReader(const Options::Crypt& options, InitData& init, const byte* in, size_t in_len);
+		/* -- length of the decrypted data -- */
+		size_t	size() const;
+		/* -- appends up to length bytes starting at offset -- */
+		void	read(size_t offset, size_t length, std::basic_string<byte>& out);
+
+	private:
+		void	decode(size_t offset, size_t length, std::basic_string<byte>& out);
+
+		const byte*	data;
+		size_t		data_len;
+		size_t		line_length;
+		size_t		eol_length;
+		size_t		chars;
+		size_t		bin_length;
+		size_t		plain_length;
+	};
+
+	/* -- incremental hash (keyed if options.use_key) of data that arrives in pieces -- */
+	class Hasher
+	{
+	public:
+				Hasher(const Options::Hash& options);
+				~Hasher();
+		void	update(const byte* in, size_t in_len);
+		/* -- digest in options.encoding, the hasher is done afterwards -- */
+		void	final(std::basic_string<byte>& buffer);
+
+	private:
+		Encoding										encoding;
+		std::unique_ptr<CryptoPP::HashTransformation>	hash;
+	};
+
+	/* -- derives the master key of a batch from options.password and options.key. a new random salt is chosen if master.salt is empty -- */
+	void	deriveMasterKey(const Options::Crypt& options, MasterKey& master);
 	/* -- check parameters of cipher or receive default values -- */
 	bool	getCipherInfo(crypt::Cipher cipher, crypt::Mode mode, size_t& key_length, size_t& iv_length, size_t& block_size);
 	/* -- check parameters of hash or receive default values -- */
@@ -179,14 +312,60 @@ namespace crypt
 	void	encrypt(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Crypt& options, InitData& init);
 	/* -- decrypt -- */
 	void	decrypt(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Crypt& options, InitData& init);
+	/* -- bytes of the tag encrypt() returns in InitData::tag, 0: no tag (no aead mode or every segment carries its own) -- */
+	size_t	getTagSize(const Options::Crypt& options);
+	/* -- exact number of bytes encrypt() appends for in_len bytes of input (padding, segment tags and encoding included) -- */
+	size_t	encryptedSize(const Options::Crypt& options, size_t in_len);
+	/* -- upper limit of the bytes decrypt() appends for in_len bytes of (encoded) ciphertext -- */
+	size_t	decryptedSizeBound(const Options::Crypt& options, size_t in_len);
+	/* -- encrypt into out, which needs at least encryptedSize() bytes. returns the number of bytes written -- */
+	size_t	encrypt(const byte* in, size_t in_len, byte* out, size_t out_len, const Options::Crypt& options, InitData& init);
+	/* -- decrypt into out, decryptedSizeBound() bytes are always enough. returns the number of bytes written, on failure out is wiped -- */
+	size_t	decrypt(const byte* in, size_t in_len, byte* out, size_t out_len, const Options::Crypt& options, InitData& init);
 	/* -- hash data -- */
 	void	hash(Options::Hash& options, std::basic_string<byte>& buffer, std::initializer_list<std::pair<const byte*, size_t>> in);
 	/* -- hash file -- */
 	void	hash(Options::Hash& options, std::basic_string<byte>& buffer, const std::string& path);
+	/* -- hash file with several algorithms while reading it only once, threads: one thread per digest -- */
+	void	hashMulti(std::vector<Options::Hash>& options, std::vector<std::basic_string<byte>>& buffers, const std::string& path, bool threads = true);
+	/* -- same for data read from a stream (i.e. std::cin) up to its end -- */
+	void	hashMulti(std::vector<Options::Hash>& options, std::vector<std::basic_string<byte>>& buffers, std::istream& in, bool threads = true);
+	/* -- scratch memory of scrypt: kept per thread and reused by following derivations -- */
+	struct ScryptMemory
+	{
+		ScryptMemory() : limit(0), hugepages(true), lock(false) {};
+		size_t	limit;			// max bytes for V, XY and B of all lanes, 0: no limit
+		bool	hugepages;		// MAP_HUGETLB or transparent huge pages
+		bool	lock;			// mlock the memory (best effort)
+	};
+	void	setScryptMemory(const ScryptMemory& settings);
+	/* -- bytes needed by scrypt with the given options and threads (including multi-lane smix), 0 if they do not fit into memory at all -- */
+	size_t	getScryptMemory(const Options::Crypt::Key& key, size_t threads);
+	/* -- wipes and frees the scratch memory of the calling thread -- */
+	void	freeScryptMemory();
+	/* -- seconds one derivation with the given options takes on this host, threads: as Options::Crypt::threads -- */
+	double	measureKey(const Options::Crypt::Key& key, size_t threads = 0);
+	/* -- result of calibrateKey() -- */
+	struct Calibration
+	{
+		Calibration() : seconds(0), memory(0) {};
+		double	seconds;		// measured time of one derivation with the chosen parameters
+		size_t	memory;			// predicted peak scratch memory in bytes (pbkdf2: 0)
+	};
+	/* -- searches the cost parameter of key.algorithm so that one derivation takes about target seconds on this host:
+			pbkdf2: iterations (hash of options[0] and [1]), bcrypt: exponent, scrypt: N (r and p of options[1] and [2]).
+			memory: max scrypt scratch memory in bytes, 0: only the limit of setScryptMemory() -- */
+	void	calibrateKey(Options::Crypt::Key& key, double target, size_t memory, Calibration& result, size_t threads = 0);
 	/* -- sha3 shake128 hash -- */
 	void	shake128(const byte* in, size_t in_len, byte* out, size_t out_len);
+	/* -- four sha3 shake128 hashes of inputs with the same length at once (4-way avx2 keccak if available) -- */
+	void	shake128x4(const byte* const in[4], size_t in_len, byte* const out[4], size_t out_len);
 	/* -- convert encoding -- */
 	void	convert(const byte* in, size_t in_len, std::basic_string<byte>& buffer, const Options::Convert& options);	
+	/* -- bytes convert() appends: exact for ascii input, otherwise an upper limit (line breaks and padding of the input are skipped) -- */
+	size_t	convertedSize(const Options::Convert& options, size_t in_len);
+	/* -- convert into out, convertedSize() bytes are always enough. returns the number of bytes written -- */
+	size_t	convert(const byte* in, size_t in_len, byte* out, size_t out_len, const Options::Convert& options);
 };
 
 #endif
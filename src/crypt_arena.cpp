@@ -0,0 +1,220 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include "crypt.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	const size_t slot_min = 16;
+	const size_t slot_classes = 9;	// 16, 32, ... 4096 bytes
+	const size_t slot_max = slot_min << (slot_classes - 1);
+	const size_t refill_bytes = 1024;	// slots taken from the arena at once by a thread
+
+	/* smallest class c with slot_min << c >= bytes */
+	size_t slotClass(size_t bytes)
+	{
+		size_t c = 0;
+		while ((slot_min << c) < bytes) {
+			c++;
+		}
+		return c;
+	}
+
+	/* slots are single linked lists, the pointer is kept in the (already wiped) slot itself */
+	inline void* pop(void*& head)
+	{
+		void* p = head;
+		head = *(void**)p;
+		return p;
+	}
+
+	inline void push(void*& head, void* p)
+	{
+		*(void**)p = head;
+		head = p;
+	}
+
+	/* the slots are cut from the reserved pages one after another. every thread keeps the slots it released in free lists of its own,
+	   the mutex is only needed to refill them and to take them back at the end of the thread */
+	class Arena
+	{
+	public:
+		Arena() : base(NULL), size(0), used(0), heap(0), locked(false)
+		{
+			for (size_t i = 0; i < slot_classes; i++) {
+				free_slots[i] = NULL;
+			}
+			size_t length = crypt::Constants::secure_arena_size;
+#ifdef _WIN32
+			void* p = VirtualAlloc(NULL, length, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+			if (p) {
+				locked = (VirtualLock(p, length) != 0);
+				base = (crypt::byte*)p;
+				size = length;
+			}
+#else
+#ifdef MAP_NOCORE
+			void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE | MAP_NOCORE, -1, 0);
+#else
+			void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+#endif
+			if (p != MAP_FAILED) {
+#ifdef MADV_DONTDUMP
+				madvise(p, length, MADV_DONTDUMP);
+#endif
+				// best effort: RLIMIT_MEMLOCK may be too small
+				locked = (mlock(p, length) == 0);
+				base = (crypt::byte*)p;
+				size = length;
+			}
+#endif
+		}
+
+		bool owns(const void* p) const
+		{
+			return p >= base && p < base + size;
+		}
+
+		/* list: empty free list of class c of a thread */
+		void refill(size_t c, void*& list)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (free_slots[c]) {
+				list = free_slots[c];
+				free_slots[c] = NULL;
+				return;
+			}
+			size_t slot = slot_min << c;
+			for (size_t n = (std::max)(refill_bytes / slot, (size_t)1); n > 0 && size - used >= slot; n--) {
+				push(list, base + used);
+				used += slot;
+			}
+		}
+
+		/* slots of a thread that ended (lists) or of a thread without a cache (a single slot) */
+		void release(size_t c, void* list)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (list) {
+				push(free_slots[c], pop(list));
+			}
+		}
+
+		void* allocateHeap(size_t bytes)
+		{
+			void* p = CryptoPP::UnalignedAllocate(bytes);
+			heap++;
+			return p;
+		}
+
+		void deallocateHeap(void* p)
+		{
+			heap--;
+			CryptoPP::UnalignedDeallocate(p);
+		}
+
+		void info(crypt::SecureArena::Info& result)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			result.size = size;
+			result.used = used;
+			result.heap = heap;
+			result.locked = locked;
+		}
+
+	private:
+		crypt::byte*			base;
+		size_t					size;
+		size_t					used;
+		std::atomic<size_t>		heap;
+		bool					locked;
+		void*					free_slots[slot_classes];
+		std::mutex				mutex;
+	};
+
+	/* never destroyed: static secure strings may be released after the end of main() */
+	Arena& arena()
+	{
+		static Arena* instance = new Arena();
+		return *instance;
+	}
+
+	/* free lists of the calling thread */
+	thread_local bool cache_closed = false;
+
+	struct Cache
+	{
+		Cache()
+		{
+			for (size_t i = 0; i < slot_classes; i++) {
+				free_slots[i] = NULL;
+			}
+		}
+
+		~Cache()
+		{
+			// later releases of this thread (destructors of static objects) go straight to the arena
+			cache_closed = true;
+			for (size_t i = 0; i < slot_classes; i++) {
+				arena().release(i, free_slots[i]);
+			}
+		}
+
+		void* free_slots[slot_classes];
+	};
+
+	thread_local Cache cache;
+}
+
+void* crypt::SecureArena::allocate(size_t bytes)
+{
+	if (bytes <= slot_max && !cache_closed) {
+		size_t c = slotClass(bytes);
+		void*& list = cache.free_slots[c];
+		if (!list) {
+			arena().refill(c, list);
+		}
+		if (list) {
+			return pop(list);
+		}
+	}
+	return arena().allocateHeap(bytes);
+}
+
+void crypt::SecureArena::deallocate(void* p, size_t bytes)
+{
+	CryptoPP::SecureWipeBuffer((byte*)p, bytes);
+	if (!arena().owns(p)) {
+		arena().deallocateHeap(p);
+	} else if (!cache_closed) {
+		push(cache.free_slots[slotClass(bytes)], p);
+	} else {
+		*(void**)p = NULL;
+		arena().release(slotClass(bytes), p);
+	}
+}
+
+void crypt::SecureArena::info(Info& result)
+{
+	arena().info(result);
+}
@@ -0,0 +1,89 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef CRYPT_ARENA_H_DEF
+#define CRYPT_ARENA_H_DEF
+
+#include <cstddef>
+#include "cryptopp/secblock.h"
+
+namespace crypt
+{
+	/* -- memory for keys, passwords and plaintext: a few pages locked into ram (and excluded from core dumps) are reserved on first use
+		  and handed out in slots of 16 to 4096 bytes without heap calls. released slots are wiped and reused by the same thread.
+		  larger blocks or a full arena fall back to the heap, wiped like CryptoPP::AllocatorWithCleanup -- */
+	namespace SecureArena
+	{
+		void*	allocate(size_t bytes);
+		void	deallocate(void* p, size_t bytes);
+
+		struct Info
+		{
+			Info() : size(0), used(0), heap(0), locked(false) {};
+			size_t	size;		// bytes reserved for the arena, 0: no arena (the reservation failed)
+			size_t	used;		// bytes of the arena cut into slots so far
+			size_t	heap;		// blocks in use that did not fit into the arena
+			bool	locked;		// mlock/VirtualLock succeeded
+		};
+		void	info(Info& result);
+	};
+
+	template <class T>
+	class SecureAllocator : public CryptoPP::AllocatorBase<T>
+	{
+	public:
+		typedef typename CryptoPP::AllocatorBase<T>::value_type			value_type;
+		typedef typename CryptoPP::AllocatorBase<T>::size_type			size_type;
+		typedef typename CryptoPP::AllocatorBase<T>::difference_type	difference_type;
+		typedef typename CryptoPP::AllocatorBase<T>::pointer			pointer;
+		typedef typename CryptoPP::AllocatorBase<T>::const_pointer		const_pointer;
+		typedef typename CryptoPP::AllocatorBase<T>::reference			reference;
+		typedef typename CryptoPP::AllocatorBase<T>::const_reference	const_reference;
+
+		SecureAllocator() {};
+		template <class V> SecureAllocator(const SecureAllocator<V>&) {};
+
+		pointer allocate(size_type size, const void* ptr = NULL)
+		{
+			this->CheckSize(size);
+			if (size == 0) {
+				return NULL;
+			}
+			return (pointer)SecureArena::allocate(size * sizeof(T));
+		}
+
+		void deallocate(void* ptr, size_type size)
+		{
+			if (ptr) {
+				SecureArena::deallocate(ptr, size * sizeof(T));
+			}
+		}
+
+		pointer reallocate(T* oldPtr, size_type oldSize, size_type newSize, bool preserve)
+		{
+			return CryptoPP::StandardReallocate(*this, oldPtr, oldSize, newSize, preserve);
+		}
+
+		template <class V> struct rebind { typedef SecureAllocator<V> other; };
+	};
+
+	/* all instances share the arena */
+	template <class T, class V> bool operator==(const SecureAllocator<T>&, const SecureAllocator<V>&) { return true; };
+	template <class T, class V> bool operator!=(const SecureAllocator<T>&, const SecureAllocator<V>&) { return false; };
+
+	typedef CryptoPP::SecBlock<CryptoPP::byte, SecureAllocator<CryptoPP::byte> > SecureBlock;
+};
+
+#endif
@@ -0,0 +1,405 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "crypt_codec.h"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "scrypt/config.h"
+
+/* kernels: encode/decode as many whole groups from the front as they can and return the number of bytes/characters consumed.
+   decoders stop in front of the first block containing a character outside of the alphabet and may write up to 8 bytes behind
+   the decoded ones */
+#ifdef CPUSUPPORT_X86_SSE41
+// runtime detection of scrypt/cpusupport_x86_sse41.c
+extern "C" int cpusupport_x86_sse41_detect_1(void);
+
+namespace crypt { namespace Codec { namespace sse41 {
+	size_t encode16(const unsigned char* in, size_t length, unsigned char* out, const unsigned char* alphabet);
+	size_t decode16(const unsigned char* in, size_t length, unsigned char* out);
+	size_t encode64(const unsigned char* in, size_t length, unsigned char* out);
+	size_t decode64(const unsigned char* in, size_t length, unsigned char* out);
+} } }
+#endif
+
+#ifdef CPUSUPPORT_X86_AVX2
+// runtime detection of scrypt/cpusupport_x86_avx2.c
+extern "C" int cpusupport_x86_avx2_detect_1(void);
+
+namespace crypt { namespace Codec { namespace avx2 {
+	size_t encode16(const unsigned char* in, size_t length, unsigned char* out, const unsigned char* alphabet);
+	size_t decode16(const unsigned char* in, size_t length, unsigned char* out);
+	size_t encode64(const unsigned char* in, size_t length, unsigned char* out);
+	size_t decode64(const unsigned char* in, size_t length, unsigned char* out);
+} } }
+#endif
+
+namespace
+{
+	using crypt::byte;
+	using crypt::Encoding;
+
+	const byte alphabet16[2][17] = { "0123456789abcdef", "0123456789ABCDEF" };
+	const byte alphabet32[2][33] = { "abcdefghijkmnpqrstuvwxyz23456789", "ABCDEFGHIJKMNPQRSTUVWXYZ23456789" };
+	const byte alphabet64[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const byte padding64 = '=';
+	const byte invalid = 0xFF;
+	const size_t kernel_slack = 8;
+
+	/* bytes and characters per group, bits per character */
+	struct Group
+	{
+		size_t bytes;
+		size_t chars;
+		size_t bits;
+	};
+
+	const Group& getGroup(Encoding enc)
+	{
+		static const Group groups[] = { { 1, 1, 8 }, { 1, 2, 4 }, { 5, 8, 5 }, { 3, 4, 6 } };
+		return groups[(size_t)enc];
+	}
+
+	/* decoding tables of the crypto++ decoders: base16 and base32 ignore case */
+	struct Lookup
+	{
+		byte base16[256];
+		byte base32[256];
+		byte base64[256];
+
+		Lookup()
+		{
+			memset(base16, invalid, 256);
+			memset(base32, invalid, 256);
+			memset(base64, invalid, 256);
+			for (byte i = 0; i < 16; i++) {
+				base16[alphabet16[0][i]] = base16[alphabet16[1][i]] = i;
+			}
+			for (byte i = 0; i < 32; i++) {
+				base32[alphabet32[0][i]] = base32[alphabet32[1][i]] = i;
+			}
+			for (byte i = 0; i < 64; i++) {
+				base64[alphabet64[i]] = i;
+			}
+		}
+	};
+
+	const Lookup& getLookup()
+	{
+		static const Lookup lookup;
+		return lookup;
+	}
+
+	size_t encodeNone(const byte*, size_t, byte*, const byte*) { return 0; }
+	size_t encodeNone(const byte*, size_t, byte*) { return 0; }
+	size_t decodeNone(const byte*, size_t, byte*) { return 0; }
+
+	struct Kernels
+	{
+		size_t(*encode16)(const byte* in, size_t length, byte* out, const byte* alphabet);
+		size_t(*decode16)(const byte* in, size_t length, byte* out);
+		size_t(*encode64)(const byte* in, size_t length, byte* out);
+		size_t(*decode64)(const byte* in, size_t length, byte* out);
+	};
+
+	Kernels selectKernels()
+	{
+		Kernels k = { encodeNone, decodeNone, encodeNone, decodeNone };
+		#ifdef CPUSUPPORT_X86_AVX2
+		if (cpusupport_x86_avx2_detect_1()) {
+			using namespace crypt::Codec::avx2;
+			k = { encode16, decode16, encode64, decode64 };
+			return k;
+		}
+		#endif
+		#ifdef CPUSUPPORT_X86_SSE41
+		if (cpusupport_x86_sse41_detect_1()) {
+			using namespace crypt::Codec::sse41;
+			k = { encode16, decode16, encode64, decode64 };
+		}
+		#endif
+		return k;
+	}
+
+	const Kernels& getKernels()
+	{
+		static const Kernels kernels = selectKernels();
+		return kernels;
+	}
+
+	/* length: multiple of the group size. returns the number of characters */
+	size_t encodeGroups(Encoding enc, const byte* in, size_t length, byte* out, const byte* alphabet)
+	{
+		size_t i = 0;
+		byte* o = out;
+		switch (enc)
+		{
+		case Encoding::base16:
+			i = getKernels().encode16(in, length, o, alphabet);
+			o += i * 2;
+			for (; i < length; i++, o += 2) {
+				o[0] = alphabet[in[i] >> 4];
+				o[1] = alphabet[in[i] & 0x0F];
+			}
+			break;
+		case Encoding::base32:
+			for (; i < length; i += 5, o += 8) {
+				uint64_t v = ((uint64_t)in[i] << 32) | ((uint64_t)in[i + 1] << 24) | ((uint64_t)in[i + 2] << 16) | ((uint64_t)in[i + 3] << 8) | in[i + 4];
+				for (int c = 0; c < 8; c++) {
+					o[c] = alphabet[(v >> (35 - 5 * c)) & 0x1F];
+				}
+			}
+			break;
+		case Encoding::base64:
+			i = getKernels().encode64(in, length, o);
+			o += i / 3 * 4;
+			for (; i < length; i += 3, o += 4) {
+				uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+				o[0] = alphabet[v >> 18];
+				o[1] = alphabet[(v >> 12) & 0x3F];
+				o[2] = alphabet[(v >> 6) & 0x3F];
+				o[3] = alphabet[v & 0x3F];
+			}
+			break;
+		}
+		return o - out;
+	}
+
+	/* values: one group of decoded characters. returns the number of bytes */
+	size_t packGroup(Encoding enc, const byte* values, byte* out)
+	{
+		switch (enc)
+		{
+		case Encoding::base16:
+			out[0] = (byte)((values[0] << 4) | values[1]);
+			return 1;
+		case Encoding::base32:
+		{
+			uint64_t v = 0;
+			for (int c = 0; c < 8; c++) {
+				v = (v << 5) | values[c];
+			}
+			for (int b = 0; b < 5; b++) {
+				out[b] = (byte)(v >> (32 - 8 * b));
+			}
+			return 5;
+		}
+		case Encoding::base64:
+		{
+			uint32_t v = ((uint32_t)values[0] << 18) | ((uint32_t)values[1] << 12) | ((uint32_t)values[2] << 6) | values[3];
+			out[0] = (byte)(v >> 16);
+			out[1] = (byte)(v >> 8);
+			out[2] = (byte)v;
+			return 3;
+		}
+		}
+		return 0;
+	}
+
+	/* decodes whole groups up to the first one with a character outside of the alphabet. returns the number of characters consumed,
+	   the number of bytes written is consumed / chars * bytes of the group (+ up to kernel_slack bytes of garbage) */
+	size_t decodeGroups(Encoding enc, const byte* in, size_t length, byte* out, const byte* lookup)
+	{
+		const Group& group = getGroup(enc);
+		size_t i = 0;
+		switch (enc)
+		{
+		case Encoding::base16: i = getKernels().decode16(in, length, out); break;
+		case Encoding::base64: i = getKernels().decode64(in, length, out); break;
+		default: break;
+		}
+		out += i / group.chars * group.bytes;
+		for (; length - i >= group.chars; i += group.chars) {
+			byte values[8];
+			byte check = 0;
+			for (size_t c = 0; c < group.chars; c++) {
+				values[c] = lookup[in[i + c]];
+				check |= values[c];
+			}
+			if (check & 0x80) {
+				break;
+			}
+			out += packGroup(enc, values, out);
+		}
+		return i;
+	}
+}
+
+crypt::Codec::Encoder::Encoder(Encoding e, bool uppercase, size_t line_length, const std::string& line_end, bool term, CryptoPP::BufferedTransformation* attachment)
+	: enc(e), linelength(line_length), eol(line_end), terminate(term), column(0), pending_len(0), out_len(0)
+{
+	switch (enc)
+	{
+	case Encoding::base16: alphabet = alphabet16[uppercase ? 1 : 0]; break;
+	case Encoding::base32: alphabet = alphabet32[uppercase ? 1 : 0]; break;
+	default: alphabet = alphabet64; break;
+	}
+	Detach(attachment);
+}
+
+size_t crypt::Codec::Encoder::Put2(const byte* in, size_t length, int messageEnd, bool blocking)
+{
+	if (enc == Encoding::ascii) {
+		return AttachedTransformation()->Put2(in, length, messageEnd, blocking);
+	}
+	const Group& group = getGroup(enc);
+
+	// upper bound of the output: line breaks in front of every line and the terminator
+	size_t chars = ((pending_len + length) / group.bytes + 1) * group.chars;
+	size_t required = chars + (linelength ? (chars / linelength + 2) * eol.size() : eol.size());
+	if (out.size() < required) {
+		out.resize(required);
+	}
+	out_len = 0;
+
+	if (pending_len) {
+		size_t n = std::min(group.bytes - pending_len, length);
+		memcpy(pending + pending_len, in, n);
+		pending_len += n;
+		in += n;
+		length -= n;
+		if (pending_len == group.bytes) {
+			byte temp[8];
+			emit(temp, encodeGroups(enc, pending, group.bytes, temp, alphabet));
+			pending_len = 0;
+		}
+	}
+	if (length) {
+		size_t full = length / group.bytes * group.bytes;
+		encode(in, full);
+		pending_len = length - full;
+		memcpy(pending, in + full, pending_len);
+	}
+	if (messageEnd) {
+		if (pending_len) {
+			// crypto++: as many characters as needed for the remaining bits, base64 pads the group with '='
+			byte temp[8];
+			memset(pending + pending_len, 0, group.bytes - pending_len);
+			encodeGroups(enc, pending, group.bytes, temp, alphabet);
+			size_t count = (pending_len * 8 + group.bits - 1) / group.bits;
+			if (enc == Encoding::base64) {
+				memset(temp + count, padding64, group.chars - count);
+				count = group.chars;
+			}
+			emit(temp, count);
+			pending_len = 0;
+		}
+		if (terminate) {
+			memcpy(&out[out_len], eol.data(), eol.size());
+			out_len += eol.size();
+		}
+		column = 0;
+	}
+	return AttachedTransformation()->Put2(out.data(), out_len, messageEnd, blocking);
+}
+
+/* length: multiple of the group size. with line breaks the kernels still get long runs: blocks are encoded into scratch and then split into lines */
+void crypt::Codec::Encoder::encode(const byte* in, size_t length)
+{
+	if (!linelength) {
+		out_len += encodeGroups(enc, in, length, &out[out_len], alphabet);
+		return;
+	}
+	const Group& group = getGroup(enc);
+	const size_t block = group.bytes * 4096;
+	if (scratch.size() < group.chars * 4096) {
+		scratch.resize(group.chars * 4096);
+	}
+	for (size_t i = 0; i < length; i += block) {
+		size_t n = std::min(block, length - i);
+		emit(scratch.data(), encodeGroups(enc, in + i, n, &scratch[0], alphabet));
+	}
+}
+
+/* writes characters with crypto++ Grouper semantics: the line break comes in front of the first character of the next line */
+void crypt::Codec::Encoder::emit(const byte* chars, size_t count)
+{
+	if (!linelength) {
+		memcpy(&out[out_len], chars, count);
+		out_len += count;
+		return;
+	}
+	while (count) {
+		if (column == linelength) {
+			memcpy(&out[out_len], eol.data(), eol.size());
+			out_len += eol.size();
+			column = 0;
+		}
+		size_t n = std::min(count, linelength - column);
+		memcpy(&out[out_len], chars, n);
+		out_len += n;
+		column += n;
+		chars += n;
+		count -= n;
+	}
+}
+
+crypt::Codec::Decoder::Decoder(Encoding e, CryptoPP::BufferedTransformation* attachment) : enc(e), count(0)
+{
+	switch (enc)
+	{
+	case Encoding::base16: lookup = getLookup().base16; break;
+	case Encoding::base32: lookup = getLookup().base32; break;
+	default: lookup = getLookup().base64; break;
+	}
+	Detach(attachment);
+}
+
+size_t crypt::Codec::Decoder::Put2(const byte* in, size_t length, int messageEnd, bool blocking)
+{
+	if (enc == Encoding::ascii) {
+		return AttachedTransformation()->Put2(in, length, messageEnd, blocking);
+	}
+	const Group& group = getGroup(enc);
+
+	// one more group for the characters of the last call, one for the remaining bits
+	size_t required = (length / group.chars + 2) * group.bytes + kernel_slack;
+	if (out.size() < required) {
+		out.resize(required);
+	}
+	size_t out_len = 0;
+	size_t i = 0;
+	while (i < length) {
+		if (!count) {
+			size_t n = decodeGroups(enc, in + i, length - i, &out[out_len], lookup);
+			i += n;
+			out_len += n / group.chars * group.bytes;
+			if (i == length) {
+				break;
+			}
+		}
+		// crypto++ skips characters outside of the alphabet
+		byte value = lookup[in[i++]];
+		if (value == invalid) {
+			continue;
+		}
+		values[count++] = value;
+		if (count == group.chars) {
+			out_len += packGroup(enc, values, &out[out_len]);
+			count = 0;
+		}
+	}
+	if (messageEnd && count) {
+		// crypto++ outputs the complete bytes of an unfinished group
+		byte temp[5];
+		memset(values + count, 0, group.chars - count);
+		packGroup(enc, values, temp);
+		size_t n = count * group.bits / 8;
+		memcpy(&out[out_len], temp, n);
+		out_len += n;
+		count = 0;
+	}
+	return AttachedTransformation()->Put2(out.data(), out_len, messageEnd, blocking);
+}
@@ -0,0 +1,72 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef CRYPT_CODEC_H_DEF
+#define CRYPT_CODEC_H_DEF
+
+#include <string>
+#include "crypt.h"
+#include "cryptopp/filters.h"
+
+namespace crypt
+{
+	/* -- base16, base32 and base64 filters with the exact output of the crypto++ Hex-, Base32- and Base64-Encoders/Decoders
+		  (alphabets, padding, line breaks). whole groups are processed by sse4.1 or avx2 kernels if the cpu supports them -- */
+	namespace Codec
+	{
+		class Encoder : public CryptoPP::Filter
+		{
+		public:
+			/* linelength 0: no line breaks. terminate: eol is appended to the last line as well (like crypto++ Base64Encoder does) */
+					Encoder(Encoding enc, bool uppercase, size_t linelength, const std::string& eol, bool terminate, CryptoPP::BufferedTransformation* attachment = NULL);
+			size_t	Put2(const byte* in, size_t length, int messageEnd, bool blocking);
+			bool	IsolatedFlush(bool hardFlush, bool blocking) { return false; };
+
+		private:
+			void	emit(const byte* chars, size_t count);
+			void	encode(const byte* in, size_t length);
+
+			Encoding				enc;
+			const byte*				alphabet;
+			size_t					linelength;
+			std::string				eol;
+			bool					terminate;
+			size_t					column;
+			byte					pending[5];
+			size_t					pending_len;
+			std::basic_string<byte>	scratch;
+			std::basic_string<byte>	out;
+			size_t					out_len;
+		};
+
+		/* characters outside of the alphabet (line breaks, padding, whitespace) are skipped, base16 and base32 ignore case */
+		class Decoder : public CryptoPP::Filter
+		{
+		public:
+					Decoder(Encoding enc, CryptoPP::BufferedTransformation* attachment = NULL);
+			size_t	Put2(const byte* in, size_t length, int messageEnd, bool blocking);
+			bool	IsolatedFlush(bool hardFlush, bool blocking) { return false; };
+
+		private:
+			Encoding				enc;
+			const byte*				lookup;
+			byte					values[8];
+			size_t					count;
+			std::basic_string<byte>	out;
+		};
+	};
+};
+
+#endif
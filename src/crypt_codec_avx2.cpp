@@ -0,0 +1,149 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+// compiled with -mavx2 and only called after the runtime check of scrypt/cpusupport_x86_avx2.c,
+// so no other headers of nppcrypt or crypto++ are included here
+
+#include <cstddef>
+#include "scrypt/config.h"
+
+#ifdef CPUSUPPORT_X86_AVX2
+#include <immintrin.h>
+
+namespace
+{
+	/* 12 bytes in the first three quarters of each lane -> 32 sextets */
+	inline __m256i reshuffle64(__m256i v)
+	{
+		v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+		const __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+		const __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+		return _mm256_or_si256(t0, t1);
+	}
+
+	/* sextets -> A-Z a-z 0-9 + / */
+	inline __m256i translate64(__m256i v)
+	{
+		const __m256i offsets = _mm256_setr_epi8(
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+		__m256i index = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+		index = _mm256_sub_epi8(index, _mm256_cmpgt_epi8(v, _mm256_set1_epi8(25)));
+		return _mm256_add_epi8(v, _mm256_shuffle_epi8(offsets, index));
+	}
+
+	/* hex characters -> nibbles, false if one of them is not a hex character */
+	inline bool values16(__m256i v, __m256i& values)
+	{
+		const __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+		const __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+		const __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+		const __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+		if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha)) != -1) {
+			return false;
+		}
+		values = _mm256_or_si256(_mm256_and_si256(is_digit, digit), _mm256_and_si256(is_alpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+		return true;
+	}
+}
+
+namespace crypt
+{
+	namespace Codec
+	{
+		namespace avx2
+		{
+			size_t encode16(const unsigned char* in, size_t length, unsigned char* out, const unsigned char* alphabet)
+			{
+				const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)alphabet));
+				const __m256i mask = _mm256_set1_epi8(0x0F);
+				size_t i = 0;
+				for (; length - i >= 32; i += 32, out += 64) {
+					const __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+					const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+					const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+					// unpack works per lane: bytes 0-7 and 16-23, 8-15 and 24-31
+					const __m256i a = _mm256_unpacklo_epi8(hi, lo);
+					const __m256i b = _mm256_unpackhi_epi8(hi, lo);
+					_mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(a, b, 0x20));
+					_mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+				}
+				return i;
+			}
+
+			size_t decode16(const unsigned char* in, size_t length, unsigned char* out)
+			{
+				const __m256i weights = _mm256_set1_epi16(0x0110);
+				size_t i = 0;
+				for (; length - i >= 64; i += 64, out += 32) {
+					__m256i v0, v1;
+					if (!values16(_mm256_loadu_si256((const __m256i*)(in + i)), v0) || !values16(_mm256_loadu_si256((const __m256i*)(in + i + 32)), v1)) {
+						break;
+					}
+					const __m256i packed = _mm256_packus_epi16(_mm256_maddubs_epi16(v0, weights), _mm256_maddubs_epi16(v1, weights));
+					_mm256_storeu_si256((__m256i*)out, _mm256_permute4x64_epi64(packed, 0xD8));
+				}
+				return i;
+			}
+
+			size_t encode64(const unsigned char* in, size_t length, unsigned char* out)
+			{
+				// two lanes of 16 bytes at offsets 0 and 12: 28 bytes are loaded for 24 encoded
+				size_t i = 0;
+				for (; length - i >= 28; i += 24, out += 32) {
+					const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))), _mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+					_mm256_storeu_si256((__m256i*)out, translate64(reshuffle64(v)));
+				}
+				return i;
+			}
+
+			size_t decode64(const unsigned char* in, size_t length, unsigned char* out)
+			{
+				// 32 bytes are stored for 24 decoded
+				const __m256i lut_lo = _mm256_setr_epi8(
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+				const __m256i lut_hi = _mm256_setr_epi8(
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+				const __m256i lut_roll = _mm256_setr_epi8(
+					0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+					0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+				const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+				size_t i = 0;
+				for (; length - i >= 32; i += 32, out += 24) {
+					__m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+					const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+					const __m256i lo_nibbles = _mm256_and_si256(v, mask_2f);
+					if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), _mm256_shuffle_epi8(lut_hi, hi_nibbles))) {
+						break;
+					}
+					const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, mask_2f), hi_nibbles));
+					v = _mm256_add_epi8(v, roll);
+					v = _mm256_madd_epi16(_mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+					v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+						2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+						2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+					_mm256_storeu_si256((__m256i*)out, _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)));
+				}
+				return i;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+// compiled with -mssse3 -msse4.1 and only called after the runtime check of scrypt/cpusupport_x86_sse41.c,
+// so no other headers of nppcrypt or crypto++ are included here
+
+#include <cstddef>
+#include "scrypt/config.h"
+
+#ifdef CPUSUPPORT_X86_SSE41
+#include <smmintrin.h>
+
+namespace
+{
+	/* 12 bytes in the first three quarters of v -> 16 sextets */
+	inline __m128i reshuffle64(__m128i v)
+	{
+		v = _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+		const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+		const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+		return _mm_or_si128(t0, t1);
+	}
+
+	/* sextets -> A-Z a-z 0-9 + / */
+	inline __m128i translate64(__m128i v)
+	{
+		const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+		__m128i index = _mm_subs_epu8(v, _mm_set1_epi8(51));
+		index = _mm_sub_epi8(index, _mm_cmpgt_epi8(v, _mm_set1_epi8(25)));
+		return _mm_add_epi8(v, _mm_shuffle_epi8(offsets, index));
+	}
+
+	/* hex characters -> nibbles, false if one of them is not a hex character */
+	inline bool values16(__m128i v, __m128i& values)
+	{
+		const __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+		const __m128i alpha = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+		const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+		const __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+		if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF) {
+			return false;
+		}
+		values = _mm_or_si128(_mm_and_si128(is_digit, digit), _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+		return true;
+	}
+}
+
+namespace crypt
+{
+	namespace Codec
+	{
+		namespace sse41
+		{
+			size_t encode16(const unsigned char* in, size_t length, unsigned char* out, const unsigned char* alphabet)
+			{
+				const __m128i lut = _mm_loadu_si128((const __m128i*)alphabet);
+				const __m128i mask = _mm_set1_epi8(0x0F);
+				size_t i = 0;
+				for (; length - i >= 16; i += 16, out += 32) {
+					const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+					const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+					const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+					_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+					_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
+				}
+				return i;
+			}
+
+			size_t decode16(const unsigned char* in, size_t length, unsigned char* out)
+			{
+				const __m128i weights = _mm_set1_epi16(0x0110);
+				size_t i = 0;
+				for (; length - i >= 32; i += 32, out += 16) {
+					__m128i v0, v1;
+					if (!values16(_mm_loadu_si128((const __m128i*)(in + i)), v0) || !values16(_mm_loadu_si128((const __m128i*)(in + i + 16)), v1)) {
+						break;
+					}
+					_mm_storeu_si128((__m128i*)out, _mm_packus_epi16(_mm_maddubs_epi16(v0, weights), _mm_maddubs_epi16(v1, weights)));
+				}
+				return i;
+			}
+
+			size_t encode64(const unsigned char* in, size_t length, unsigned char* out)
+			{
+				// 16 bytes are loaded for 12 encoded
+				size_t i = 0;
+				for (; length - i >= 16; i += 12, out += 16) {
+					_mm_storeu_si128((__m128i*)out, translate64(reshuffle64(_mm_loadu_si128((const __m128i*)(in + i)))));
+				}
+				return i;
+			}
+
+			size_t decode64(const unsigned char* in, size_t length, unsigned char* out)
+			{
+				// 16 bytes are stored for 12 decoded
+				const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+				const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+				const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+				const __m128i mask_2f = _mm_set1_epi8(0x2F);
+				size_t i = 0;
+				for (; length - i >= 16; i += 16, out += 12) {
+					__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+					const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+					const __m128i lo_nibbles = _mm_and_si128(v, mask_2f);
+					if (!_mm_testz_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles))) {
+						break;
+					}
+					const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask_2f), hi_nibbles));
+					v = _mm_add_epi8(v, roll);
+					v = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+					_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+				}
+				return i;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,220 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include "crypt_file.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+crypt::MappedFile::MappedFile() : view(NULL), length(0), mapped(false)
+#ifdef _WIN32
+	, hFile(INVALID_HANDLE_VALUE), hMapping(NULL)
+#endif
+{
+}
+
+crypt::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool crypt::MappedFile::open(const std::string& path, unsigned hints, bool fallback)
+{
+	close();
+#ifdef _WIN32
+	DWORD flags = (hints & sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+	hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (GetFileType(hFile) == FILE_TYPE_DISK && GetFileSizeEx(hFile, &file_size) && file_size.QuadPart > 0
+		&& (unsigned long long)file_size.QuadPart <= (std::numeric_limits<size_t>::max)()) {
+		hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping) {
+			view = (const byte*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (view) {
+				length = (size_t)file_size.QuadPart;
+				mapped = true;
+				return true;
+			}
+			CloseHandle(hMapping);
+			hMapping = NULL;
+		}
+	}
+	CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+		&& (unsigned long long)st.st_size <= (std::numeric_limits<size_t>::max)()) {
+		void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			if (hints & sequential) {
+				madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+			}
+#ifdef MADV_HUGEPAGE
+			// only a hint: file backed huge pages depend on the kernel and the filesystem
+			if (hints & hugepages) {
+				madvise(p, (size_t)st.st_size, MADV_HUGEPAGE);
+			}
+#endif
+			view = (const byte*)p;
+			length = (size_t)st.st_size;
+			mapped = true;
+		}
+	}
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (mapped) {
+		return true;
+	}
+#endif
+	return fallback && readAll(path);
+}
+
+void crypt::MappedFile::close()
+{
+	if (mapped) {
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		hMapping = NULL;
+		hFile = INVALID_HANDLE_VALUE;
+#else
+		munmap(const_cast<byte*>(view), length);
+#endif
+	}
+	buffer.clear();
+	view = NULL;
+	length = 0;
+	mapped = false;
+}
+
+bool crypt::MappedFile::readAll(const std::string& path)
+{
+	std::ifstream f(path, std::ios::in | std::ios::binary);
+	if (!f.is_open()) {
+		return false;
+	}
+	char temp[65536];
+	while (f.read(temp, sizeof(temp)) || f.gcount() > 0) {
+		buffer.append(reinterpret_cast<const byte*>(temp), (size_t)f.gcount());
+	}
+	if (f.bad()) {
+		buffer.clear();
+		return false;
+	}
+	view = buffer.data();
+	length = buffer.size();
+	return true;
+}
+
+bool crypt::listFiles(const std::string& dir, std::vector<std::string>& files)
+{
+	std::vector<std::string> names;
+	std::vector<std::string> dirs;
+	std::string prefix(dir);
+	if (prefix.size() && prefix.back() != '/' && prefix.back() != '\\') {
+		prefix.push_back('/');
+	}
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE hFind = FindFirstFileA((prefix + "*").c_str(), &entry);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	do {
+		std::string name(entry.cFileName);
+		if (name == "." || name == ".." || (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+			continue;
+		}
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			dirs.push_back(name);
+		} else {
+			names.push_back(name);
+		}
+	} while (FindNextFileA(hFind, &entry));
+	FindClose(hFind);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (!d) {
+		return false;
+	}
+	while (struct dirent* entry = readdir(d)) {
+		std::string name(entry->d_name);
+		struct stat st;
+		if (name == "." || name == ".." || lstat((prefix + name).c_str(), &st) != 0) {
+			continue;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			dirs.push_back(name);
+		} else if (S_ISREG(st.st_mode)) {
+			names.push_back(name);
+		}
+	}
+	closedir(d);
+#endif
+	std::sort(names.begin(), names.end());
+	std::sort(dirs.begin(), dirs.end());
+	for (const std::string& name : names) {
+		files.push_back(prefix + name);
+	}
+	// unreadable subdirectories are skipped
+	for (const std::string& name : dirs) {
+		listFiles(prefix + name, files);
+	}
+	return true;
+}
+
+bool crypt::fileStatus(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+		return false;
+	}
+	size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	// filetime: 100ns since 1601
+	uint64_t t = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	mtime = ((int64_t)t - 116444736000000000LL) * 100;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+	size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+	mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
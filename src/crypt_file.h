@@ -0,0 +1,63 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef CRYPT_FILE_H_DEF
+#define CRYPT_FILE_H_DEF
+
+#include <vector>
+#include <cstdint>
+#include "crypt.h"
+
+namespace crypt
+{
+	/* -- read-only view of a whole file: regular files are memory mapped, pipes and special files (or a failed mapping)
+		  are read into a buffer unless fallback is false -- */
+	class MappedFile
+	{
+	public:
+		enum Hints : unsigned { sequential = 1, hugepages = 2 };
+
+						MappedFile();
+						~MappedFile();
+		bool			open(const std::string& path, unsigned hints = sequential, bool fallback = true);
+		void			close();
+		const byte*		data() const { return view; };
+		size_t			size() const { return length; };
+		bool			isMapped() const { return mapped; };
+
+	private:
+						MappedFile(const MappedFile&) = delete;
+		MappedFile&		operator=(const MappedFile&) = delete;
+		bool			readAll(const std::string& path);
+
+		const byte*				view;
+		size_t					length;
+		bool					mapped;
+		std::basic_string<byte>	buffer;
+#ifdef _WIN32
+		void*					hFile;
+		void*					hMapping;
+#endif
+	};
+
+	/* -- appends the regular files below dir (all subdirectories, symbolic links are not followed) sorted by name per directory.
+		  paths are dir joined with '/', returns false if dir cannot be read -- */
+	bool listFiles(const std::string& dir, std::vector<std::string>& files);
+
+	/* -- size and time of the last modification of a regular file (nanoseconds since 1970, windows: in steps of 100) -- */
+	bool fileStatus(const std::string& path, uint64_t& size, int64_t& mtime);
+};
+
+#endif
@@ -216,9 +216,9 @@ namespace Strings {
 	static const char*	encoding_info[] = { "notepad++ is not built for binary data", "standard hex-encoding", "DUDE base32 encoding", "RFC-4648 compatible base64 encoding" };
 	static const char*	encoding_info_url[] = { "ASCII", "Hexadecimal", "Base32", "Base64" };
 
-	static const char*	key_algo[] = { "pbkdf2", "bcrypt", "scrypt" };
-	static const char*	key_algo_info[] = { "HMAC is used as pseudo-random function", "compulsory 16 byte salt, SHA-3 shake128 will be used to get required key-length from fixed 23 byte output", "N - CPU/memory cost, r - blocksize, p - parallelization" };
-	static const char*	key_algo_info_url[] = { "PBKDF2", "Bcrypt", "Scrypt" };
+	static const char*	key_algo[] = { "pbkdf2", "bcrypt", "scrypt", "hkdf", "none" };
+	static const char*	key_algo_info[] = { "HMAC is used as pseudo-random function", "compulsory 16 byte salt, SHA-3 shake128 will be used to get required key-length from fixed 23 byte output", "N - CPU/memory cost, r - blocksize, p - parallelization", "expands a high-entropy key (not a password) with HMAC and the salt", "the key is used as it is, it has to be as long as the cipher key" };
+	static const char*	key_algo_info_url[] = { "PBKDF2", "Bcrypt", "Scrypt", "HKDF", "Key_(cryptography)" };
 
 	static const char*	random_restriction[] = { "digits", "letters", "alphanum", "password" , "specials" };
 
@@ -485,6 +485,29 @@ void crypt::help::validateCryptOptions(Options::Crypt options, bool exceptions)
 		}
 		break;
 	}
+	case crypt::KeyDerivation::hkdf:
+	{
+		if (options.key.options[0] < 0 || options.key.options[0] >= (int)crypt::Hash::COUNT || !checkProperty((crypt::Hash)options.key.options[0], HMAC_SUPPORT)
+			|| !crypt::help::checkHashDigest((Hash)options.key.options[0], (unsigned int)options.key.options[1])) {
+			options.key.options[0] = (int)Constants::hkdf_default_hash;
+			options.key.options[1] = Constants::hkdf_default_hash_digest;
+			if (exceptions) {
+				throw CExc(CExc::Code::invalid_hkdf);
+			}
+		}
+		break;
+	}
+	case crypt::KeyDerivation::none:
+	{
+		// the key is used as it is: an iv derived from it (or a zero iv) would be the same for every encryption with it
+		if (options.iv == IV::keyderivation || options.iv == IV::zero) {
+			options.iv = IV::random;
+			if (exceptions) {
+				throw CExc(CExc::Code::invalid_raw_key_iv);
+			}
+		}
+		break;
+	}
 	}
 	// ---------- salt
 	if (options.key.salt_bytes > Constants::salt_max) {
@@ -0,0 +1,273 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include "crypt_manifest.h"
+#include "cryptopp/misc.h"
+#include "cryptopp/sha.h"
+#include "cryptopp/blake2.h"
+#include "cryptopp/algparam.h"
+#include "cryptopp/hkdf.h"
+
+/* file:	magic, records
+   record:	u32 length of the rest, u64 size, i64 mtime, content hash, params hash, master salt, key check, u32 length + input path, u32 length + output path
+			(little endian) */
+namespace
+{
+	const char		magic[8] = { 'N', 'P', 'P', 'C', 'M', 'A', 'N', '2' };
+	const size_t	record_head = 8 + 8 + crypt::Manifest::hash_size + crypt::Manifest::params_size + crypt::Manifest::salt_size + crypt::Manifest::check_size;
+	const size_t	record_fixed = record_head + 4 + 4;
+	const size_t	compact_min = 1024;		// records: smaller files are never compacted
+
+	uint32_t getU32(const crypt::byte* p)
+	{
+		return CryptoPP::GetWord<uint32_t>(false, CryptoPP::LITTLE_ENDIAN_ORDER, p);
+	}
+
+	uint64_t getU64(const crypt::byte* p)
+	{
+		return CryptoPP::GetWord<uint64_t>(false, CryptoPP::LITTLE_ENDIAN_ORDER, p);
+	}
+
+	void putU32(std::string& out, uint32_t value)
+	{
+		crypt::byte temp[4];
+		CryptoPP::PutWord(false, CryptoPP::LITTLE_ENDIAN_ORDER, temp, value);
+		out.append((const char*)temp, 4);
+	}
+
+	void putU64(std::string& out, uint64_t value)
+	{
+		crypt::byte temp[8];
+		CryptoPP::PutWord(false, CryptoPP::LITTLE_ENDIAN_ORDER, temp, value);
+		out.append((const char*)temp, 8);
+	}
+
+	/* fnv-1a */
+	uint64_t pathHash(const char* s, size_t length)
+	{
+		uint64_t h = 14695981039346656037ULL;
+		for (size_t i = 0; i < length; i++) {
+			h ^= (unsigned char)s[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+}
+
+bool crypt::Manifest::load(const std::string& path)
+{
+	this->path = path;
+	file.close();
+	slots.assign(1024, Slot());
+	records = 0;
+	live = 0;
+	end = 0;
+	updates.clear();
+
+	// missing or empty: nothing known yet
+	if (!file.open(path, MappedFile::sequential) || !file.size()) {
+		file.close();
+		return true;
+	}
+	if (file.size() < sizeof(magic) || std::memcmp(file.data(), magic, sizeof(magic)) != 0) {
+		file.close();
+		return false;
+	}
+	const byte* data = file.data();
+	const char* input;
+	size_t input_length;
+	// a record cut off by an interrupted run ends the file, save() rewrites it without.
+	// the records are counted first: the table is allocated once and never rehashed
+	end = sizeof(magic);
+	while (parseRecord(end, input, input_length)) {
+		end += 4 + getU32(data + end);
+		records++;
+	}
+	size_t count = slots.size();
+	while (count < records * 2) {
+		count *= 2;
+	}
+	slots.assign(count, Slot());
+	for (size_t offset = sizeof(magic); offset < end; offset += 4 + getU32(data + offset)) {
+		parseRecord(offset, input, input_length);
+		uint64_t h = pathHash(input, input_length);
+		size_t i = lookup(input, input_length, h);
+		if (!slots[i].offset) {
+			slots[i].hash = h;
+			live++;
+		}
+		slots[i].offset = offset + 1;
+	}
+	return true;
+}
+
+bool crypt::Manifest::find(const std::string& input, Entry& entry) const
+{
+	if (!file.size()) {
+		return false;
+	}
+	size_t i = lookup(input.c_str(), input.size(), pathHash(input.c_str(), input.size()));
+	if (!slots[i].offset) {
+		return false;
+	}
+	const byte* p = file.data() + slots[i].offset - 1 + 4;
+	entry.size = getU64(p);
+	entry.mtime = (int64_t)getU64(p + 8);
+	std::memcpy(entry.hash, p + 16, hash_size);
+	std::memcpy(entry.params, p + 16 + hash_size, params_size);
+	std::memcpy(entry.salt, p + 16 + hash_size + params_size, salt_size);
+	std::memcpy(entry.check, p + 16 + hash_size + params_size + salt_size, check_size);
+	p += record_head;
+	p += 4 + getU32(p);
+	entry.output.assign((const char*)p + 4, getU32(p));
+	return true;
+}
+
+void crypt::Manifest::update(const std::string& input, const Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	updates.push_back(std::make_pair(input, entry));
+}
+
+bool crypt::Manifest::save()
+{
+	std::string out;
+	std::vector<bool> replaced(slots.size(), false);
+	size_t stale = records - live;
+	for (auto& u : updates) {
+		if (file.size()) {
+			size_t i = lookup(u.first.c_str(), u.first.size(), pathHash(u.first.c_str(), u.first.size()));
+			if (slots[i].offset) {
+				replaced[i] = true;
+				stale++;
+			}
+		}
+	}
+	size_t total = records + updates.size();
+	bool compact = (end < file.size()) || (total >= compact_min && stale * 2 > total);
+	if (!updates.size() && !compact) {
+		return true;
+	}
+	if (compact || !file.size()) {
+		out.append(magic, sizeof(magic));
+	}
+	if (compact) {
+		// the live records that stay, in the order of the file
+		std::vector<uint64_t> offsets;
+		for (size_t i = 0; i < slots.size(); i++) {
+			if (slots[i].offset && !replaced[i]) {
+				offsets.push_back(slots[i].offset - 1);
+			}
+		}
+		std::sort(offsets.begin(), offsets.end());
+		for (uint64_t offset : offsets) {
+			out.append((const char*)file.data() + offset, 4 + getU32(file.data() + offset));
+		}
+	}
+	for (auto& u : updates) {
+		writeRecord(out, u.first, u.second);
+	}
+	file.close();
+	updates.clear();
+
+	if (compact) {
+		// a new file replaces the old one: an interrupted write leaves the old one intact
+		std::string temp = path + ".tmp";
+		std::ofstream f(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!f.write(out.data(), out.size()) || !f.flush()) {
+			f.close();
+			std::remove(temp.c_str());
+			return false;
+		}
+		f.close();
+#ifdef _WIN32
+		std::remove(path.c_str());
+#endif
+		return (std::rename(temp.c_str(), path.c_str()) == 0);
+	}
+	std::ofstream f(path, std::ios::out | std::ios::binary | std::ios::app);
+	return (f.write(out.data(), out.size()) && f.flush());
+}
+
+void crypt::Manifest::contentHash(const byte* data, size_t length, byte* hash)
+{
+	CryptoPP::BLAKE2b(false, (unsigned int)hash_size).CalculateDigest(hash, data, length);
+}
+
+void crypt::Manifest::paramsHash(const std::string& params, byte* hash)
+{
+	CryptoPP::BLAKE2b(false, (unsigned int)params_size).CalculateDigest(hash, (const byte*)params.data(), params.size());
+}
+
+void crypt::Manifest::keyCheck(const MasterKey& master, byte* check)
+{
+	static const byte info[] = { 'n', 'p', 'p', 'c', 'r', 'y', 'p', 't', '-', 'm', 'a', 'n', 'i', 'f', 'e', 's', 't' };
+	CryptoPP::HKDF<CryptoPP::SHA256> hkdf;
+	hkdf.DeriveKey(check, check_size, master.key.data(), master.key.size(), master.salt.BytePtr(), master.salt.size(), info, sizeof(info));
+}
+
+bool crypt::Manifest::parseRecord(size_t offset, const char*& input, size_t& input_length) const
+{
+	const byte* data = file.data();
+	if (offset + 4 > file.size()) {
+		return false;
+	}
+	size_t length = getU32(data + offset);
+	if (length < record_fixed || offset + 4 + length > file.size()) {
+		return false;
+	}
+	const byte* p = data + offset + 4 + record_head;
+	input_length = getU32(p);
+	if (input_length > length - record_fixed || getU32(p + 4 + input_length) != length - record_fixed - input_length) {
+		return false;
+	}
+	input = (const char*)p + 4;
+	return true;
+}
+
+void crypt::Manifest::writeRecord(std::string& out, const std::string& input, const Entry& entry)
+{
+	putU32(out, (uint32_t)(record_fixed + input.size() + entry.output.size()));
+	putU64(out, entry.size);
+	putU64(out, (uint64_t)entry.mtime);
+	out.append((const char*)entry.hash, hash_size);
+	out.append((const char*)entry.params, params_size);
+	out.append((const char*)entry.salt, salt_size);
+	out.append((const char*)entry.check, check_size);
+	putU32(out, (uint32_t)input.size());
+	out.append(input);
+	putU32(out, (uint32_t)entry.output.size());
+	out.append(entry.output);
+}
+
+size_t crypt::Manifest::lookup(const char* input, size_t length, uint64_t h) const
+{
+	size_t mask = slots.size() - 1;
+	for (size_t i = (size_t)h & mask; ; i = (i + 1) & mask) {
+		if (!slots[i].offset) {
+			return i;
+		}
+		if (slots[i].hash == h) {
+			const byte* p = file.data() + slots[i].offset - 1 + 4 + record_head;
+			if (getU32(p) == length && std::memcmp(p + 4, input, length) == 0) {
+				return i;
+			}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef CRYPT_MANIFEST_H_DEF
+#define CRYPT_MANIFEST_H_DEF
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "crypt.h"
+#include "crypt_file.h"
+
+namespace crypt
+{
+	/* -- inputs of incremental encryption (nppcrypt enc --manifest): an append-only file of binary records, the last record of a path counts.
+		  the file stays memory mapped, loading only builds an index of the record offsets. stale records are dropped by save()
+		  once they make up more than half of the file. the content hashes are unkeyed: the file belongs next to the input.
+		  every record holds the salt of the master key the output was encrypted with and a check value of that key -- */
+	class Manifest
+	{
+	public:
+		static const size_t hash_size = 16;			// blake2b-128 of the content
+		static const size_t params_size = 8;		// blake2b-64 of the options the output was encrypted with
+		static const size_t salt_size = Constants::master_salt_size;
+		static const size_t check_size = 8;			// hkdf-sha256 of the master key
+
+		struct Entry
+		{
+			Entry() : size(0), mtime(0) {};
+			uint64_t	size;
+			int64_t		mtime;
+			byte		hash[hash_size];
+			byte		params[params_size];
+			byte		salt[salt_size];
+			byte		check[check_size];
+			std::string	output;
+		};
+
+				Manifest() : records(0), live(0), end(0) {};
+		/* false: the file exists but is no manifest. a missing file is an empty manifest */
+		bool	load(const std::string& path);
+		/* the last record of input, thread safe as long as save() is not called */
+		bool	find(const std::string& input, Entry& entry) const;
+		/* thread safe, written by save() */
+		void	update(const std::string& input, const Entry& entry);
+		/* appends the updates (or rewrites the file without stale records), find() knows nothing afterwards */
+		bool	save();
+
+		static void	contentHash(const byte* data, size_t length, byte* hash);
+		static void	paramsHash(const std::string& params, byte* hash);
+		/* tells a master key from one derived from another password, without revealing anything about it */
+		static void	keyCheck(const MasterKey& master, byte* check);
+
+	private:
+		struct Slot
+		{
+			Slot() : offset(0), hash(0) {};
+			uint64_t	offset;		// offset + 1 of the last record of the path, 0: empty
+			uint64_t	hash;		// of the path
+		};
+
+					Manifest(const Manifest&) = delete;
+		Manifest&	operator=(const Manifest&) = delete;
+		/* input path of the record at offset, false if the record is cut off */
+		bool		parseRecord(size_t offset, const char*& input, size_t& input_length) const;
+		static void	writeRecord(std::string& out, const std::string& input, const Entry& entry);
+		/* slot of input or the empty slot it belongs into */
+		size_t		lookup(const char* input, size_t length, uint64_t h) const;
+
+		std::string									path;
+		MappedFile									file;
+		std::vector<Slot>							slots;		// open addressing, one cache line holds four slots
+		size_t										records;	// records in the file
+		size_t										live;		// paths in the file
+		size_t										end;		// end of the last complete record
+		std::vector<std::pair<std::string, Entry>>	updates;
+		std::mutex									mutex;
+	};
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include "crypt_pool.h"
+
+namespace
+{
+	/* tasks of one worker: the owner pops from the front, thieves from the back */
+	struct Queue
+	{
+		std::mutex			mutex;
+		std::deque<size_t>	tasks;
+
+		bool pop(size_t& task)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (tasks.empty()) {
+				return false;
+			}
+			task = tasks.front();
+			tasks.pop_front();
+			return true;
+		}
+
+		bool steal(size_t& task)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (tasks.empty()) {
+				return false;
+			}
+			task = tasks.back();
+			tasks.pop_back();
+			return true;
+		}
+	};
+}
+
+crypt::WorkPool::WorkPool(size_t threads) : threads(threads)
+{
+	if (!this->threads) {
+		this->threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+}
+
+void crypt::WorkPool::run(size_t tasks, const std::function<void(size_t task, size_t worker)>& work)
+{
+	size_t count = std::min(threads, std::max(tasks, (size_t)1));
+	std::vector<std::unique_ptr<Queue>> queues;
+	for (size_t i = 0; i < count; i++) {
+		queues.emplace_back(new Queue());
+	}
+	for (size_t i = 0; i < tasks; i++) {
+		queues[i % count]->tasks.push_back(i);
+	}
+
+	std::exception_ptr	error;
+	std::mutex			error_mutex;
+
+	// no new tasks appear: once every queue is empty the worker is done
+	auto worker = [&](size_t w) {
+		size_t task;
+		for (;;) {
+			bool found = queues[w]->pop(task);
+			for (size_t i = 1; !found && i < count; i++) {
+				found = queues[(w + i) % count]->steal(task);
+			}
+			if (!found) {
+				return;
+			}
+			try {
+				work(task, w);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> helpers;
+	for (size_t i = 1; i < count; i++) {
+		helpers.push_back(std::thread(worker, i));
+	}
+	worker(0);
+	for (auto& t : helpers) {
+		t.join();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
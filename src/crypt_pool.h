@@ -0,0 +1,41 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef CRYPT_POOL_H_DEF
+#define CRYPT_POOL_H_DEF
+
+#include <cstddef>
+#include <functional>
+
+namespace crypt
+{
+	/* -- runs numbered tasks on a fixed number of threads. the tasks are dealt to the workers in turns (so they finish roughly in order),
+		  every worker takes its own tasks from the front of its queue and steals from the back of the others once it runs out -- */
+	class WorkPool
+	{
+	public:
+		/* threads 0: number of cores */
+				WorkPool(size_t threads = 0);
+		size_t	size() const { return threads; };
+		/* work(task, worker) is called once for every task 0 ... tasks - 1 with worker 0 ... size() - 1, worker 0 is the calling thread.
+		   returns when all tasks are done, the first exception thrown by work() is rethrown then */
+		void	run(size_t tasks, const std::function<void(size_t task, size_t worker)>& work);
+
+	private:
+		size_t	threads;
+	};
+};
+
+#endif
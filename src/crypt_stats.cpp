@@ -0,0 +1,111 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "crypt_stats.h"
+
+#ifndef NPPCRYPT_NO_STATS
+
+#include <atomic>
+
+namespace
+{
+	typedef std::atomic<unsigned long long> Counter;
+
+	std::atomic<bool>	stats_enabled(false);
+	Counter				stats_nanoseconds[(size_t)crypt::Stats::Phase::COUNT];
+	Counter				stats_bytes[(size_t)crypt::Stats::Phase::COUNT];
+	Counter				stats_calls[(size_t)crypt::Stats::Phase::COUNT];
+
+	/* innermost running timer of the thread */
+	thread_local crypt::Stats::Timer* stats_current = NULL;
+
+	void addTime(crypt::Stats::Phase phase, std::chrono::steady_clock::duration d)
+	{
+		stats_nanoseconds[(size_t)phase].fetch_add((unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), std::memory_order_relaxed);
+	}
+}
+
+void crypt::Stats::enable(bool on)
+{
+	stats_enabled.store(on, std::memory_order_relaxed);
+}
+
+bool crypt::Stats::enabled()
+{
+	return stats_enabled.load(std::memory_order_relaxed);
+}
+
+void crypt::Stats::reset()
+{
+	for (size_t i = 0; i < (size_t)Phase::COUNT; i++) {
+		stats_nanoseconds[i] = 0;
+		stats_bytes[i] = 0;
+		stats_calls[i] = 0;
+	}
+}
+
+crypt::Stats::Entry crypt::Stats::get(Phase phase)
+{
+	Entry entry;
+	if (phase < Phase::COUNT) {
+		entry.seconds = stats_nanoseconds[(size_t)phase].load(std::memory_order_relaxed) / 1e9;
+		entry.bytes = stats_bytes[(size_t)phase].load(std::memory_order_relaxed);
+		entry.calls = stats_calls[(size_t)phase].load(std::memory_order_relaxed);
+	}
+	return entry;
+}
+
+const char* crypt::Stats::getString(Phase phase)
+{
+	static const char* phases[] = { "read", "keyderivation", "cipher", "encoding", "header", "hmac", "write" };
+	return (phase < Phase::COUNT) ? phases[(size_t)phase] : "";
+}
+
+crypt::Stats::Timer::Timer(Phase p, size_t bytes) : phase(p), active(enabled()), parent(NULL)
+{
+	if (!active) {
+		return;
+	}
+	stats_bytes[(size_t)phase].fetch_add(bytes, std::memory_order_relaxed);
+	stats_calls[(size_t)phase].fetch_add(1, std::memory_order_relaxed);
+	start = std::chrono::steady_clock::now();
+	parent = stats_current;
+	if (parent) {
+		addTime(parent->phase, start - parent->start);
+	}
+	stats_current = this;
+}
+
+crypt::Stats::Timer::~Timer()
+{
+	if (!active) {
+		return;
+	}
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	addTime(phase, now - start);
+	stats_current = parent;
+	if (parent) {
+		parent->start = now;
+	}
+}
+
+void crypt::Stats::Timer::addBytes(size_t bytes)
+{
+	if (active) {
+		stats_bytes[(size_t)phase].fetch_add(bytes, std::memory_order_relaxed);
+	}
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+This file is part of nppcrypt
+(http://www.github.com/jeanpaulrichter/nppcrypt)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef CRYPT_STATS_H_DEF
+#define CRYPT_STATS_H_DEF
+
+#include <cstddef>
+#ifndef NPPCRYPT_NO_STATS
+#include <chrono>
+#endif
+
+namespace crypt
+{
+	/* -- time and bytes per phase of an operation (nppcrypt --stats). nothing is recorded before enable(true),
+		  with NPPCRYPT_NO_STATS defined every function is an empty inline stub -- */
+	namespace Stats
+	{
+		enum class Phase : unsigned {
+			read, keyderivation, cipher, encoding, header, hmac, write, COUNT
+		};
+
+		struct Entry
+		{
+			Entry() : seconds(0), bytes(0), calls(0) {};
+			double				seconds;		// time of the phase without the phases nested in it
+			unsigned long long	bytes;
+			unsigned long long	calls;
+		};
+
+#ifndef NPPCRYPT_NO_STATS
+		inline bool	available() { return true; };
+		void		enable(bool on);
+		bool		enabled();
+		void		reset();
+		Entry		get(Phase phase);
+		const char*	getString(Phase phase);
+
+		/* -- measures its own lifetime: a timer started inside another one of the same thread pauses the outer one -- */
+		class Timer
+		{
+		public:
+					Timer(Phase phase, size_t bytes = 0);
+					~Timer();
+			void	addBytes(size_t bytes);
+
+		private:
+					Timer(const Timer&) = delete;
+			Timer&	operator=(const Timer&) = delete;
+
+			Phase									phase;
+			bool									active;
+			Timer*									parent;
+			std::chrono::steady_clock::time_point	start;
+		};
+#else
+		inline bool	available() { return false; };
+		inline void	enable(bool) {};
+		inline bool	enabled() { return false; };
+		inline void	reset() {};
+		inline Entry get(Phase) { return Entry(); };
+		inline const char* getString(Phase) { return ""; };
+
+		class Timer
+		{
+		public:
+					Timer(Phase, size_t = 0) {};
+			void	addBytes(size_t) {};
+		};
+#endif
+	};
+};
+
+#endif
@@ -19,6 +19,7 @@ GNU General Public License for more details.
 #include "exception.h"
 //#include "preferences.h"
 #include "crypt_help.h"
+#include "crypt_stats.h"
 
 inline bool cmpchars(const char* s1, const char* s2, int len)
 {
@@ -29,8 +30,24 @@ inline bool cmpchars(const char* s1, const char* s2, int len)
 	return true;
 }
 
-bool CryptHeaderReader::parse(const byte* in, size_t in_len)
+void CryptHeader::hmacUpdate(const crypt::Options::Hash& h, const byte* data, size_t length)
 {
+	crypt::Stats::Timer timer(crypt::Stats::Phase::hmac, length);
+	if (!hasher) {
+		// the header body comes first, as in create() and checkHMAC()
+		hasher.reset(new crypt::Hasher(h));
+		hasher->update(pBody, bodyLength);
+	}
+	if (length) {
+		hasher->update(data, length);
+	}
+}
+
+// ====================================================================================================================================================================
+
+bool CryptHeaderReader::parse(const byte* in, size_t in_len, bool complete)
+{
+	crypt::Stats::Timer timer(crypt::Stats::Phase::header);
 	if (in == NULL || in_len == 0) {
 		return false;
 	}
@@ -78,21 +95,35 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 	if (xml_err != tinyxml2::XMLError::XML_NO_ERROR) {
 		throw CExc(CExc::Code::invalid_header_version);
 	}
-	if (version != NPPC_VERSION) {
+	if (version != NPPC_VERSION && version != NPPC_SEGMENTED_VERSION && version != NPPC_TRAILER_VERSION && version != NPPC_KEY_VERSION) {
 		throw CExc(CExc::Code::bad_version);
 	}
+	trailerLen = 0;
+	// NPPC_KEY_VERSION: trailer and segment-size are optional
+	if (version == NPPC_TRAILER_VERSION || (version == NPPC_KEY_VERSION && xml_nppcrypt->Attribute("trailer"))) {
+		const char* pTrailer = xml_nppcrypt->Attribute("trailer");
+		if (!pTrailer || (trailerLen = (size_t)std::strtoul(pTrailer, NULL, 10)) == 0 || trailerLen > 1024) {
+			throw CExc(CExc::Code::invalid_header);
+		}
+	}
 	const char* pHMAC = xml_nppcrypt->Attribute("hmac");
-	if (pHMAC) {
-		size_t hmac_length = strlen(pHMAC);
-		if (hmac_length > 512) {
-			throw CExc(CExc::Code::invalid_hmac_data);
+	// streamed data: only the length of the hmac is known upfront, the digest follows in the trailer
+	const char* pHMAC_length = trailerLen ? xml_nppcrypt->Attribute("hmac-length") : NULL;
+	if (pHMAC || pHMAC_length) {
+		if (pHMAC) {
+			size_t hmac_length = strlen(pHMAC);
+			if (hmac_length > 512) {
+				throw CExc(CExc::Code::invalid_hmac_data);
+			}
+			hmac_digest.set(pHMAC, hmac_length, crypt::Encoding::base64);
+			hmac.hash.digest_length = hmac_digest.size();
+		} else {
+			hmac.hash.digest_length = (size_t)std::strtoul(pHMAC_length, NULL, 10);
 		}
-		hmac_digest.set(pHMAC, hmac_length, crypt::Encoding::base64);
 		const char* pHMAC_hash = xml_nppcrypt->Attribute("hmac-hash");
 		if (!crypt::help::getHash(pHMAC_hash, hmac.hash.algorithm) || !crypt::help::checkProperty(hmac.hash.algorithm, crypt::HMAC_SUPPORT)) {
 			throw CExc(CExc::Code::invalid_hmac_hash);
 		}
-		hmac.hash.digest_length = hmac_digest.size();
 		if (!crypt::help::checkHashDigest(hmac.hash.algorithm, hmac.hash.digest_length)) {
 			throw CExc(CExc::Code::invalid_hmac_data);
 		}
@@ -167,6 +198,15 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 			}
 			s_init.tag.set(t, 24, crypt::Encoding::base64);
 		}
+		if (version == NPPC_SEGMENTED_VERSION || ((version == NPPC_TRAILER_VERSION || version == NPPC_KEY_VERSION) && xml_crypt->Attribute("segment-size"))) {
+			if (!(t = xml_crypt->Attribute("segment-size"))) {
+				throw CExc(CExc::Code::invalid_segment_size);
+			}
+			t_options.segment_size = (size_t)std::strtoul(t, NULL, 10);
+			if (t_options.segment_size < crypt::Constants::segment_size_min || t_options.segment_size > crypt::Constants::segment_size_max) {
+				throw CExc(CExc::Code::invalid_segment_size);
+			}
+		}
 	}
 	tinyxml2::XMLElement* xml_key = xml_nppcrypt->FirstChildElement("key");
 	if (xml_key) {
@@ -244,6 +284,35 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 			}
 			break;
 		}
+		case crypt::KeyDerivation::hkdf:
+		{
+			t = xml_key->Attribute("hash");
+			crypt::Hash thash;
+			if (!crypt::help::getHash(t, thash) || !crypt::help::checkProperty(thash, crypt::HMAC_SUPPORT)) {
+				throw CExc(CExc::Code::invalid_hkdf);
+			}
+			t_options.key.options[0] = static_cast<int>(thash);
+			if (!(t = xml_key->Attribute("digest-length"))) {
+				throw CExc(CExc::Code::invalid_hkdf);
+			}
+			t_options.key.options[1] = std::atoi(t);
+			if (!crypt::help::checkHashDigest(thash, (unsigned int)t_options.key.options[1])) {
+				throw CExc(CExc::Code::invalid_hkdf);
+			}
+			break;
+		}
+		case crypt::KeyDerivation::none:
+			break;
+		}
+		// batch: the key was expanded from a master key with a salt of its own
+		if ((t = xml_key->Attribute("master-salt")) != NULL) {
+			if (strlen(t) > 2 * crypt::Constants::salt_max) {
+				throw CExc(CExc::Code::invalid_salt);
+			}
+			s_init.master_salt.set(t, strlen(t), crypt::Encoding::base64);
+			if (!s_init.master_salt.size() || !s_init.salt.size()) {
+				throw CExc(CExc::Code::invalid_salt);
+			}
 		}
 		t = xml_key->Attribute("generateIV");
 		if (t != NULL && strlen(t) == 4 && strcmp(t, "true") == 0) {
@@ -261,8 +330,17 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 	options.iv = t_options.iv;
 	options.key = t_options.key;
 	options.mode = t_options.mode;
+	options.encoding.enc = t_options.encoding.enc;
+	options.segment_size = t_options.segment_size;
 
-	if (in[offset + 11] == '\r' && in[offset + 12] == '\n') {
+	// the tag follows in the trailer, it is reserved here so that the decryption can be set up before
+	size_t tag_size = trailerLen ? crypt::getTagSize(options) : 0;
+	if (tag_size) {
+		std::basic_string<byte> blank(tag_size, 0);
+		s_init.tag.set(blank.data(), blank.size());
+	}
+
+	if (in[offset + 11] == '\r' && offset + 12 < in_len && in[offset + 12] == '\n') {
 		pEncryptedData = in + offset + 13;
 		encryptedDataLen = in_len - offset - 13;
 	} else if (in[offset + 11] == '\n')	{
@@ -272,8 +350,16 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 		pEncryptedData = in + offset + 11;
 		encryptedDataLen = in_len - offset - 11;
 	}
+	streamed = !complete;
+	if (complete && trailerLen) {
+		if (encryptedDataLen < trailerLen) {
+			throw CExc(CExc::Code::invalid_header);
+		}
+		encryptedDataLen -= trailerLen;
+		parseTrailer(pEncryptedData + encryptedDataLen, trailerLen);
+	}
 	// ------ check EOLs: (only important in case of nppcrypt files that use this options to reencrypt)
-	for (size_t i = 1; i < encryptedDataLen - 1; i++) {
+	for (size_t i = 1; i + 1 < encryptedDataLen; i++) {
 		if (pEncryptedData[i] == '\r' && pEncryptedData[i + 1] == '\n')	{
 			options.encoding.linebreaks = true;
 			options.encoding.linelength = (int)i;
@@ -287,7 +373,7 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 		}
 	}
 	if (options.encoding.enc == crypt::Encoding::base16 || options.encoding.enc == crypt::Encoding::base32)	{
-		for (size_t i = 0; i < encryptedDataLen - 1; i++) {
+		for (size_t i = 0; i + 1 < encryptedDataLen; i++) {
 			if (std::isalpha((int)*pEncryptedData + (int)i)) {
 				options.encoding.uppercase = (std::isupper((int)*pEncryptedData + (int)i) == 0) ? false : true;
 				break;
@@ -299,11 +385,55 @@ bool CryptHeaderReader::parse(const byte* in, size_t in_len)
 	return true;
 }
 
+void CryptHeaderReader::update(const byte* data, size_t length)
+{
+	if (hmac.enable) {
+		hmacUpdate(hmac.hash, data, length);
+	}
+}
+
+void CryptHeaderReader::parseTrailer(const byte* in, size_t in_len)
+{
+	tinyxml2::XMLDocument xml_doc;
+	if (xml_doc.Parse((const char*)in, in_len) != tinyxml2::XMLError::XML_NO_ERROR) {
+		throw CExc(CExc::Code::invalid_header);
+	}
+	tinyxml2::XMLElement* xml_trailer = xml_doc.FirstChildElement("trailer");
+	if (!xml_trailer) {
+		throw CExc(CExc::Code::invalid_header);
+	}
+	if (s_init.tag.size()) {
+		const char* t = xml_trailer->Attribute("tag");
+		if (t == NULL || strlen(t) != 24) {
+			throw CExc(CExc::Code::invalid_tag);
+		}
+		s_init.tag.set(t, 24, crypt::Encoding::base64);
+	}
+	if (hmac.enable) {
+		const char* t = xml_trailer->Attribute("hmac");
+		if (t == NULL || strlen(t) > 512) {
+			throw CExc(CExc::Code::invalid_hmac_data);
+		}
+		hmac_digest.set(t, strlen(t), crypt::Encoding::base64);
+		if (hmac_digest.size() != hmac.hash.digest_length) {
+			throw CExc(CExc::Code::invalid_hmac_data);
+		}
+	}
+}
+
 bool CryptHeaderReader::checkHMAC()
 {
 	if (hmac.enable) {
+		crypt::Stats::Timer timer(crypt::Stats::Phase::hmac, streamed ? 0 : bodyLength + encryptedDataLen);
 		std::basic_string<byte> buf;
-		crypt::hash(hmac.hash, buf, { { pBody, bodyLength },{ pEncryptedData,encryptedDataLen } });
+		if (streamed) {
+			// the data went through update()
+			hmacUpdate(hmac.hash, NULL, 0);
+			hasher->final(buf);
+			hasher.reset();
+		} else {
+			crypt::hash(hmac.hash, buf, { { pBody, bodyLength },{ pEncryptedData,encryptedDataLen } });
+		}
 		if (buf.size() != hmac_digest.size()) {
 			return false;
 		}
@@ -322,17 +452,69 @@ bool CryptHeaderReader::checkHMAC()
 
 // ====================================================================================================================================================================
 
-CryptHeaderWriter::CryptHeaderWriter(const crypt::Options::Crypt& opt, HMAC& hmac_opt, const byte* h_key, size_t h_len) : options(opt), hmac(hmac_opt)
+CryptHeaderWriter::CryptHeaderWriter(const crypt::Options::Crypt& opt, HMAC& hmac_opt, const byte* h_key, size_t h_len) : options(opt), hmac(hmac_opt), hmac_offset(0), trailer_tag_offset(0), trailer_hmac_offset(0)
 {
 }
 
-
 void CryptHeaderWriter::create(const byte* data, size_t data_length)
+{
+	crypt::Stats::Timer	timer(crypt::Stats::Phase::header);
+	build(false);
+
+	if (hmac.enable && hmac_offset > 0) {
+		// create hmac hash and insert it into header
+		crypt::Stats::Timer hmac_timer(crypt::Stats::Phase::hmac, bodyLength + data_length);
+		std::basic_string<byte> buf;
+		crypt::hash(hmac.hash, buf, { { pBody, bodyLength },{ data, data_length } });
+		std::string tstring(buf.begin(), buf.end());
+		buffer.replace(hmac_offset, tstring.size(), tstring);
+	}
+	timer.addBytes(buffer.size());
+}
+
+void CryptHeaderWriter::createStreaming()
+{
+	crypt::Stats::Timer	timer(crypt::Stats::Phase::header);
+	build(true);
+	timer.addBytes(buffer.size());
+}
+
+void CryptHeaderWriter::update(const byte* data, size_t data_length)
+{
+	if (hmac.enable && trailer.size()) {
+		hmacUpdate(hmac.hash, data, data_length);
+	}
+}
+
+void CryptHeaderWriter::finish()
+{
+	if (trailer.empty()) {
+		return;
+	}
+	crypt::Stats::Timer	timer(crypt::Stats::Phase::header, trailer.size());
+	if (trailer_tag_offset) {
+		if (s_init.tag.size() != crypt::getTagSize(options)) {
+			throw CExc(CExc::Code::invalid_tag);
+		}
+		crypt::secure_string temp_s;
+		s_init.tag.get(temp_s, crypt::Encoding::base64);
+		trailer.replace(trailer_tag_offset, temp_s.size(), temp_s.c_str());
+	}
+	if (trailer_hmac_offset) {
+		std::basic_string<byte> buf;
+		hmacUpdate(hmac.hash, NULL, 0);
+		hasher->final(buf);
+		hasher.reset();
+		trailer.replace(trailer_hmac_offset, buf.size(), std::string(buf.begin(), buf.end()));
+	}
+}
+
+void CryptHeaderWriter::build(bool streaming)
 {
 	std::ostringstream	out;
 	size_t				body_start;
 	size_t				body_end;
-	size_t				hmac_offset;
+	size_t				hmac_length = 0;
 	crypt::secure_string temp_s;
 
 	static const char win[] = { '\r', '\n', 0 };
@@ -342,21 +524,58 @@ void CryptHeaderWriter::create(const byte* data, size_t data_length)
 	} else {
 		linebreak = &win[1];
 	}
-	out << std::fixed;
-	out << "<nppcrypt version=\"" << NPPC_VERSION << "\"";
 	if (hmac.enable) {
-		size_t hmac_length = hmac.hash.digest_length;
 		size_t key_length;
+		hmac_length = hmac.hash.digest_length;
 		if (!crypt::getHashInfo(hmac.hash.algorithm, hmac_length, key_length)) {
 			throw CExc(CExc::Code::invalid_hmac_hash);
 		}
+		hmac.hash.encoding = crypt::Encoding::base64;
+	}
+	// streamed data: tag and hmac go into the trailer, with blanks for now
+	size_t tag_size = crypt::getTagSize(options);
+	hmac_offset = trailer_tag_offset = trailer_hmac_offset = 0;
+	trailer.clear();
+	if (streaming && (tag_size || hmac.enable)) {
+		std::ostringstream t;
+		t << "<trailer";
+		if (tag_size) {
+			t << " tag=\"";
+			trailer_tag_offset = static_cast<size_t>(t.tellp());
+			t << std::string(base64length(tag_size), ' ') << "\"";
+		}
+		if (hmac.enable) {
+			t << " hmac=\"";
+			trailer_hmac_offset = static_cast<size_t>(t.tellp());
+			t << std::string(base64length(hmac_length), ' ') << "\"";
+		}
+		t << " />" << linebreak;
+		trailer.assign(t.str());
+	}
+	if (s_init.master_salt.size() || options.key.algorithm == crypt::KeyDerivation::hkdf || options.key.algorithm == crypt::KeyDerivation::none) {
+		version = NPPC_KEY_VERSION;
+	} else if (trailer.size()) {
+		version = NPPC_TRAILER_VERSION;
+	} else {
+		version = options.segment_size ? NPPC_SEGMENTED_VERSION : NPPC_VERSION;
+	}
+	out << std::fixed;
+	out << "<nppcrypt version=\"" << version << "\"";
+	if (hmac.enable) {
 		out << " hmac-hash=\"" << crypt::help::getString(hmac.hash.algorithm) << "\"";
 		if (hmac.keypreset_id >= 0) {
 			out << " auth-key=\"" << hmac.keypreset_id << "\"";
 		}
-		out << " hmac=\"";
-		hmac_offset = static_cast<size_t>(out.tellp());
-		out << std::string(base64length(hmac_length), ' ') << "\"";
+		if (streaming) {
+			out << " hmac-length=\"" << hmac_length << "\"";
+		} else {
+			out << " hmac=\"";
+			hmac_offset = static_cast<size_t>(out.tellp());
+			out << std::string(base64length(hmac_length), ' ') << "\"";
+		}
+	}
+	if (trailer.size()) {
+		out << " trailer=\"" << trailer.size() << "\"";
 	}
 	out << ">" << linebreak;
 	body_start = static_cast<size_t>(out.tellp());
@@ -365,6 +584,9 @@ void CryptHeaderWriter::create(const byte* data, size_t data_length)
 		out << " mode=\"" << crypt::help::getString(options.mode) << "\"";
 	}
 	out << " encoding=\"" << crypt::help::getString(options.encoding.enc) << "\" ";
+	if (options.segment_size) {
+		out << "segment-size=\"" << options.segment_size << "\" ";
+	}
 	if (s_init.tag.size()) {
 		s_init.tag.get(temp_s, crypt::Encoding::base64);
 		out << "tag=\"" << temp_s << "\" ";
@@ -400,6 +622,20 @@ void CryptHeaderWriter::create(const byte* data, size_t data_length)
 		out << "\" N=\"" << static_cast<size_t>(std::pow(2, options.key.options[0])) << "\" r=\"" << options.key.options[1] << "\" p=\"" << options.key.options[2] << "\" ";
 		break;
 	}
+	case crypt::KeyDerivation::hkdf:
+	{
+		out << "\" hash=\"" << crypt::help::getString((crypt::Hash)options.key.options[0]) << "\" digest-length=\"" << options.key.options[1] << "\" ";
+		break;
+	}
+	case crypt::KeyDerivation::none:
+	{
+		out << "\" ";
+		break;
+	}
+	}
+	if (s_init.master_salt.size()) {
+		s_init.master_salt.get(temp_s, crypt::Encoding::base64);
+		out << "master-salt=\"" << temp_s << "\" ";
 	}
 	if (options.iv == crypt::IV::keyderivation) {
 		out << "generateIV=\"true\" />" << linebreak;
@@ -413,15 +649,7 @@ void CryptHeaderWriter::create(const byte* data, size_t data_length)
 	buffer.assign(out.str());
 	pBody = (const byte*)&buffer[body_start];
 	bodyLength = body_end - body_start;
-
-	if (hmac.enable && hmac_offset > 0) {
-		// create hmac hash and insert it into header
-		std::basic_string<byte> buf;
-		hmac.hash.encoding = crypt::Encoding::base64;
-		crypt::hash(hmac.hash, buf, { { pBody, bodyLength },{ data, data_length } });
-		std::string tstring(buf.begin(), buf.end());
-		buffer.replace(hmac_offset, tstring.size(), tstring);
-	}
+	hasher.reset();
 }
 
 size_t CryptHeaderWriter::base64length(size_t bin_length, bool linebreaks, size_t line_length, bool windows)
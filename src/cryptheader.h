@@ -26,30 +26,40 @@ class CryptHeader
 public:
 
 	struct HMAC {
-		HMAC() : enable(false) {};
+		HMAC() : enable(false), keypreset_id(-1) {};
 		bool					enable;
 		int						keypreset_id;
 		crypt::Options::Hash	hash;
 	};
 
-						CryptHeader() : version(NPPC_VERSION) {};
+						CryptHeader() : version(NPPC_VERSION), trailerLen(0) {};
 	int					getVersion() { return version; };
 	crypt::InitData&	initData() { return s_init; };
+	/* bytes that follow the encrypted data (tag and hmac of streamed data), 0: no trailer */
+	size_t				trailerLength() { return trailerLen; };
 
 protected:
-	crypt::InitData		s_init;
-	int					version;
-	const byte*			pBody;
-	size_t				bodyLength;
+	void				hmacUpdate(const crypt::Options::Hash& h, const byte* data, size_t length);
+
+	crypt::InitData					s_init;
+	int								version;
+	const byte*						pBody;
+	size_t							bodyLength;
+	size_t							trailerLen;
+	std::unique_ptr<crypt::Hasher>	hasher;
 };
 
 class CryptHeaderReader : public CryptHeader
 {
 public:
-								CryptHeaderReader(crypt::Options::Crypt& opt, CryptHeader::HMAC& h) : options(opt), hmac(h), pEncryptedData(NULL), encryptedDataLen(0) {};
-	bool						parse(const byte* in, size_t in_len);	
+								CryptHeaderReader(crypt::Options::Crypt& opt, CryptHeader::HMAC& h) : options(opt), hmac(h), pEncryptedData(NULL), encryptedDataLen(0), streamed(false) {};
+	/* complete: in holds all data including the trailer. otherwise (data read in blocks) in only has to reach the end of the header,
+	   the hmac of the data is built by update() and the trailer is handed to parseTrailer() at the end */
+	bool						parse(const byte* in, size_t in_len, bool complete = true);
 	const byte*					encryptedData() { return pEncryptedData; };
 	size_t						encryptedDataLength() { return encryptedDataLen; };
+	void						update(const byte* data, size_t length);
+	void						parseTrailer(const byte* in, size_t in_len);
 	bool						checkHMAC();
 
 private:
@@ -58,6 +68,7 @@ private:
 	crypt::UserData				hmac_digest;
 	const unsigned char* 		pEncryptedData;
 	size_t						encryptedDataLen;
+	bool						streamed;
 };
 
 class CryptHeaderWriter : public CryptHeader
@@ -65,15 +76,27 @@ class CryptHeaderWriter : public CryptHeader
 public:
 							CryptHeaderWriter(const crypt::Options::Crypt& opt, HMAC& hmac_opt, const byte* h_key = NULL, size_t h_len = 0);
 	void					create(const crypt::byte* data, size_t data_length);
+	/* header for data that is written in blocks: tag and hmac are only known at the end, they go into a trailer of fixed length.
+	   every block is passed to update(), finish() fills in the trailer once the data (and the tag) is complete */
+	void					createStreaming();
+	void					update(const crypt::byte* data, size_t data_length);
+	void					finish();
 	const char*				c_str() { return buffer.c_str(); };
 	size_t					size() { return buffer.size(); };
+	const char*				trailer_c_str() { return trailer.c_str(); };
+	size_t					trailerSize() { return trailer.size(); };
 
 private:
+	void					build(bool streaming);
 	size_t					base64length(size_t bin_length, bool linebreaks=false, size_t line_length=0, bool windows=false);
 
 	CryptHeader::HMAC&				hmac;
 	const crypt::Options::Crypt&	options;
 	std::string						buffer;
+	size_t							hmac_offset;
+	std::string						trailer;
+	size_t							trailer_tag_offset;
+	size_t							trailer_hmac_offset;
 };
 
 #endif
\ No newline at end of file
@@ -505,6 +505,10 @@ void DlgCrypt::setupDialog()
 		::SendDlgItemMessage(tab.key, IDC_CRYPT_SCRYPT_R_SPIN, UDM_SETPOS32, 0, crypt->options.key.options[1]);
 		::SendDlgItemMessage(tab.key, IDC_CRYPT_SCRYPT_P_SPIN, UDM_SETPOS32, 0, crypt->options.key.options[2]);
 		break;
+	case crypt::KeyDerivation::hkdf:
+	case crypt::KeyDerivation::none:
+		// command line only: no controls
+		break;
 	}
 	crypt::Hash cur_sel = crypt::help::getHashByIndex(::SendDlgItemMessage(tab.key, IDC_CRYPT_PBKDF2_HASH, CB_GETCURSEL, 0, 0), crypt::HMAC_SUPPORT);
 	updateHashDigestControl(cur_sel, tab.key, IDC_CRYPT_PBKDF2_HASH_LENGTH);
@@ -1235,6 +1239,9 @@ void DlgCrypt::updateKeyDerivationControls()
 		::EnableWindow(::GetDlgItem(tab.key, IDC_CRYPT_SALT_STATIC), c);
 		break;
 	}
+	case crypt::KeyDerivation::hkdf:
+	case crypt::KeyDerivation::none:
+		break;
 	}
 	help.keyalgorithm.setURL(crypt::help::getHelpURL(current.key_derivation));
 	help.keyalgorithm.setTooltip(crypt::help::getInfo(current.key_derivation));
@@ -76,7 +76,21 @@ static const char* error_msgs[] =
 	/* outputfile_write_fail		*/ "Failed to write output-file.",
 	/* only_utf8_decrypt			*/ "utf16/utf32 bom present: nppcrypt creates only utf8 files.",
 	/* password_decode				*/ "Failed to decode password",
-	/* bad_version					*/ "Please use an older version of nppcrypt to decrypt."
+	/* bad_version					*/ "Please use an older version of nppcrypt to decrypt.",
+	/* invalid_segment_size			*/ "Invalid segment size.",
+	/* scrypt_memory_limit			*/ "scrypt parameters exceed the memory limit.",
+	/* invalid_calibration			*/ "Invalid calibration target or memory limit.",
+	/* invalid_benchmark			*/ "Invalid benchmark buffer size or output format.",
+	/* output_buffer_too_small		*/ "Output buffer too small.",
+	/* batch_header_required		*/ "Batch mode needs the header of every file (salt of the file and of the master key).",
+	/* invalid_jobs					*/ "Invalid number of jobs.",
+	/* invalid_manifest				*/ "Invalid manifest file.",
+	/* manifest_write_fail			*/ "Failed to write manifest file.",
+	/* invalid_hkdf					*/ "Invalid options for hkdf.",
+	/* invalid_raw_key				*/ "Key derivation none: the key has to be exactly as long as the cipher key (and iv).",
+	/* keyfile_read_fail			*/ "Failed to read keyfile.",
+	/* invalid_raw_key_iv			*/ "Key derivation none: the iv has to be random or custom.",
+	/* calibration_no_cost			*/ "hkdf and none have no cost parameter to calibrate."
 };
 
 const char* CExc::what() const throw()
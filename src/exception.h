@@ -84,7 +84,21 @@ public:
 		outputfile_write_fail,
 		only_utf8_decrypt,
 		password_decode,
-		bad_version
+		bad_version,
+		invalid_segment_size,
+		scrypt_memory_limit,
+		invalid_calibration,
+		invalid_benchmark,
+		output_buffer_too_small,
+		batch_header_required,
+		invalid_jobs,
+		invalid_manifest,
+		manifest_write_fail,
+		invalid_hkdf,
+		invalid_raw_key,
+		keyfile_read_fail,
+		invalid_raw_key_iv,
+		calibration_no_cost
 	};
 
 	CExc(Code err_code=Code::unexpected);
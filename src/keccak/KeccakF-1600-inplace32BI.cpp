@@ -15,6 +15,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "brg_endian.h"
 #include "KeccakF-1600-interface.h"
 
+#ifndef KeccakF1600_opt64
+
 typedef unsigned char UINT8;
 typedef unsigned int UINT32;
 // WARNING: on 8-bit and 16-bit platforms, this should be replaced by:
@@ -936,3 +938,5 @@ void KeccakF1600_StateXORPermuteExtract(void *state, const unsigned char *inData
         }
     }
 }
+
+#endif
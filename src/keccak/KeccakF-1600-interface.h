@@ -17,6 +17,13 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define KeccakF_width 1600
 #define KeccakF_laneInBytes 8
 
+/* 64-bit targets use the lane-complementing implementation of KeccakF-1600-opt64.cpp,
+ * others the bit-interleaved one of KeccakF-1600-inplace32BI.cpp. Both keep the state in 200 bytes.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64) || defined(__powerpc64__) || (defined(__riscv) && (__riscv_xlen == 64))
+#define KeccakF1600_opt64
+#endif
+
 /** Function called at least once before any use of the other KeccakF1600_* 
   * functions, possibly to initialize global variables.
   */
@@ -0,0 +1,295 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include    <string.h>
+#include "brg_endian.h"
+#include "KeccakF-1600-interface.h"
+
+#ifdef KeccakF1600_opt64
+
+typedef unsigned char UINT8;
+typedef unsigned long long int UINT64;
+
+#define ROL64(a, offset) ((((UINT64)a) << (offset)) ^ (((UINT64)a) >> (64-(offset))))
+
+// Lane complementing: the lanes 1, 2, 8, 12, 17 and 20 are stored complemented,
+// so chi needs only one NOT per plane instead of five.
+#define isComplemented(lanePosition) \
+    (((lanePosition) == 1) || ((lanePosition) == 2) || ((lanePosition) == 8) || \
+     ((lanePosition) == 12) || ((lanePosition) == 17) || ((lanePosition) == 20))
+
+static const UINT64 KeccakF1600RoundConstants[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+    0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+    0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_Initialize( void )
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateInitialize(void *state)
+{
+    UINT64 *stateAsLanes = (UINT64*)state;
+
+    memset(state, 0, 200);
+    stateAsLanes[ 1] = ~(UINT64)0;
+    stateAsLanes[ 2] = ~(UINT64)0;
+    stateAsLanes[ 8] = ~(UINT64)0;
+    stateAsLanes[12] = ~(UINT64)0;
+    stateAsLanes[17] = ~(UINT64)0;
+    stateAsLanes[20] = ~(UINT64)0;
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateXORBytesInLane(void *state, unsigned int lanePosition, const unsigned char *data, unsigned int offset, unsigned int length)
+{
+#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
+    unsigned int i;
+    UINT8 *stateAsBytes = (UINT8*)state + lanePosition*8 + offset;
+    for(i=0; i<length; i++)
+        stateAsBytes[i] ^= data[i];
+#else
+    UINT64 lane = 0;
+    unsigned int i;
+    for(i=0; i<length; i++)
+        lane |= ((UINT64)data[i]) << ((i+offset)*8);
+    ((UINT64*)state)[lanePosition] ^= lane;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateXORLanes(void *state, const unsigned char *data, unsigned int laneCount)
+{
+    UINT64 *stateAsLanes = (UINT64*)state;
+    unsigned int i;
+#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
+    UINT64 lane;
+    for(i=0; i<laneCount; i++) {
+        memcpy(&lane, data + i*8, 8);
+        stateAsLanes[i] ^= lane;
+    }
+#else
+    for(i=0; i<laneCount; i++) {
+        UINT64 lane = 0;
+        int j;
+        for(j=7; j>=0; j--)
+            lane = (lane << 8) | data[i*8+j];
+        stateAsLanes[i] ^= lane;
+    }
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateComplementBit(void *state, unsigned int position)
+{
+    ((UINT64*)state)[position/64] ^= (UINT64)1 << (position%64);
+}
+
+/* ---------------------------------------------------------------- */
+
+#define thetaRhoPiChiIota(i, A, E) \
+    Ca = A##ba^A##ga^A##ka^A##ma^A##sa; \
+    Ce = A##be^A##ge^A##ke^A##me^A##se; \
+    Ci = A##bi^A##gi^A##ki^A##mi^A##si; \
+    Co = A##bo^A##go^A##ko^A##mo^A##so; \
+    Cu = A##bu^A##gu^A##ku^A##mu^A##su; \
+    Da = Cu ^ ROL64(Ce, 1); \
+    De = Ca ^ ROL64(Ci, 1); \
+    Di = Ce ^ ROL64(Co, 1); \
+    Do = Ci ^ ROL64(Cu, 1); \
+    Du = Co ^ ROL64(Ca, 1); \
+    Ba = A##ba^Da; \
+    Be = ROL64((A##ge^De), 44); \
+    Bi = ROL64((A##ki^Di), 43); \
+    Bo = ROL64((A##mo^Do), 21); \
+    Bu = ROL64((A##su^Du), 14); \
+    E##ba =   Ba ^(  Be |  Bi ); \
+    E##ba ^= KeccakF1600RoundConstants[i]; \
+    E##be =   Be ^((~Bi)|  Bo ); \
+    E##bi =   Bi ^(  Bo &  Bu ); \
+    E##bo =   Bo ^(  Bu |  Ba ); \
+    E##bu =   Bu ^(  Ba &  Be ); \
+\
+    Ba = ROL64((A##bo^Do), 28); \
+    Be = ROL64((A##gu^Du), 20); \
+    Bi = ROL64((A##ka^Da), 3); \
+    Bo = ROL64((A##me^De), 45); \
+    Bu = ROL64((A##si^Di), 61); \
+    E##ga =   Ba ^(  Be |  Bi ); \
+    E##ge =   Be ^(  Bi &  Bo ); \
+    E##gi =   Bi ^(  Bo |(~Bu)); \
+    E##go =   Bo ^(  Bu |  Ba ); \
+    E##gu =   Bu ^(  Ba &  Be ); \
+\
+    Ba = ROL64((A##be^De), 1); \
+    Be = ROL64((A##gi^Di), 6); \
+    Bi = ROL64((A##ko^Do), 25); \
+    Bo = ROL64((A##mu^Du), 8); \
+    Bu = ROL64((A##sa^Da), 18); \
+    E##ka =   Ba ^(  Be |  Bi ); \
+    E##ke =   Be ^(  Bi &  Bo ); \
+    E##ki =   Bi ^((~Bo)&  Bu ); \
+    E##ko = (~Bo)^(  Bu |  Ba ); \
+    E##ku =   Bu ^(  Ba &  Be ); \
+\
+    Ba = ROL64((A##bu^Du), 27); \
+    Be = ROL64((A##ga^Da), 36); \
+    Bi = ROL64((A##ke^De), 10); \
+    Bo = ROL64((A##mi^Di), 15); \
+    Bu = ROL64((A##so^Do), 56); \
+    E##ma =   Ba ^(  Be &  Bi ); \
+    E##me =   Be ^(  Bi |  Bo ); \
+    E##mi =   Bi ^((~Bo)|  Bu ); \
+    E##mo = (~Bo)^(  Bu &  Ba ); \
+    E##mu =   Bu ^(  Ba |  Be ); \
+\
+    Ba = ROL64((A##bi^Di), 62); \
+    Be = ROL64((A##go^Do), 55); \
+    Bi = ROL64((A##ku^Du), 39); \
+    Bo = ROL64((A##ma^Da), 41); \
+    Bu = ROL64((A##se^De), 2); \
+    E##sa =   Ba ^((~Be)&  Bi ); \
+    E##se = (~Be)^(  Bi |  Bo ); \
+    E##si =   Bi ^(  Bo &  Bu ); \
+    E##so =   Bo ^(  Bu |  Ba ); \
+    E##su =   Bu ^(  Ba &  Be );
+
+static void KeccakF1600_StatePermuteLanes(UINT64 *stateAsLanes)
+{
+    UINT64 Aba, Abe, Abi, Abo, Abu, Aga, Age, Agi, Ago, Agu, Aka, Ake, Aki, Ako, Aku, Ama, Ame, Ami, Amo, Amu, Asa, Ase, Asi, Aso, Asu;
+    UINT64 Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu, Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu, Esa, Ese, Esi, Eso, Esu;
+    UINT64 Ba, Be, Bi, Bo, Bu;
+    UINT64 Ca, Ce, Ci, Co, Cu;
+    UINT64 Da, De, Di, Do, Du;
+    unsigned int i;
+
+    Aba = stateAsLanes[ 0];
+    Abe = stateAsLanes[ 1];
+    Abi = stateAsLanes[ 2];
+    Abo = stateAsLanes[ 3];
+    Abu = stateAsLanes[ 4];
+    Aga = stateAsLanes[ 5];
+    Age = stateAsLanes[ 6];
+    Agi = stateAsLanes[ 7];
+    Ago = stateAsLanes[ 8];
+    Agu = stateAsLanes[ 9];
+    Aka = stateAsLanes[10];
+    Ake = stateAsLanes[11];
+    Aki = stateAsLanes[12];
+    Ako = stateAsLanes[13];
+    Aku = stateAsLanes[14];
+    Ama = stateAsLanes[15];
+    Ame = stateAsLanes[16];
+    Ami = stateAsLanes[17];
+    Amo = stateAsLanes[18];
+    Amu = stateAsLanes[19];
+    Asa = stateAsLanes[20];
+    Ase = stateAsLanes[21];
+    Asi = stateAsLanes[22];
+    Aso = stateAsLanes[23];
+    Asu = stateAsLanes[24];
+
+    for(i=0; i<24; i+=2) {
+        thetaRhoPiChiIota(i, A, E)
+        thetaRhoPiChiIota(i+1, E, A)
+    }
+
+    stateAsLanes[ 0] = Aba;
+    stateAsLanes[ 1] = Abe;
+    stateAsLanes[ 2] = Abi;
+    stateAsLanes[ 3] = Abo;
+    stateAsLanes[ 4] = Abu;
+    stateAsLanes[ 5] = Aga;
+    stateAsLanes[ 6] = Age;
+    stateAsLanes[ 7] = Agi;
+    stateAsLanes[ 8] = Ago;
+    stateAsLanes[ 9] = Agu;
+    stateAsLanes[10] = Aka;
+    stateAsLanes[11] = Ake;
+    stateAsLanes[12] = Aki;
+    stateAsLanes[13] = Ako;
+    stateAsLanes[14] = Aku;
+    stateAsLanes[15] = Ama;
+    stateAsLanes[16] = Ame;
+    stateAsLanes[17] = Ami;
+    stateAsLanes[18] = Amo;
+    stateAsLanes[19] = Amu;
+    stateAsLanes[20] = Asa;
+    stateAsLanes[21] = Ase;
+    stateAsLanes[22] = Asi;
+    stateAsLanes[23] = Aso;
+    stateAsLanes[24] = Asu;
+}
+
+void KeccakF1600_StatePermute(void *state)
+{
+    KeccakF1600_StatePermuteLanes((UINT64*)state);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateExtractBytesInLane(const void *state, unsigned int lanePosition, unsigned char *data, unsigned int offset, unsigned int length)
+{
+    UINT64 lane = ((const UINT64*)state)[lanePosition];
+    unsigned int i;
+
+    if (isComplemented(lanePosition))
+        lane = ~lane;
+    for(i=0; i<length; i++)
+        data[i] = (UINT8)(lane >> ((i+offset)*8));
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateExtractLanes(const void *state, unsigned char *data, unsigned int laneCount)
+{
+    const UINT64 *stateAsLanes = (const UINT64*)state;
+    unsigned int i;
+
+    for(i=0; i<laneCount; i++) {
+        UINT64 lane = stateAsLanes[i];
+        if (isComplemented(i))
+            lane = ~lane;
+#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
+        memcpy(data + i*8, &lane, 8);
+#else
+        {
+            int j;
+            for(j=0; j<8; j++)
+                data[i*8+j] = (UINT8)(lane >> (j*8));
+        }
+#endif
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600_StateXORPermuteExtract(void *state, const unsigned char *inData, unsigned int inLaneCount, unsigned char *outData, unsigned int outLaneCount)
+{
+    KeccakF1600_StateXORLanes(state, inData, inLaneCount);
+    KeccakF1600_StatePermuteLanes((UINT64*)state);
+    KeccakF1600_StateExtractLanes(state, outData, outLaneCount);
+}
+
+#endif
@@ -0,0 +1,183 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "KeccakF-1600-times4-interface.h"
+
+#include "../scrypt/config.h"
+
+#ifdef CPUSUPPORT_X86_AVX2
+#include <immintrin.h>
+
+typedef unsigned long long int UINT64;
+typedef __m256i V256;
+
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define CONST64(a) _mm256_set1_epi64x((long long)(a))
+#define LOAD(p) _mm256_loadu_si256((const V256 *)(p))
+#define STORE(p, a) _mm256_storeu_si256((V256 *)(p), a)
+// rotations by 8 and 56 bits are byte shuffles
+#define ROL64in256(a, o) _mm256_or_si256(_mm256_slli_epi64(a, o), _mm256_srli_epi64(a, 64-(o)))
+#define ROL64in256_8(a) _mm256_shuffle_epi8(a, rho8)
+#define ROL64in256_56(a) _mm256_shuffle_epi8(a, rho56)
+#define ROL64(a, o) (((o) == 8) ? ROL64in256_8(a) : (((o) == 56) ? ROL64in256_56(a) : ROL64in256(a, o)))
+
+static const UINT64 KeccakF1600RoundConstants[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+    0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+    0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+#define thetaRhoPiChiIota(i, A, E) \
+    Ca = XOR(A##ba, XOR(A##ga, XOR(A##ka, XOR(A##ma, A##sa)))); \
+    Ce = XOR(A##be, XOR(A##ge, XOR(A##ke, XOR(A##me, A##se)))); \
+    Ci = XOR(A##bi, XOR(A##gi, XOR(A##ki, XOR(A##mi, A##si)))); \
+    Co = XOR(A##bo, XOR(A##go, XOR(A##ko, XOR(A##mo, A##so)))); \
+    Cu = XOR(A##bu, XOR(A##gu, XOR(A##ku, XOR(A##mu, A##su)))); \
+    Da = XOR(Cu, ROL64(Ce, 1)); \
+    De = XOR(Ca, ROL64(Ci, 1)); \
+    Di = XOR(Ce, ROL64(Co, 1)); \
+    Do = XOR(Ci, ROL64(Cu, 1)); \
+    Du = XOR(Co, ROL64(Ca, 1)); \
+    Ba = XOR(A##ba, Da); \
+    Be = ROL64(XOR(A##ge, De), 44); \
+    Bi = ROL64(XOR(A##ki, Di), 43); \
+    Bo = ROL64(XOR(A##mo, Do), 21); \
+    Bu = ROL64(XOR(A##su, Du), 14); \
+    E##ba = XOR(Ba, ANDNOT(Be, Bi)); \
+    E##ba = XOR(E##ba, CONST64(KeccakF1600RoundConstants[i])); \
+    E##be = XOR(Be, ANDNOT(Bi, Bo)); \
+    E##bi = XOR(Bi, ANDNOT(Bo, Bu)); \
+    E##bo = XOR(Bo, ANDNOT(Bu, Ba)); \
+    E##bu = XOR(Bu, ANDNOT(Ba, Be)); \
+\
+    Ba = ROL64(XOR(A##bo, Do), 28); \
+    Be = ROL64(XOR(A##gu, Du), 20); \
+    Bi = ROL64(XOR(A##ka, Da), 3); \
+    Bo = ROL64(XOR(A##me, De), 45); \
+    Bu = ROL64(XOR(A##si, Di), 61); \
+    E##ga = XOR(Ba, ANDNOT(Be, Bi)); \
+    E##ge = XOR(Be, ANDNOT(Bi, Bo)); \
+    E##gi = XOR(Bi, ANDNOT(Bo, Bu)); \
+    E##go = XOR(Bo, ANDNOT(Bu, Ba)); \
+    E##gu = XOR(Bu, ANDNOT(Ba, Be)); \
+\
+    Ba = ROL64(XOR(A##be, De), 1); \
+    Be = ROL64(XOR(A##gi, Di), 6); \
+    Bi = ROL64(XOR(A##ko, Do), 25); \
+    Bo = ROL64(XOR(A##mu, Du), 8); \
+    Bu = ROL64(XOR(A##sa, Da), 18); \
+    E##ka = XOR(Ba, ANDNOT(Be, Bi)); \
+    E##ke = XOR(Be, ANDNOT(Bi, Bo)); \
+    E##ki = XOR(Bi, ANDNOT(Bo, Bu)); \
+    E##ko = XOR(Bo, ANDNOT(Bu, Ba)); \
+    E##ku = XOR(Bu, ANDNOT(Ba, Be)); \
+\
+    Ba = ROL64(XOR(A##bu, Du), 27); \
+    Be = ROL64(XOR(A##ga, Da), 36); \
+    Bi = ROL64(XOR(A##ke, De), 10); \
+    Bo = ROL64(XOR(A##mi, Di), 15); \
+    Bu = ROL64(XOR(A##so, Do), 56); \
+    E##ma = XOR(Ba, ANDNOT(Be, Bi)); \
+    E##me = XOR(Be, ANDNOT(Bi, Bo)); \
+    E##mi = XOR(Bi, ANDNOT(Bo, Bu)); \
+    E##mo = XOR(Bo, ANDNOT(Bu, Ba)); \
+    E##mu = XOR(Bu, ANDNOT(Ba, Be)); \
+\
+    Ba = ROL64(XOR(A##bi, Di), 62); \
+    Be = ROL64(XOR(A##go, Do), 55); \
+    Bi = ROL64(XOR(A##ku, Du), 39); \
+    Bo = ROL64(XOR(A##ma, Da), 41); \
+    Bu = ROL64(XOR(A##se, De), 2); \
+    E##sa = XOR(Ba, ANDNOT(Be, Bi)); \
+    E##se = XOR(Be, ANDNOT(Bi, Bo)); \
+    E##si = XOR(Bi, ANDNOT(Bo, Bu)); \
+    E##so = XOR(Bo, ANDNOT(Bu, Ba)); \
+    E##su = XOR(Bu, ANDNOT(Ba, Be));
+
+void KeccakF1600times4_PermuteAll_AVX2(void *states)
+{
+    UINT64 *stateAsLanes = (UINT64*)states;
+    const V256 rho8 = _mm256_setr_epi8(7, 0, 1, 2, 3, 4, 5, 6, 15, 8, 9, 10, 11, 12, 13, 14,
+        7, 0, 1, 2, 3, 4, 5, 6, 15, 8, 9, 10, 11, 12, 13, 14);
+    const V256 rho56 = _mm256_setr_epi8(1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8,
+        1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8);
+    V256 Aba, Abe, Abi, Abo, Abu, Aga, Age, Agi, Ago, Agu, Aka, Ake, Aki, Ako, Aku, Ama, Ame, Ami, Amo, Amu, Asa, Ase, Asi, Aso, Asu;
+    V256 Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu, Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu, Esa, Ese, Esi, Eso, Esu;
+    V256 Ba, Be, Bi, Bo, Bu;
+    V256 Ca, Ce, Ci, Co, Cu;
+    V256 Da, De, Di, Do, Du;
+    unsigned int i;
+
+    Aba = LOAD(stateAsLanes + 0);
+    Abe = LOAD(stateAsLanes + 4);
+    Abi = LOAD(stateAsLanes + 8);
+    Abo = LOAD(stateAsLanes + 12);
+    Abu = LOAD(stateAsLanes + 16);
+    Aga = LOAD(stateAsLanes + 20);
+    Age = LOAD(stateAsLanes + 24);
+    Agi = LOAD(stateAsLanes + 28);
+    Ago = LOAD(stateAsLanes + 32);
+    Agu = LOAD(stateAsLanes + 36);
+    Aka = LOAD(stateAsLanes + 40);
+    Ake = LOAD(stateAsLanes + 44);
+    Aki = LOAD(stateAsLanes + 48);
+    Ako = LOAD(stateAsLanes + 52);
+    Aku = LOAD(stateAsLanes + 56);
+    Ama = LOAD(stateAsLanes + 60);
+    Ame = LOAD(stateAsLanes + 64);
+    Ami = LOAD(stateAsLanes + 68);
+    Amo = LOAD(stateAsLanes + 72);
+    Amu = LOAD(stateAsLanes + 76);
+    Asa = LOAD(stateAsLanes + 80);
+    Ase = LOAD(stateAsLanes + 84);
+    Asi = LOAD(stateAsLanes + 88);
+    Aso = LOAD(stateAsLanes + 92);
+    Asu = LOAD(stateAsLanes + 96);
+
+    for(i=0; i<24; i+=2) {
+        thetaRhoPiChiIota(i, A, E)
+        thetaRhoPiChiIota(i+1, E, A)
+    }
+
+    STORE(stateAsLanes + 0, Aba);
+    STORE(stateAsLanes + 4, Abe);
+    STORE(stateAsLanes + 8, Abi);
+    STORE(stateAsLanes + 12, Abo);
+    STORE(stateAsLanes + 16, Abu);
+    STORE(stateAsLanes + 20, Aga);
+    STORE(stateAsLanes + 24, Age);
+    STORE(stateAsLanes + 28, Agi);
+    STORE(stateAsLanes + 32, Ago);
+    STORE(stateAsLanes + 36, Agu);
+    STORE(stateAsLanes + 40, Aka);
+    STORE(stateAsLanes + 44, Ake);
+    STORE(stateAsLanes + 48, Aki);
+    STORE(stateAsLanes + 52, Ako);
+    STORE(stateAsLanes + 56, Aku);
+    STORE(stateAsLanes + 60, Ama);
+    STORE(stateAsLanes + 64, Ame);
+    STORE(stateAsLanes + 68, Ami);
+    STORE(stateAsLanes + 72, Amo);
+    STORE(stateAsLanes + 76, Amu);
+    STORE(stateAsLanes + 80, Asa);
+    STORE(stateAsLanes + 84, Ase);
+    STORE(stateAsLanes + 88, Asi);
+    STORE(stateAsLanes + 92, Aso);
+    STORE(stateAsLanes + 96, Asu);
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KeccakF1600times4Interface_h_
+#define _KeccakF1600times4Interface_h_
+
+#define KeccakF1600times4_statesSizeInBytes 800
+#define KeccakF1600times4_statesAlignment 32
+
+/* Four independent Keccak-f[1600] states processed in parallel.
+ * The states are interleaved by lanes: lane i of instance j is the 64-bit word at index 4*i + j
+ * (native byte order), so one AVX2 register holds the same lane of all four instances.
+ * KeccakF1600times4_PermuteAll() uses AVX2 if the CPU supports it, four sequential
+ * KeccakF1600_StatePermute() otherwise.
+ */
+
+/** Function to initialize the four states to the logical value 0^1600.
+  * @param  states  Pointer to the states (KeccakF1600times4_statesSizeInBytes bytes).
+  */
+void KeccakF1600times4_InitializeAll(void *states);
+
+/** Function to XOR data given as bytes into the state of one instance.
+  * The bits to modify are restricted to start from the bit position 0 and
+  * to span a whole number of lanes (i.e., multiple of 8 bytes).
+  * @param  states  Pointer to the states.
+  * @param  instanceIndex   Index of the instance, 0 to 3.
+  * @param  data    Pointer to the input data.
+  * @param  laneCount   The number of lanes, i.e., the length of the data
+  *                     divided by 64 bits.
+  * @pre    0 ≤ @a laneCount ≤ 25
+  */
+void KeccakF1600times4_XORLanes(void *states, unsigned int instanceIndex, const unsigned char *data, unsigned int laneCount);
+
+/** Function to XOR data given as bytes into one lane of one instance.
+  * @param  states  Pointer to the states.
+  * @param  instanceIndex   Index of the instance, 0 to 3.
+  * @param  lanePosition    Index of the lane to be modified.
+  * @param  data    Pointer to the input data.
+  * @param  offset  Offset in bytes within the lane.
+  * @param  length  Number of bytes.
+  * @pre    0 ≤ @a offset + @a length ≤ 8
+  */
+void KeccakF1600times4_XORBytesInLane(void *states, unsigned int instanceIndex, unsigned int lanePosition, const unsigned char *data, unsigned int offset, unsigned int length);
+
+/** Function to apply Keccak-f[1600] on all four states.
+  * @param  states  Pointer to the states.
+  */
+void KeccakF1600times4_PermuteAll(void *states);
+
+/** Function to retrieve the first bytes of the state of one instance.
+  * @param  states  Pointer to the states.
+  * @param  instanceIndex   Index of the instance, 0 to 3.
+  * @param  data    Pointer to the area where to store output data.
+  * @param  length  Number of bytes, at most 200.
+  */
+void KeccakF1600times4_ExtractBytes(const void *states, unsigned int instanceIndex, unsigned char *data, unsigned int length);
+
+/** AVX2 implementation of KeccakF1600times4_PermuteAll(), only to be called if the CPU supports AVX2.
+  */
+void KeccakF1600times4_PermuteAll_AVX2(void *states);
+
+#endif
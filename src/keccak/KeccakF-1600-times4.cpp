@@ -0,0 +1,115 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include    <string.h>
+#include "brg_endian.h"
+#include "KeccakF-1600-interface.h"
+#include "KeccakF-1600-times4-interface.h"
+
+#include "../scrypt/config.h"
+
+#ifdef CPUSUPPORT_X86_AVX2
+// runtime detection of scrypt/cpusupport_x86_avx2.c
+extern "C" int cpusupport_x86_avx2_detect_1(void);
+#endif
+
+typedef unsigned char UINT8;
+typedef unsigned long long int UINT64;
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600times4_InitializeAll(void *states)
+{
+    memset(states, 0, KeccakF1600times4_statesSizeInBytes);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600times4_XORLanes(void *states, unsigned int instanceIndex, const unsigned char *data, unsigned int laneCount)
+{
+    UINT64 *statesAsLanes = (UINT64*)states;
+    unsigned int i;
+    int j;
+
+    for(i=0; i<laneCount; i++) {
+        UINT64 lane = 0;
+        for(j=7; j>=0; j--)
+            lane = (lane << 8) | data[i*8+j];
+        statesAsLanes[i*4 + instanceIndex] ^= lane;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600times4_XORBytesInLane(void *states, unsigned int instanceIndex, unsigned int lanePosition, const unsigned char *data, unsigned int offset, unsigned int length)
+{
+    UINT64 lane = 0;
+    unsigned int i;
+
+    for(i=0; i<length; i++)
+        lane |= ((UINT64)data[i]) << ((i+offset)*8);
+    ((UINT64*)states)[lanePosition*4 + instanceIndex] ^= lane;
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakF1600times4_ExtractBytes(const void *states, unsigned int instanceIndex, unsigned char *data, unsigned int length)
+{
+    const UINT64 *statesAsLanes = (const UINT64*)states;
+    unsigned int i;
+
+    for(i=0; i<length; i++)
+        data[i] = (UINT8)(statesAsLanes[(i/8)*4 + instanceIndex] >> ((i%8)*8));
+}
+
+/* ---------------------------------------------------------------- */
+
+// one instance after the other with the single state implementation, its state layout is opaque:
+// the lanes are XORed into a fresh state and extracted again.
+static void KeccakF1600times4_PermuteAll_serial(void *states)
+{
+    UINT64 *statesAsLanes = (UINT64*)states;
+    UINT64 state[25];
+    UINT8 lanes[200];
+    unsigned int i, j;
+
+    for(j=0; j<4; j++) {
+        for(i=0; i<200; i++)
+            lanes[i] = (UINT8)(statesAsLanes[(i/8)*4 + j] >> ((i%8)*8));
+        KeccakF1600_StateInitialize(state);
+        KeccakF1600_StateXORLanes(state, lanes, 25);
+        KeccakF1600_StatePermute(state);
+        KeccakF1600_StateExtractLanes(state, lanes, 25);
+        for(i=0; i<25; i++) {
+            UINT64 lane = 0;
+            int k;
+            for(k=7; k>=0; k--)
+                lane = (lane << 8) | lanes[i*8+k];
+            statesAsLanes[i*4 + j] = lane;
+        }
+    }
+    memset(state, 0, sizeof(state));
+    memset(lanes, 0, sizeof(lanes));
+}
+
+void KeccakF1600times4_PermuteAll(void *states)
+{
+#ifdef CPUSUPPORT_X86_AVX2
+    static const bool avx2 = (cpusupport_x86_avx2_detect_1() != 0);
+    if (avx2) {
+        KeccakF1600times4_PermuteAll_AVX2(states);
+        return;
+    }
+#endif
+    KeccakF1600times4_PermuteAll_serial(states);
+}
@@ -0,0 +1,68 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <string.h>
+#include "KeccakSpongetimes4.h"
+#include "KeccakF-1600-times4-interface.h"
+
+int KeccakWidth1600times4_Sponge(unsigned int rate, unsigned int capacity, const unsigned char *const inputs[4], size_t inputByteLen, unsigned char suffix, unsigned char *const outputs[4], size_t outputByteLen)
+{
+    unsigned long long int states[KeccakF1600times4_statesSizeInBytes/8];
+    unsigned char block[200];
+    const unsigned char padding = 0x80;
+    unsigned int rateInBytes = rate/8;
+    unsigned int rateInLanes = rate/64;
+    unsigned int instance;
+    size_t offset, partial, length;
+
+    if ((rate + capacity) != 1600 || rate == 0 || (rate % 64) != 0 || suffix == 0)
+        return 1;
+
+    KeccakF1600times4_InitializeAll(states);
+
+    // absorb the full blocks
+    for(offset=0; inputByteLen - offset >= rateInBytes; offset += rateInBytes) {
+        for(instance=0; instance<4; instance++)
+            KeccakF1600times4_XORLanes(states, instance, inputs[instance] + offset, rateInLanes);
+        KeccakF1600times4_PermuteAll(states);
+    }
+
+    // last block with the suffix, then the last bit of the padding
+    partial = inputByteLen - offset;
+    for(instance=0; instance<4; instance++) {
+        memset(block, 0, rateInBytes);
+        memcpy(block, inputs[instance] + offset, partial);
+        block[partial] ^= suffix;
+        KeccakF1600times4_XORLanes(states, instance, block, rateInLanes);
+    }
+    if (((suffix & 0x80) != 0) && (partial == (rateInBytes-1)))
+        KeccakF1600times4_PermuteAll(states);
+    for(instance=0; instance<4; instance++)
+        KeccakF1600times4_XORBytesInLane(states, instance, rateInLanes-1, &padding, 7, 1);
+    KeccakF1600times4_PermuteAll(states);
+
+    // squeeze
+    for(offset=0; offset < outputByteLen; offset += length) {
+        if (offset > 0)
+            KeccakF1600times4_PermuteAll(states);
+        length = outputByteLen - offset;
+        if (length > rateInBytes)
+            length = rateInBytes;
+        for(instance=0; instance<4; instance++)
+            KeccakF1600times4_ExtractBytes(states, instance, outputs[instance] + offset, (unsigned int)length);
+    }
+
+    memset(states, 0, sizeof(states));
+    memset(block, 0, sizeof(block));
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KeccakSpongetimes4_h_
+#define _KeccakSpongetimes4_h_
+
+#include <stddef.h>
+
+/**
+  * Function to evaluate the sponge function Keccak[r, c] on four inputs of the same length at once.
+  * @param  rate        The value of the rate r, a multiple of 64 bits.
+  * @param  capacity    The value of the capacity c.
+  * @param  inputs      Pointers to the four inputs.
+  * @param  inputByteLen    The length of each input in bytes.
+  * @param  suffix      Bits that will be automatically appended to the end
+  *                     of the input message, as in KeccakWidth1600_SpongeAbsorbLastFewBits().
+  * @param  outputs     Pointers to the four output buffers.
+  * @param  outputByteLen   The number of output bytes desired for each instance.
+  * @pre    One must have r+c=1600, r a multiple of 64 and the rate a multiple of 8 bits in this implementation.
+  * @return Zero if successful, 1 otherwise.
+  */
+int KeccakWidth1600times4_Sponge(unsigned int rate, unsigned int capacity, const unsigned char *const inputs[4], size_t inputByteLen, unsigned char suffix, unsigned char *const outputs[4], size_t outputByteLen);
+
+#endif
@@ -20,6 +20,9 @@ GNU General Public License for more details.
 
 #define		NPPC_NAME					"NppCrypt"
 #define		NPPC_VERSION				1016
+#define		NPPC_SEGMENTED_VERSION		1017
+#define		NPPC_TRAILER_VERSION		1018
+#define		NPPC_KEY_VERSION			1019		// master-salt, key derivation hkdf or none: older versions cannot derive the key
 
 #define		NPPC_FUNC_COUNT				9
 #define		NPPC_FUNC_HASH_ID			2
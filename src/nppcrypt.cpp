@@ -359,6 +359,12 @@ void EncryptDlg()
 
 void DecryptDlg()
 {
+	// parse() copies the segment-size of the header into the options: it applies to this decryption only
+	struct SegmentReset
+	{
+		~SegmentReset() { current.crypt.options.segment_size = 0; };
+	} segment_reset;
+
 	try
 	{
 		const byte*	pData;
@@ -406,6 +412,10 @@ void DecryptDlg()
 			if (current.crypt.options.mode == crypt::Mode::eax && s_init.tag.size() != crypt::Constants::eax_tag_size) {
 				need_tag_len = crypt::Constants::gcm_tag_size;
 			}
+			// segmented data carries a tag per segment, not a single one
+			if (current.crypt.options.segment_size) {
+				need_tag_len = 0;
+			}
 			if (need_salt_len > 0 || need_tag_len > 0) {
 				if (!dlg_initdata.doDialog(&s_init, need_salt_len, need_tag_len)) {
 					return;
@@ -175,6 +175,9 @@ void CPreferences::load(const std::wstring& path, CurrentOptions& current)
 					}
 					break;
 				}
+				case crypt::KeyDerivation::hkdf:
+				case crypt::KeyDerivation::none:
+					break;
 				}
 			}
 		}
@@ -302,6 +305,9 @@ void CPreferences::save(CurrentOptions& current)
 			fout << "\" N=\"" << static_cast<size_t>(std::pow(2, current.crypt.options.key.options[0])) << "\" r=\"" << current.crypt.options.key.options[1] << "\" p=\"" << current.crypt.options.key.options[2];
 			break;
 		}
+		case crypt::KeyDerivation::hkdf:
+		case crypt::KeyDerivation::none:
+			break;
 		}
 		fout << "\" />" << eol;
 		fout << "<crypt_hmac enabled=\"" << bool_str[current.crypt.hmac.enable] << "\" hash=\"" << crypt::help::getString(current.crypt.hmac.hash.algorithm) << "\" keypreset_id=\"" << current.crypt.hmac.keypreset_id << "\" />" << eol;
@@ -390,6 +396,16 @@ void CPreferences::validate(CurrentOptions& current)
 		}
 		break;
 	}
+	case crypt::KeyDerivation::hkdf:
+	case crypt::KeyDerivation::none:
+	{
+		// command line only: the dialog has no controls for them
+		current.crypt.options.key.algorithm = crypt::KeyDerivation::scrypt;
+		current.crypt.options.key.options[0] = crypt::Constants::scrypt_N_default;
+		current.crypt.options.key.options[1] = crypt::Constants::scrypt_r_default;
+		current.crypt.options.key.options[2] = crypt::Constants::scrypt_p_default;
+		break;
+	}
 	}
 	if (int(current.crypt.hmac.hash.algorithm) < 0 || int(current.crypt.hmac.hash.algorithm) >= int(crypt::Hash::COUNT) 
 		|| !crypt::help::checkProperty(current.crypt.hmac.hash.algorithm, crypt::HMAC_SUPPORT)) {
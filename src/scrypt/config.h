@@ -3,6 +3,10 @@
 #define CPUSUPPORT_X86_CPUID 1
 #define CPUSUPPORT_X86_SSE2 1
 #define CPUSUPPORT_X86_AESNI 1
+#define CPUSUPPORT_X86_AVX2 1
+#define CPUSUPPORT_X86_AVX512F 1
+#define CPUSUPPORT_X86_SHANI 1
+#define CPUSUPPORT_X86_SSE41 1
 
 #define HAVE_INTTYPES_H 1
 #define HAVE_MEMORY_H 1
@@ -20,6 +24,7 @@
 #define HAVE_POSIX_MEMALIGN 1
 #define HAVE_CLOCK_GETTIME 1
 #define HAVE_MMAP 1
+#define HAVE_PTHREAD 1
 #define HAVE_STRINGS_H 1
 #define HAVE_STRUCT_SYSINFO 1
 #define HAVE_STRUCT_SYSINFO_MEM_UNIT 1
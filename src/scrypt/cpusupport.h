@@ -104,6 +104,10 @@
 * compiled and linked in.
 */
 CPUSUPPORT_FEATURE(x86, aesni, X86_AESNI);
+CPUSUPPORT_FEATURE(x86, avx2, X86_AVX2);
+CPUSUPPORT_FEATURE(x86, avx512f, X86_AVX512F);
+CPUSUPPORT_FEATURE(x86, shani, X86_SHANI);
 CPUSUPPORT_FEATURE(x86, sse2, X86_SSE2);
+CPUSUPPORT_FEATURE(x86, sse41, X86_SSE41);
 
 #endif /* !_CPUSUPPORT_H_ */
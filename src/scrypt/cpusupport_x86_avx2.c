@@ -0,0 +1,64 @@
+#include "config.h"
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_CPUID
+#ifdef WIN_CPUID
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#define CPUID_OSXSAVE_BIT (1 << 27)
+#define CPUID_AVX_BIT (1 << 28)
+#define CPUID_AVX2_BIT (1 << 5)
+#define XCR0_YMM (0x2 | 0x4)
+#endif
+
+CPUSUPPORT_FEATURE_DECL(x86, avx2)
+{
+#ifdef CPUSUPPORT_X86_CPUID
+#ifdef WIN_CPUID
+	int registers[4];
+	__cpuid(registers, 0);
+	if (registers[0] < 7)
+		goto unsupported;
+	__cpuid(registers, 1);
+	if ((registers[2] & (CPUID_OSXSAVE_BIT | CPUID_AVX_BIT)) !=
+	    (CPUID_OSXSAVE_BIT | CPUID_AVX_BIT))
+		goto unsupported;
+	if ((_xgetbv(0) & XCR0_YMM) != XCR0_YMM)
+		goto unsupported;
+	__cpuidex(registers, 7, 0);
+	return ((registers[1] & CPUID_AVX2_BIT) ? 1 : 0);
+#else
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0, xcr0_high;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (eax < 7)
+		goto unsupported;
+
+	/* The OS must save the YMM registers on context switches. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if ((ecx & (CPUID_OSXSAVE_BIT | CPUID_AVX_BIT)) !=
+	    (CPUID_OSXSAVE_BIT | CPUID_AVX_BIT))
+		goto unsupported;
+	__asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0_high) : "c" (0));
+	if ((xcr0 & XCR0_YMM) != XCR0_YMM)
+		goto unsupported;
+
+	/* Ask about extended features. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* Return the relevant feature bit. */
+	return ((ebx & CPUID_AVX2_BIT) ? 1 : 0);
+#endif
+
+unsupported:
+#endif
+	return (0);
+}
@@ -0,0 +1,56 @@
+#include "config.h"
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_CPUID
+#ifdef WIN_CPUID
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#define CPUID_SSSE3_BIT (1 << 9)
+#define CPUID_SSE41_BIT (1 << 19)
+#define CPUID_SHANI_BIT (1 << 29)
+#endif
+
+CPUSUPPORT_FEATURE_DECL(x86, shani)
+{
+#ifdef CPUSUPPORT_X86_CPUID
+#ifdef WIN_CPUID
+	int registers[4];
+	__cpuid(registers, 0);
+	if (registers[0] < 7)
+		goto unsupported;
+	__cpuid(registers, 1);
+	if ((registers[2] & (CPUID_SSSE3_BIT | CPUID_SSE41_BIT)) !=
+	    (CPUID_SSSE3_BIT | CPUID_SSE41_BIT))
+		goto unsupported;
+	__cpuidex(registers, 7, 0);
+	return ((registers[1] & CPUID_SHANI_BIT) ? 1 : 0);
+#else
+	unsigned int eax, ebx, ecx, edx;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (eax < 7)
+		goto unsupported;
+
+	/* The SHA-256 code shuffles and blends with SSSE3 and SSE4.1. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if ((ecx & (CPUID_SSSE3_BIT | CPUID_SSE41_BIT)) !=
+	    (CPUID_SSSE3_BIT | CPUID_SSE41_BIT))
+		goto unsupported;
+
+	/* Ask about extended features. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* Return the relevant feature bit. */
+	return ((ebx & CPUID_SHANI_BIT) ? 1 : 0);
+#endif
+
+unsupported:
+#endif
+	return (0);
+}
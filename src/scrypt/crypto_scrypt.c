@@ -32,7 +32,6 @@
 #endif
 
 #include <sys/types.h>
-//#include <sys/mman.h>
 
 #include <errno.h>
 #include <stdint.h>
@@ -40,32 +39,364 @@
 #include <string.h>
 
 #include "cpusupport.h"
+#include "insecure_memzero.h"
 #include "sha256.h"
 #include "warnp.h"
 
 #include "crypto_scrypt_smix.h"
+#include "crypto_scrypt_smix_avx2.h"
+#include "crypto_scrypt_smix_avx512.h"
 #include "crypto_scrypt_smix_sse2.h"
 
 #include "crypto_scrypt.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#else
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#endif
+
 static void (*smix_func)(uint8_t *, size_t, uint64_t, void *, void *) = NULL;
 
+/* Optional smix computing ${smix_width} consecutive lanes at once. */
+static void (*smix_wide_func)(uint8_t *, size_t, uint64_t, void *, void *) = NULL;
+static uint32_t smix_width = 1;
+
+static void selectsmix(void);
+
+/* selectsmix runs only once: the three variables above are read after it. */
+#if defined(_WIN32)
+static INIT_ONCE smix_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+selectsmix_once(PINIT_ONCE once, PVOID param, PVOID * context)
+{
+
+	(void)once;
+	(void)param;
+	(void)context;
+	selectsmix();
+	return (TRUE);
+}
+#elif defined(HAVE_PTHREAD)
+static pthread_once_t smix_once = PTHREAD_ONCE_INIT;
+#endif
+
+/**
+ * initsmix(void):
+ * Pick the smix code for this CPU, if it has not been picked yet.  Safe to
+ * call from several threads at once.
+ */
+static void
+initsmix(void)
+{
+
+#if defined(_WIN32)
+	InitOnceExecuteOnce(&smix_once, selectsmix_once, NULL, NULL);
+#elif defined(HAVE_PTHREAD)
+	pthread_once(&smix_once, selectsmix);
+#else
+	if (smix_func == NULL)
+		selectsmix();
+#endif
+}
+
+/* Maximum number of threads used for the p lanes. */
+#define SMIX_MAX_THREADS 64
+
+/* Size of huge pages requested with MAP_HUGETLB. */
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/* Round ${x} up to a multiple of 64. */
+#define ALIGN64(x) (((x) + 63) & ~ (size_t)(63))
+
+/* The lanes first ... last - 1 of B, ${width} of them at once if possible. */
+struct smix_lanes {
+	void (*smix)(uint8_t *, size_t, uint64_t, void *, void *);
+	void (*wide)(uint8_t *, size_t, uint64_t, void *, void *);
+	uint32_t width;
+	uint8_t * B;
+	size_t r;
+	uint64_t N;
+	uint32_t first;
+	uint32_t last;
+	void * V;
+	void * XY;
+};
+
+static void
+smix_lanes_run(struct smix_lanes * l)
+{
+	uint32_t i = l->first;
+
+	if (l->width > 1) {
+		for (; i + l->width <= l->last; i += l->width)
+			(l->wide)(&l->B[i * 128 * l->r], l->r, l->N, l->V,
+			    l->XY);
+	}
+	for (; i < l->last; i++)
+		(l->smix)(&l->B[i * 128 * l->r], l->r, l->N, l->V, l->XY);
+}
+
+#if defined(_WIN32)
+static unsigned __stdcall
+#else
+static void *
+#endif
+smix_lanes_thread(void * cookie)
+{
+
+	smix_lanes_run((struct smix_lanes *)cookie);
+	return (0);
+}
+
+/**
+ * smix_parallel(lanes, threads):
+ * Compute ${lanes}[0 .. threads - 1] on ${threads} threads.  Lanes of threads
+ * which could not be started are computed by the calling thread.
+ */
+static void
+smix_parallel(struct smix_lanes * lanes, uint32_t threads)
+{
+	int started[SMIX_MAX_THREADS];
+#if defined(_WIN32)
+	HANDLE handles[SMIX_MAX_THREADS];
+#elif defined(HAVE_PTHREAD)
+	pthread_t handles[SMIX_MAX_THREADS];
+#endif
+	uint32_t t;
+
+	for (t = 1; t < threads; t++) {
+		started[t] = 0;
+#if defined(_WIN32)
+		handles[t] = (HANDLE)_beginthreadex(NULL, 0, smix_lanes_thread,
+		    &lanes[t], 0, NULL);
+		started[t] = (handles[t] != 0);
+#elif defined(HAVE_PTHREAD)
+		started[t] = (pthread_create(&handles[t], NULL, smix_lanes_thread,
+		    &lanes[t]) == 0);
+#endif
+	}
+	smix_lanes_run(&lanes[0]);
+	for (t = 1; t < threads; t++) {
+		if (!started[t]) {
+			lanes[t].V = lanes[0].V;
+			lanes[t].XY = lanes[0].XY;
+			smix_lanes_run(&lanes[t]);
+			continue;
+		}
+#if defined(_WIN32)
+		WaitForSingleObject(handles[t], INFINITE);
+		CloseHandle(handles[t]);
+#elif defined(HAVE_PTHREAD)
+		pthread_join(handles[t], NULL);
+#endif
+	}
+}
+
+/**
+ * workspace_release(ws):
+ * Free the memory of ${ws}; the contents are wiped first.
+ */
+static void
+workspace_release(scrypt_workspace * ws)
+{
+
+	if (ws->base == NULL)
+		return;
+	insecure_memzero(ws->mem, ws->size);
+#if defined(_WIN32)
+	if (ws->locked)
+		VirtualUnlock(ws->base, ws->size);
+	VirtualFree(ws->base, 0, MEM_RELEASE);
+#elif defined(HAVE_MMAP)
+	if (ws->locked)
+		munlock(ws->base, ws->size);
+	munmap(ws->base, ws->size);
+#else
+	free(ws->base);
+#endif
+	ws->base = NULL;
+	ws->mem = NULL;
+	ws->size = 0;
+	ws->locked = 0;
+}
+
+/**
+ * workspace_reserve(ws, size):
+ * Make sure ${ws} holds at least ${size} bytes aligned to 64 bytes.
+ */
+static int
+workspace_reserve(scrypt_workspace * ws, size_t size)
+{
+	void * p;
+
+	if (ws->size >= size)
+		return (0);
+	workspace_release(ws);
+#if defined(_WIN32)
+	if ((p = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE,
+	    PAGE_READWRITE)) == NULL) {
+		errno = ENOMEM;
+		return (-1);
+	}
+#elif defined(HAVE_MMAP)
+	p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	/* Explicit huge pages need a reserved pool; fall back otherwise. */
+	if (ws->flags & SCRYPT_WORKSPACE_HUGEPAGES) {
+		size = (size + HUGEPAGE_SIZE - 1) & ~ (size_t)(HUGEPAGE_SIZE - 1);
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_ANON | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+	}
+#endif
+	if (p == MAP_FAILED) {
+		if ((p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+#ifdef MAP_NOCORE
+		    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
+#else
+		    MAP_ANON | MAP_PRIVATE,
+#endif
+		    -1, 0)) == MAP_FAILED)
+			return (-1);
+#ifdef MADV_HUGEPAGE
+		if (ws->flags & SCRYPT_WORKSPACE_HUGEPAGES)
+			madvise(p, size, MADV_HUGEPAGE);
+#endif
+	}
+#else
+	if ((p = malloc(size + 63)) == NULL)
+		return (-1);
+#endif
+	ws->base = p;
+	ws->mem = (uint8_t *)(((uintptr_t)(p) + 63) & ~ (uintptr_t)(63));
+	ws->size = size;
+
+	/* Locking is best effort: RLIMIT_MEMLOCK may be too small. */
+	if (ws->flags & SCRYPT_WORKSPACE_LOCK) {
+#if defined(_WIN32)
+		ws->locked = (VirtualLock(p, size) != 0);
+#elif defined(HAVE_MMAP)
+		ws->locked = (mlock(p, size) == 0);
+#endif
+	}
+	return (0);
+}
+
+/**
+ * scrypt_workspace_init(ws, flags):
+ * Initialize ${ws}; no memory is allocated before it is used.
+ */
+void
+scrypt_workspace_init(scrypt_workspace * ws, int flags)
+{
+
+	ws->base = NULL;
+	ws->mem = NULL;
+	ws->size = 0;
+	ws->flags = flags;
+	ws->locked = 0;
+}
+
+/**
+ * scrypt_workspace_free(ws):
+ * Wipe and free the memory held by ${ws}.
+ */
+void
+scrypt_workspace_free(scrypt_workspace * ws)
+{
+
+	workspace_release(ws);
+}
+
+/**
+ * scrypt_memory(N, r, p, threads, width):
+ * Return the size of the workspace for ${threads} threads computing up to
+ * ${width} lanes at once each, and store the number of lanes a thread really
+ * computes at once in ${width}; or return 0 if the size does not fit.
+ */
+static size_t
+scrypt_memory(uint64_t N, size_t r, size_t p, uint32_t threads,
+    uint32_t * width)
+{
+	size_t lanes, xy, v;
+
+	/* A thread computes its ceil(p / threads) lanes in groups. */
+	lanes = (p + threads - 1) / threads;
+	if (*width > lanes)
+		*width = 1;
+
+	if ((r > SIZE_MAX / 128 / p) ||
+	    (r > (SIZE_MAX / 4 - 64 - 63) / 256 / *width) ||
+	    (N > SIZE_MAX / 128 / r / *width))
+		return (0);
+	xy = ALIGN64(*width * (256 * r + 64));
+	v = (size_t)(*width * 128 * r * N);
+	if ((SIZE_MAX - xy < v) ||
+	    ((SIZE_MAX - ALIGN64(128 * r * p)) / threads < xy + v))
+		return (0);
+	return (ALIGN64(128 * r * p) + threads * (xy + v));
+}
+
+/**
+ * crypto_scrypt_memory(N, r, p, threads, flags):
+ * Return the number of bytes a workspace with the flags ${flags} needs for the
+ * given parameters; or 0 if the parameters are invalid or the size does not
+ * fit into size_t.
+ */
+size_t
+crypto_scrypt_memory(uint64_t N, uint32_t r, uint32_t p, uint32_t threads,
+    int flags)
+{
+	uint32_t width;
+
+	if (r == 0 || p == 0 || N < 2 || ((N & (N - 1)) != 0))
+		return (0);
+	if ((uint64_t)(r) * (uint64_t)(p) >= (1 << 30))
+		return (0);
+	if (threads > p)
+		threads = p;
+	if (threads > SMIX_MAX_THREADS)
+		threads = SMIX_MAX_THREADS;
+	if (threads < 1)
+		threads = 1;
+
+	/* The width depends on the smix code picked for this CPU. */
+	initsmix();
+	width = (flags & SCRYPT_WORKSPACE_NARROW) ? 1 : smix_width;
+
+	return (scrypt_memory(N, r, p, threads, &width));
+}
+
 /**
- * _crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen, smix):
- * Perform the requested scrypt computation, using ${smix} as the smix routine.
+ * _crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen, smix,
+ *     wide, width, threads, ws):
+ * Perform the requested scrypt computation, using ${smix} as the smix routine
+ * and ${wide} for ${width} lanes at once, up to ${threads} threads for the p
+ * lanes and the memory of ${ws}, or memory allocated for this call if ${ws}
+ * is NULL.
  */
 static int
 _crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
     const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
     uint8_t * buf, size_t buflen,
-    void (*smix)(uint8_t *, size_t, uint64_t, void *, void *))
+    void (*smix)(uint8_t *, size_t, uint64_t, void *, void *),
+    void (*wide)(uint8_t *, size_t, uint64_t, void *, void *),
+    uint32_t width, uint32_t threads, scrypt_workspace * ws)
 {
-	void * B0, * V0, * XY0;
+	struct smix_lanes lanes[SMIX_MAX_THREADS];
+	scrypt_workspace temp;
 	uint8_t * B;
-	uint32_t * V;
-	uint32_t * XY;
+	uint8_t * mem;
 	size_t r = _r, p = _p;
-	uint32_t i;
+	size_t size;
+	uint32_t w, t;
 
 	/* Sanity-check parameters. */
 #if SIZE_MAX > UINT32_MAX
@@ -82,113 +413,73 @@ _crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
 		errno = EINVAL;
 		goto err0;
 	}
-	if ((r > SIZE_MAX / 128 / p) ||
-#if SIZE_MAX / 256 <= UINT32_MAX
-	    (r > (SIZE_MAX - 64) / 256) ||
-#endif
-	    (N > SIZE_MAX / 128 / r)) {
+	if (threads > p)
+		threads = (uint32_t)p;
+	if (threads > SMIX_MAX_THREADS)
+		threads = SMIX_MAX_THREADS;
+	if (threads < 1)
+		threads = 1;
+	if (ws == NULL) {
+		scrypt_workspace_init(&temp, 0);
+		ws = &temp;
+	}
+	if ((wide == NULL) || (ws->flags & SCRYPT_WORKSPACE_NARROW))
+		width = 1;
+	w = width;
+	if ((size = scrypt_memory(N, r, p, threads, &w)) == 0) {
 		errno = ENOMEM;
 		goto err0;
 	}
 
-	/* Allocate memory. */
-#ifdef HAVE_POSIX_MEMALIGN
-	if ((errno = posix_memalign(&B0, 64, 128 * r * p)) != 0)
-		goto err0;
-	B = (uint8_t *)(B0);
-	if ((errno = posix_memalign(&XY0, 64, 256 * r + 64)) != 0)
-		goto err1;
-	XY = (uint32_t *)(XY0);
-#if !defined(MAP_ANON) || !defined(HAVE_MMAP)
-	if ((errno = posix_memalign(&V0, 64, (size_t)(128 * r * N))) != 0)
-		goto err2;
-	V = (uint32_t *)(V0);
-#endif
-#else
-#ifdef WIN_ALIGNED_MALLOC
-	if ((B0 = _aligned_malloc(128 * r * p, 64)) == NULL)
-		goto err0;
-	B = (uint8_t *)(B0);
-	if ((XY0 = _aligned_malloc(256 * r + 64, 64)) == NULL)
-		goto err1;
-	XY = (uint32_t *)(XY0);
-#if !defined(MAP_ANON) || !defined(HAVE_MMAP)
-	if ((V0 = _aligned_malloc((size_t)(128 * r * N), 64)) == NULL)
-		goto err2;
-	V = (uint32_t *)(V0);
-#endif
-#else
-	if ((B0 = malloc(128 * r * p + 63)) == NULL)
-		goto err0;
-	B = (uint8_t *)(((uintptr_t)(B0) + 63) & ~ (uintptr_t)(63));
-	if ((XY0 = malloc(256 * r + 64 + 63)) == NULL)
-		goto err1;
-	XY = (uint32_t *)(((uintptr_t)(XY0) + 63) & ~ (uintptr_t)(63));
-#if !defined(MAP_ANON) || !defined(HAVE_MMAP)
-	if ((V0 = malloc(128 * r * N + 63)) == NULL)
-		goto err2;
-	V = (uint32_t *)(((uintptr_t)(V0) + 63) & ~ (uintptr_t)(63));
-#endif
-#endif
-#endif
-#if defined(MAP_ANON) && defined(HAVE_MMAP)
-	if ((V0 = mmap(NULL, 128 * r * N, PROT_READ | PROT_WRITE,
-#ifdef MAP_NOCORE
-	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
-#else
-	    MAP_ANON | MAP_PRIVATE,
-#endif
-	    -1, 0)) == MAP_FAILED)
-		goto err2;
-	V = (uint32_t *)(V0);
-#endif
+	/* Allocate memory, with less lanes at once if there is not enough. */
+	while (workspace_reserve(ws, size)) {
+		if (w > 1)
+			w = 1;
+		else if (threads > 1)
+			threads = 1;
+		else
+			goto err0;
+		size = scrypt_memory(N, r, p, threads, &w);
+	}
+	B = ws->mem;
+	mem = B + ALIGN64(128 * r * p);
+	for (t = 0; t < threads; t++) {
+		lanes[t].smix = smix;
+		lanes[t].wide = wide;
+		lanes[t].width = w;
+		lanes[t].B = B;
+		lanes[t].r = r;
+		lanes[t].N = N;
+		lanes[t].first = (uint32_t)(p * t / threads);
+		lanes[t].last = (uint32_t)(p * (t + 1) / threads);
+		lanes[t].XY = mem;
+		mem += ALIGN64(w * (256 * r + 64));
+		lanes[t].V = mem;
+		mem += (size_t)(w * 128 * r * N);
+	}
 
 	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
 	PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, 1, B, p * 128 * r);
 
 	/* 2: for i = 0 to p - 1 do */
-	for (i = 0; i < p; i++) {
-		/* 3: B_i <-- MF(B_i, N) */
-		(smix)(&B[i * 128 * r], r, N, V, XY);
-	}
+	/* 3: B_i <-- MF(B_i, N), the lanes are independent */
+	if (threads > 1)
+		smix_parallel(lanes, threads);
+	else
+		smix_lanes_run(&lanes[0]);
 
 	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
 	PBKDF2_SHA256(passwd, passwdlen, B, p * 128 * r, 1, buf, buflen);
 
 	/* Free memory. */
-#if defined(MAP_ANON) && defined(HAVE_MMAP)
-	if (munmap(V0, 128 * r * N))
-		goto err2;
-#else
-#ifdef WIN_ALIGNED_MALLOC
-	_aligned_free(V0);
-#else
-	free(V0);
-#endif
-#endif
-#ifdef WIN_ALIGNED_MALLOC
-	_aligned_free(XY0);
-	_aligned_free(B0);
-#else
-	free(XY0);
-	free(B0);
-#endif
+	if (ws == &temp)
+		workspace_release(&temp);
+	else
+		insecure_memzero(B, 128 * r * p);
 
 	/* Success! */
 	return (0);
 
-err2:
-#ifdef WIN_ALIGNED_MALLOC
-	_aligned_free(XY0);
-#else
-	free(XY0);
-#endif
-err1:
-#ifdef WIN_ALIGNED_MALLOC
-	_aligned_free(B0);
-#else
-	free(B0);
-#endif
 err0:
 	/* Failure! */
 	return (-1);
@@ -207,21 +498,22 @@ static struct scrypt_test {
 	.salt = "SodiumChloride",
 	.N = 16,
 	.r = 8,
-	.p = 1,
+	.p = 4,
 	.result = {
-		0x25, 0xa9, 0xfa, 0x20, 0x7f, 0x87, 0xca, 0x09,
-		0xa4, 0xef, 0x8b, 0x9f, 0x77, 0x7a, 0xca, 0x16,
-		0xbe, 0xb7, 0x84, 0xae, 0x18, 0x30, 0xbf, 0xbf,
-		0xd3, 0x83, 0x25, 0xaa, 0xbb, 0x93, 0x77, 0xdf,
-		0x1b, 0xa7, 0x84, 0xd7, 0x46, 0xea, 0x27, 0x3b,
-		0xf5, 0x16, 0xa4, 0x6f, 0xbf, 0xac, 0xf5, 0x11,
-		0xc5, 0xbe, 0xba, 0x4c, 0x4a, 0xb3, 0xac, 0xc7,
-		0xfa, 0x6f, 0x46, 0x0b, 0x6c, 0x0f, 0x47, 0x7b,
+		0xc2, 0x76, 0x38, 0xe3, 0xc1, 0xe7, 0xe1, 0x85,
+		0xeb, 0x3a, 0xb5, 0xb9, 0x96, 0x6f, 0xbe, 0x7d,
+		0xc0, 0xc0, 0xc8, 0x6d, 0x10, 0x6d, 0xbf, 0xe6,
+		0x6f, 0x70, 0x0e, 0x55, 0x39, 0x4d, 0x1a, 0x9d,
+		0x69, 0xea, 0xfd, 0xf5, 0x1f, 0x23, 0x3d, 0x3c,
+		0x53, 0xa0, 0x1b, 0x7b, 0x3e, 0x9b, 0x30, 0x63,
+		0x5c, 0x52, 0x4a, 0x81, 0xe1, 0x66, 0xa1, 0x54,
+		0x2c, 0xd3, 0x76, 0x73, 0x19, 0x18, 0xf4, 0x66,
 	}
 };
 
 static int
-testsmix(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *))
+testsmix(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *),
+    void (*wide)(uint8_t *, size_t, uint64_t, void *, void *), uint32_t width)
 {
 	uint8_t hbuf[TESTLEN];
 
@@ -229,7 +521,8 @@ testsmix(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *))
 	if (_crypto_scrypt(
 	    (const uint8_t *)testcase.passwd, strlen(testcase.passwd),
 	    (const uint8_t *)testcase.salt, strlen(testcase.salt),
-	    testcase.N, testcase.r, testcase.p, hbuf, TESTLEN, smix))
+	    testcase.N, testcase.r, testcase.p, hbuf, TESTLEN, smix, wide, width,
+	    1, NULL))
 		return (-1);
 
 	/* Does it match? */
@@ -239,28 +532,53 @@ testsmix(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *))
 static void
 selectsmix(void)
 {
+	void (*smix)(uint8_t *, size_t, uint64_t, void *, void *) = NULL;
 
 #ifdef CPUSUPPORT_X86_SSE2
 	/* If we're running on an SSE2-capable CPU, try that code. */
 	if (cpusupport_x86_sse2()) {
 		/* If SSE2ized smix works, use it. */
-		if (!testsmix(crypto_scrypt_smix_sse2)) {
-			smix_func = crypto_scrypt_smix_sse2;
-			return;
-		}
-		warn0("Disabling broken SSE2 scrypt support - please report bug!");
+		if (!testsmix(crypto_scrypt_smix_sse2, NULL, 1))
+			smix = crypto_scrypt_smix_sse2;
+		else
+			warn0("Disabling broken SSE2 scrypt support - please report bug!");
 	}
 #endif
 
 	/* If generic smix works, use it. */
-	if (!testsmix(crypto_scrypt_smix)) {
-		smix_func = crypto_scrypt_smix;
-		return;
+	if (smix == NULL) {
+		if (!testsmix(crypto_scrypt_smix, NULL, 1))
+			smix = crypto_scrypt_smix;
+		else {
+			warn0("Generic scrypt code is broken - please report bug!");
+
+			/* If we get here, something really bad happened. */
+			abort();
+		}
 	}
-	warn0("Generic scrypt code is broken - please report bug!");
 
-	/* If we get here, something really bad happened. */
-	abort();
+#ifdef CPUSUPPORT_X86_AVX512F
+	/* Compute four lanes at once on AVX-512 CPUs. */
+	if ((smix_wide_func == NULL) && cpusupport_x86_avx512f()) {
+		if (!testsmix(smix, crypto_scrypt_smix_avx512, 4)) {
+			smix_wide_func = crypto_scrypt_smix_avx512;
+			smix_width = 4;
+		} else
+			warn0("Disabling broken AVX-512 scrypt support - please report bug!");
+	}
+#endif
+#ifdef CPUSUPPORT_X86_AVX2
+	/* Compute two lanes at once on AVX2 CPUs. */
+	if ((smix_wide_func == NULL) && cpusupport_x86_avx2()) {
+		if (!testsmix(smix, crypto_scrypt_smix_avx2, 2)) {
+			smix_wide_func = crypto_scrypt_smix_avx2;
+			smix_width = 2;
+		} else
+			warn0("Disabling broken AVX2 scrypt support - please report bug!");
+	}
+#endif
+
+	smix_func = smix;
 }
 
 /**
@@ -278,9 +596,49 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
     uint8_t * buf, size_t buflen)
 {
 
-	if (smix_func == NULL)
-		selectsmix();
+	initsmix();
+
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
+	    buf, buflen, smix_func, smix_wide_func, smix_width, 1, NULL));
+}
+
+/**
+ * crypto_scrypt_threads(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     threads):
+ * Compute the same result as crypto_scrypt, but run the p independent lanes
+ * on up to ${threads} threads.  Every thread needs its own 128 * r * N bytes
+ * for each lane it computes at once.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_threads(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * buf, size_t buflen, uint32_t threads)
+{
+
+	initsmix();
+
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
+	    buf, buflen, smix_func, smix_wide_func, smix_width, threads, NULL));
+}
+
+/**
+ * crypto_scrypt_ws(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     threads, ws):
+ * Same as crypto_scrypt_threads, but take the memory from the workspace ${ws}
+ * which is enlarged if necessary and kept for following calls.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_ws(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * buf, size_t buflen, uint32_t threads, scrypt_workspace * ws)
+{
+
+	initsmix();
 
 	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
-	    buf, buflen, smix_func));
+	    buf, buflen, smix_func, smix_wide_func, smix_width, threads, ws));
 }
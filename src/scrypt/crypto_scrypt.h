@@ -31,8 +31,23 @@
 
 #include "config.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+/* Flags of scrypt_workspace_init. */
+#define SCRYPT_WORKSPACE_HUGEPAGES	1	/* MAP_HUGETLB or transparent huge pages */
+#define SCRYPT_WORKSPACE_LOCK		2	/* mlock (best effort) */
+#define SCRYPT_WORKSPACE_NARROW		4	/* one lane per thread at a time: less memory */
+
+/* Scratch memory (B, XY and V of every thread) kept across derivations. */
+typedef struct {
+	void * base;
+	uint8_t * mem;
+	size_t size;
+	int flags;
+	int locked;
+} scrypt_workspace;
+
 /**
  * crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen):
  * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
@@ -45,4 +60,48 @@
 int crypto_scrypt(const uint8_t *, size_t, const uint8_t *, size_t, uint64_t,
     uint32_t, uint32_t, uint8_t *, size_t);
 
+/**
+ * crypto_scrypt_threads(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     threads):
+ * Compute the same result as crypto_scrypt, but run the p independent lanes
+ * on up to ${threads} threads.  Every thread needs its own 128 * r * N bytes
+ * for each lane it computes at once.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_threads(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, uint32_t);
+
+/**
+ * crypto_scrypt_ws(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     threads, ws):
+ * Same as crypto_scrypt_threads, but take the memory from the workspace ${ws}
+ * which is enlarged if necessary and kept for following calls.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_ws(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, uint32_t,
+    scrypt_workspace *);
+
+/**
+ * crypto_scrypt_memory(N, r, p, threads, flags):
+ * Return the number of bytes a workspace with the flags ${flags} needs for the
+ * given parameters; or 0 if the parameters are invalid or the size does not
+ * fit into size_t.
+ */
+size_t crypto_scrypt_memory(uint64_t, uint32_t, uint32_t, uint32_t, int);
+
+/**
+ * scrypt_workspace_init(ws, flags):
+ * Initialize ${ws}; no memory is allocated before it is used.
+ */
+void scrypt_workspace_init(scrypt_workspace *, int);
+
+/**
+ * scrypt_workspace_free(ws):
+ * Wipe and free the memory held by ${ws}.
+ */
+void scrypt_workspace_free(scrypt_workspace *);
+
 #endif /* !_CRYPTO_SCRYPT_H_ */
@@ -0,0 +1,20 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_AVX2_H_
+#define _CRYPTO_SCRYPT_SMIX_AVX2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * crypto_scrypt_smix_avx2(B, r, N, V, XY):
+ * Compute B_i = SMix_r(B_i, N) for the two consecutive lanes B_0 and B_1,
+ * each in one half of the AVX2 registers.  The input B must be 2 * 128r bytes
+ * in length; the temporary storage V must be 2 * 128rN bytes in length; the
+ * temporary storage XY must be 2 * (256r + 64) bytes in length.  The value N
+ * must be a power of 2 greater than 1.  The arrays B, V, and XY must be
+ * aligned to a multiple of 64 bytes.
+ *
+ * Use AVX2 instructions.
+ */
+void crypto_scrypt_smix_avx2(uint8_t *, size_t, uint64_t, void *, void *);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_AVX2_H_ */
@@ -0,0 +1,244 @@
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_AVX512F
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix_avx512.h"
+
+/*
+* The lanes are computed exactly like in crypto_scrypt_smix_sse2, but every
+* 128-bit quarter of a register holds the same row of a different lane.  X, Y, Z
+* and V store the rows of all lanes interleaved.
+*/
+#define LANES 4
+
+typedef __m512i row_t;
+
+#define ADD(x, y)	_mm512_add_epi32(x, y)
+#define XOR(x, y)	_mm512_xor_si512(x, y)
+#define ROTL(x, n)	_mm512_rol_epi32(x, n)
+#define SHUFFLE(x, m)	_mm512_shuffle_epi32(x, (_MM_PERM_ENUM)(m))
+
+static void blkcpy(row_t *, const row_t *, size_t);
+static void blkxor(row_t *, const row_t *, size_t);
+static void blkxor_lanes(row_t *, const uint8_t *, const uint64_t *, size_t);
+static void salsa20_8(row_t[4]);
+static void blockmix_salsa8(const row_t *, row_t *, row_t *, size_t);
+static uint64_t integerify(const row_t *, size_t, size_t);
+
+static void
+blkcpy(row_t * D, const row_t * S, size_t rows)
+{
+	size_t i;
+
+	for (i = 0; i < rows; i++)
+		D[i] = S[i];
+}
+
+static void
+blkxor(row_t * D, const row_t * S, size_t rows)
+{
+	size_t i;
+
+	for (i = 0; i < rows; i++)
+		D[i] = XOR(D[i], S[i]);
+}
+
+/**
+* blkxor_lanes(X, V, j, r):
+* Xor every lane of X with its own block V_{j[lane]}.
+*/
+static void
+blkxor_lanes(row_t * X, const uint8_t * V, const uint64_t * j, size_t r)
+{
+	const uint8_t * V0 = &V[j[0] * LANES * 128 * r];
+	const uint8_t * V1 = &V[j[1] * LANES * 128 * r + 16];
+	const uint8_t * V2 = &V[j[2] * LANES * 128 * r + 32];
+	const uint8_t * V3 = &V[j[3] * LANES * 128 * r + 48];
+	row_t T;
+	size_t i;
+
+	for (i = 0; i < 8 * r; i++) {
+		T = _mm512_castsi128_si512(
+		    _mm_load_si128((const __m128i *)&V0[i * sizeof(row_t)]));
+		T = _mm512_inserti32x4(T,
+		    _mm_load_si128((const __m128i *)&V1[i * sizeof(row_t)]), 1);
+		T = _mm512_inserti32x4(T,
+		    _mm_load_si128((const __m128i *)&V2[i * sizeof(row_t)]), 2);
+		T = _mm512_inserti32x4(T,
+		    _mm_load_si128((const __m128i *)&V3[i * sizeof(row_t)]), 3);
+		X[i] = XOR(X[i], T);
+	}
+}
+
+/**
+* salsa20_8(B):
+* Apply the salsa20/8 core to the provided block of every lane.
+*/
+static void
+salsa20_8(row_t B[4])
+{
+	row_t X0, X1, X2, X3;
+	size_t i;
+
+	X0 = B[0];
+	X1 = B[1];
+	X2 = B[2];
+	X3 = B[3];
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on "columns". */
+		X1 = XOR(X1, ROTL(ADD(X0, X3), 7));
+		X2 = XOR(X2, ROTL(ADD(X1, X0), 9));
+		X3 = XOR(X3, ROTL(ADD(X2, X1), 13));
+		X0 = XOR(X0, ROTL(ADD(X3, X2), 18));
+
+		/* Rearrange data. */
+		X1 = SHUFFLE(X1, 0x93);
+		X2 = SHUFFLE(X2, 0x4E);
+		X3 = SHUFFLE(X3, 0x39);
+
+		/* Operate on "rows". */
+		X3 = XOR(X3, ROTL(ADD(X0, X1), 7));
+		X2 = XOR(X2, ROTL(ADD(X3, X0), 9));
+		X1 = XOR(X1, ROTL(ADD(X2, X3), 13));
+		X0 = XOR(X0, ROTL(ADD(X1, X2), 18));
+
+		/* Rearrange data. */
+		X1 = SHUFFLE(X1, 0x39);
+		X2 = SHUFFLE(X2, 0x4E);
+		X3 = SHUFFLE(X3, 0x93);
+	}
+
+	B[0] = ADD(B[0], X0);
+	B[1] = ADD(B[1], X1);
+	B[2] = ADD(B[2], X2);
+	B[3] = ADD(B[3], X3);
+}
+
+/**
+* blockmix_salsa8(Bin, Bout, X, r):
+* Compute Bout = BlockMix_{salsa20/8, r}(Bin) for every lane.  The input Bin
+* must be 8r rows in length; the output Bout must also be the same size.  The
+* temporary space X must be 4 rows.
+*/
+static void
+blockmix_salsa8(const row_t * Bin, row_t * Bout, row_t * X, size_t r)
+{
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	blkcpy(X, &Bin[8 * r - 4], 4);
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < r; i++) {
+		/* 3: X <-- H(X \xor B_i) */
+		blkxor(X, &Bin[i * 8], 4);
+		salsa20_8(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		blkcpy(&Bout[i * 4], X, 4);
+
+		/* 3: X <-- H(X \xor B_i) */
+		blkxor(X, &Bin[i * 8 + 4], 4);
+		salsa20_8(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		blkcpy(&Bout[(r + i) * 4], X, 4);
+	}
+}
+
+/**
+* integerify(B, r, lane):
+* Return the result of parsing B_{2r-1} of ${lane} as a little-endian integer.
+*/
+static uint64_t
+integerify(const row_t * B, size_t r, size_t lane)
+{
+	const uint32_t * X = (const uint32_t *)&B[(2 * r - 1) * 4];
+
+	return (((uint64_t)(X[3 * 4 * LANES + lane * 4 + 1]) << 32) +
+	    X[lane * 4]);
+}
+
+/**
+* crypto_scrypt_smix_avx512(B, r, N, V, XY):
+* Compute B_i = SMix_r(B_i, N) for the four consecutive lanes B_0 ... B_3,
+* each in one quarter of the AVX-512 registers.  The input B must be
+* 4 * 128r bytes in length; the temporary storage V must be 4 * 128rN bytes in
+* length; the temporary storage XY must be 4 * (256r + 64) bytes in length.
+* The value N must be a power of 2 greater than 1.  The arrays B, V, and XY
+* must be aligned to a multiple of 64 bytes.
+*
+* Use AVX-512F instructions.
+*/
+void
+crypto_scrypt_smix_avx512(uint8_t * B, size_t r, uint64_t N, void * V, void * XY)
+{
+	row_t * X = XY;
+	row_t * Y = (void *)((uintptr_t)(XY) + LANES * 128 * r);
+	row_t * Z = (void *)((uintptr_t)(XY) + LANES * 256 * r);
+	uint32_t * X32 = (void *)X;
+	uint64_t i, j[LANES];
+	size_t k, l;
+
+	/* 1: X <-- B */
+	for (l = 0; l < LANES; l++) {
+		for (k = 0; k < 2 * r * 16; k++) {
+			X32[(k / 4) * 4 * LANES + l * 4 + k % 4] =
+			    le32dec(&B[l * 128 * r +
+			    ((k & ~(size_t)15) + (k % 16 * 5 % 16)) * 4]);
+		}
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 3: V_i <-- X */
+		blkcpy((void *)((uintptr_t)(V) + i * LANES * 128 * r), X, 8 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(X, Y, Z, r);
+
+		/* 3: V_i <-- X */
+		blkcpy((void *)((uintptr_t)(V) + (i + 1) * LANES * 128 * r),
+		    Y, 8 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(Y, X, Z, r);
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 7: j <-- Integerify(X) mod N */
+		for (l = 0; l < LANES; l++)
+			j[l] = integerify(X, r, l) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor_lanes(X, V, j, r);
+		blockmix_salsa8(X, Y, Z, r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		for (l = 0; l < LANES; l++)
+			j[l] = integerify(Y, r, l) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor_lanes(Y, V, j, r);
+		blockmix_salsa8(Y, X, Z, r);
+	}
+
+	/* 10: B' <-- X */
+	for (l = 0; l < LANES; l++) {
+		for (k = 0; k < 2 * r * 16; k++) {
+			le32enc(&B[l * 128 * r +
+			    ((k & ~(size_t)15) + (k % 16 * 5 % 16)) * 4],
+			    X32[(k / 4) * 4 * LANES + l * 4 + k % 4]);
+		}
+	}
+}
+
+#endif /* CPUSUPPORT_X86_AVX512F */
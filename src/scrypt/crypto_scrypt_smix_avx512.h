@@ -0,0 +1,20 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_AVX512_H_
+#define _CRYPTO_SCRYPT_SMIX_AVX512_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * crypto_scrypt_smix_avx512(B, r, N, V, XY):
+ * Compute B_i = SMix_r(B_i, N) for the four consecutive lanes B_0 ... B_3,
+ * each in one quarter of the AVX-512 registers.  The input B must be
+ * 4 * 128r bytes in length; the temporary storage V must be 4 * 128rN bytes in
+ * length; the temporary storage XY must be 4 * (256r + 64) bytes in length.
+ * The value N must be a power of 2 greater than 1.  The arrays B, V, and XY
+ * must be aligned to a multiple of 64 bytes.
+ *
+ * Use AVX-512F instructions.
+ */
+void crypto_scrypt_smix_avx512(uint8_t *, size_t, uint64_t, void *, void *);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_AVX512_H_ */
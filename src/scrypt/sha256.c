@@ -2,7 +2,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "cpusupport.h"
 #include "insecure_memzero.h"
+#include "sha256_avx2.h"
+#include "sha256_shani.h"
 #include "sysendian.h"
 
 #include "sha256.h"
@@ -13,6 +16,40 @@
 #define RESTRICT static restrict
 #endif
 
+#if defined(CPUSUPPORT_X86_SHANI) || defined(CPUSUPPORT_X86_AVX2)
+#define HWACCEL
+
+/* Selected by hwaccel_init: SHA-NI, then AVX2 multi-buffer, then scalar. */
+static enum {
+	HW_SOFTWARE = 0,
+	HW_X86_SHANI,
+	HW_X86_AVX2,
+	HW_UNSET
+} hwaccel = HW_UNSET;
+
+/* Pick the fastest SHA256 code the CPU supports. */
+static void
+hwaccel_init(void)
+{
+
+	/* Already picked? */
+	if (hwaccel != HW_UNSET)
+		return;
+
+	hwaccel = HW_SOFTWARE;
+#ifdef CPUSUPPORT_X86_SHANI
+	if (cpusupport_x86_shani()) {
+		hwaccel = HW_X86_SHANI;
+		return;
+	}
+#endif
+#ifdef CPUSUPPORT_X86_AVX2
+	if (cpusupport_x86_avx2())
+		hwaccel = HW_X86_AVX2;
+#endif
+}
+#endif /* CPUSUPPORT_X86_SHANI || CPUSUPPORT_X86_AVX2 */
+
 
 /*
 * Encode a length len/4 vector of (uint32_t) into a length len vector of
@@ -107,6 +144,14 @@ SHA256_Transform(uint32_t state[RESTRICT 8],
 {
 	int i;
 
+#ifdef CPUSUPPORT_X86_SHANI
+	/* Use the SHA-NI instructions if available. */
+	if (hwaccel == HW_X86_SHANI) {
+		SHA256_Transform_shani(state, block);
+		return;
+	}
+#endif
+
 	/* 1. Prepare the first part of the message schedule W. */
 	be32dec_vect(W, block, 64);
 
@@ -207,6 +252,11 @@ void
 SHA256_Init(SHA256_CTX * ctx)
 {
 
+#ifdef HWACCEL
+	/* Pick the SHA256 code on first use. */
+	hwaccel_init();
+#endif
+
 	/* Zero bits processed so far. */
 	ctx->count = 0;
 
@@ -461,6 +511,92 @@ HMAC_SHA256_Buf(const void * K, size_t Klen, const void * in, size_t len,
 	insecure_memzero(tmp8, 96);
 }
 
+#ifdef CPUSUPPORT_X86_AVX2
+/**
+* PBKDF2_SHA256_avx2(Phctx, PShctx, c, i, n, buf, dkLen):
+* Compute the PBKDF2 blocks T_{i + 1} ... T_{i + n} (n <= 8) at once, one per
+* lane of SHA256_Transform_avx2.  ${Phctx} is the HMAC state after processing
+* P and ${PShctx} the state after processing P and S.
+*/
+static void
+PBKDF2_SHA256_avx2(const HMAC_SHA256_CTX * Phctx,
+	const HMAC_SHA256_CTX * PShctx, uint64_t c, size_t i, size_t n,
+	uint8_t * buf, size_t dkLen)
+{
+	uint32_t state[SHA256_AVX2_LANES][8];
+	uint8_t block[SHA256_AVX2_LANES][128];
+	uint8_t T[SHA256_AVX2_LANES][32];
+	const uint8_t * in[SHA256_AVX2_LANES];
+	size_t r, nblocks, b, k, clen;
+	uint64_t j;
+	int l;
+
+	/* The buffered end of S, INT(i + k + 1) and the padding. */
+	r = (PShctx->ictx.count >> 3) & 0x3f;
+	nblocks = (r + 4 < 56) ? 1 : 2;
+	for (k = 0; k < SHA256_AVX2_LANES; k++) {
+		memcpy(state[k], PShctx->ictx.state, 32);
+		memcpy(block[k], PShctx->ictx.buf, r);
+		be32enc(&block[k][r], (uint32_t)(i + k + 1));
+		block[k][r + 4] = 0x80;
+		memset(&block[k][r + 5], 0, nblocks * 64 - r - 5);
+		be64enc(&block[k][nblocks * 64 - 8],
+		    PShctx->ictx.count + (4 << 3));
+	}
+
+	/* Compute U_1 = PRF(P, S || INT(i)), T_i = U_1 ... */
+	for (b = 0; b < nblocks; b++) {
+		for (k = 0; k < SHA256_AVX2_LANES; k++)
+			in[k] = &block[k][b * 64];
+		SHA256_Transform_avx2(state, in);
+	}
+	for (j = 1; j <= c; j++) {
+		/* ... the inner hash of U_j was computed, finish U_j ... */
+		for (k = 0; k < SHA256_AVX2_LANES; k++) {
+			be32enc_vect(block[k], state[k], 32);
+			memcpy(&block[k][32], PAD, 24);
+			be64enc(&block[k][56], (64 + 32) << 3);
+			memcpy(state[k], PShctx->octx.state, 32);
+			in[k] = block[k];
+		}
+		SHA256_Transform_avx2(state, in);
+
+		/* ... xor U_j ... */
+		for (k = 0; k < SHA256_AVX2_LANES; k++) {
+			be32enc_vect(block[k], state[k], 32);
+			if (j == 1)
+				memcpy(T[k], block[k], 32);
+			else
+				for (l = 0; l < 32; l++)
+					T[k][l] ^= block[k][l];
+		}
+		if (j == c)
+			break;
+
+		/* Compute the inner hash of U_{j + 1} = PRF(P, U_j). */
+		for (k = 0; k < SHA256_AVX2_LANES; k++) {
+			memcpy(&block[k][32], PAD, 24);
+			be64enc(&block[k][56], (64 + 32) << 3);
+			memcpy(state[k], Phctx->ictx.state, 32);
+		}
+		SHA256_Transform_avx2(state, in);
+	}
+
+	/* Copy as many bytes as necessary into buf. */
+	for (k = 0; k < n; k++) {
+		clen = dkLen - (i + k) * 32;
+		if (clen > 32)
+			clen = 32;
+		memcpy(&buf[(i + k) * 32], T[k], clen);
+	}
+
+	/* Clean the stack. */
+	insecure_memzero(state, sizeof(state));
+	insecure_memzero(block, sizeof(block));
+	insecure_memzero(T, sizeof(T));
+}
+#endif /* CPUSUPPORT_X86_AVX2 */
+
 /**
 * PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
 * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA256 as the PRF, and
@@ -480,6 +616,9 @@ PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
 	uint64_t j;
 	int k;
 	size_t clen;
+#ifdef CPUSUPPORT_X86_AVX2
+	size_t n;
+#endif
 
 	/* Sanity-check. */
 	assert(dkLen <= 32 * (size_t)(UINT32_MAX));
@@ -494,6 +633,18 @@ PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
 
 	/* Iterate through the blocks. */
 	for (i = 0; i * 32 < dkLen; i++) {
+#ifdef CPUSUPPORT_X86_AVX2
+		/* Compute up to eight blocks at once with multi-buffer code. */
+		if ((hwaccel == HW_X86_AVX2) && (dkLen - i * 32 > 32)) {
+			n = (dkLen - i * 32 + 31) / 32;
+			if (n > SHA256_AVX2_LANES)
+				n = SHA256_AVX2_LANES;
+			PBKDF2_SHA256_avx2(&Phctx, &PShctx, c, i, n, buf, dkLen);
+			i += n - 1;
+			continue;
+		}
+#endif
+
 		/* Generate INT(i + 1). */
 		be32enc(ivec, (uint32_t)(i + 1));
 
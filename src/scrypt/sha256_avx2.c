@@ -0,0 +1,118 @@
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_AVX2
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "insecure_memzero.h"
+#include "sysendian.h"
+
+#include "sha256_avx2.h"
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Elementary functions, one 32-bit word of every lane per register. */
+#define ADD(x, y)	_mm256_add_epi32(x, y)
+#define XOR(x, y)	_mm256_xor_si256(x, y)
+#define SHR(x, n)	_mm256_srli_epi32(x, n)
+#define ROTR(x, n)	_mm256_or_si256(_mm256_srli_epi32(x, n),	\
+			    _mm256_slli_epi32(x, 32 - (n)))
+#define Ch(x, y, z)	XOR(_mm256_and_si256(x, XOR(y, z)), z)
+#define Maj(x, y, z)	_mm256_or_si256(_mm256_and_si256(x,		\
+			    _mm256_or_si256(y, z)), _mm256_and_si256(y, z))
+#define S0(x)		XOR(XOR(ROTR(x, 2), ROTR(x, 13)), ROTR(x, 22))
+#define S1(x)		XOR(XOR(ROTR(x, 6), ROTR(x, 11)), ROTR(x, 25))
+#define s0(x)		XOR(XOR(ROTR(x, 7), ROTR(x, 18)), SHR(x, 3))
+#define s1(x)		XOR(XOR(ROTR(x, 17), ROTR(x, 19)), SHR(x, 10))
+
+/* SHA256 round function */
+#define RND(a, b, c, d, e, f, g, h, k)					\
+	h = ADD(h, ADD(ADD(S1(e), Ch(e, f, g)), k));			\
+	d = ADD(d, h);							\
+	h = ADD(h, ADD(S0(a), Maj(a, b, c)));
+
+/* Adjusted round function for rotating state */
+#define RNDr(S, W, i, ii)						\
+	RND(S[(64 - i) % 8], S[(65 - i) % 8],				\
+	    S[(66 - i) % 8], S[(67 - i) % 8],				\
+	    S[(68 - i) % 8], S[(69 - i) % 8],				\
+	    S[(70 - i) % 8], S[(71 - i) % 8],				\
+	    ADD(W[i + ii], _mm256_set1_epi32((int)Krnd[i + ii])))
+
+/**
+ * SHA256_Transform_avx2(state, block):
+ * Compute the SHA256 block compression function for eight independent
+ * messages at once, transforming ${state}[i] using the data in ${block}[i].
+ * This implementation uses x86 AVX2 instructions, and should only be used if
+ * CPUSUPPORT_X86_AVX2 is defined and cpusupport_x86_avx2() returns nonzero.
+ */
+void
+SHA256_Transform_avx2(uint32_t state[SHA256_AVX2_LANES][8],
+    const uint8_t * const block[SHA256_AVX2_LANES])
+{
+	__m256i W[64];
+	__m256i S[8];
+	uint32_t word[SHA256_AVX2_LANES];
+	int i, k;
+
+	/* 1. Prepare the message schedule W, transposed into the lanes. */
+	for (i = 0; i < 16; i++) {
+		for (k = 0; k < SHA256_AVX2_LANES; k++)
+			word[k] = be32dec(&block[k][i * 4]);
+		W[i] = _mm256_loadu_si256((const __m256i *)word);
+	}
+	for (i = 16; i < 64; i++)
+		W[i] = ADD(ADD(s1(W[i - 2]), W[i - 7]),
+		    ADD(s0(W[i - 15]), W[i - 16]));
+
+	/* 2. Initialize working variables. */
+	for (i = 0; i < 8; i++) {
+		for (k = 0; k < SHA256_AVX2_LANES; k++)
+			word[k] = state[k][i];
+		S[i] = _mm256_loadu_si256((const __m256i *)word);
+	}
+
+	/* 3. Mix. */
+	for (i = 0; i < 64; i += 8) {
+		RNDr(S, W, 0, i);
+		RNDr(S, W, 1, i);
+		RNDr(S, W, 2, i);
+		RNDr(S, W, 3, i);
+		RNDr(S, W, 4, i);
+		RNDr(S, W, 5, i);
+		RNDr(S, W, 6, i);
+		RNDr(S, W, 7, i);
+	}
+
+	/* 4. Mix local working variables into global state. */
+	for (i = 0; i < 8; i++) {
+		_mm256_storeu_si256((__m256i *)word, S[i]);
+		for (k = 0; k < SHA256_AVX2_LANES; k++)
+			state[k][i] += word[k];
+	}
+
+	/* Clean the stack. */
+	insecure_memzero(W, sizeof(W));
+	insecure_memzero(S, sizeof(S));
+	insecure_memzero(word, sizeof(word));
+}
+
+#endif /* CPUSUPPORT_X86_AVX2 */
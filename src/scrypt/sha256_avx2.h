@@ -0,0 +1,19 @@
+#ifndef _SHA256_AVX2_H_
+#define _SHA256_AVX2_H_
+
+#include <stdint.h>
+
+/* Number of independent messages processed by SHA256_Transform_avx2. */
+#define SHA256_AVX2_LANES 8
+
+/**
+ * SHA256_Transform_avx2(state, block):
+ * Compute the SHA256 block compression function for eight independent
+ * messages at once, transforming ${state}[i] using the data in ${block}[i].
+ * This implementation uses x86 AVX2 instructions, and should only be used if
+ * CPUSUPPORT_X86_AVX2 is defined and cpusupport_x86_avx2() returns nonzero.
+ */
+void SHA256_Transform_avx2(uint32_t[SHA256_AVX2_LANES][8],
+    const uint8_t * const[SHA256_AVX2_LANES]);
+
+#endif /* !_SHA256_AVX2_H_ */
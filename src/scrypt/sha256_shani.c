@@ -0,0 +1,86 @@
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_SHANI
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sha256_shani.h"
+
+/* SHA256 round constants, four per group of rounds. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/**
+ * SHA256_Transform_shani(state, block):
+ * Compute the SHA256 block compression function, transforming ${state} using
+ * the data in ${block}.  This implementation uses x86 SHA-NI instructions,
+ * and should only be used if CPUSUPPORT_X86_SHANI is defined and
+ * cpusupport_x86_shani() returns nonzero.
+ */
+void
+SHA256_Transform_shani(uint32_t state[8], const uint8_t block[64])
+{
+	const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+	    4, 5, 6, 7, 0, 1, 2, 3);
+	__m128i S0, S1, S0_save, S1_save;
+	__m128i M[4];
+	__m128i msg, tmp;
+	int i;
+
+	/* Load state, the instructions want ABEF and CDGH. */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]),
+	    0xB1);
+	S1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]),
+	    0x1B);
+	S0 = _mm_alignr_epi8(tmp, S1, 8);
+	S1 = _mm_blend_epi16(S1, tmp, 0xF0);
+	S0_save = S0;
+	S1_save = S1;
+
+	/* Four rounds per step; the message schedule runs three steps ahead. */
+	for (i = 0; i < 16; i++) {
+		if (i < 4)
+			M[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+			    (const __m128i *)&block[i * 16]), mask);
+		msg = _mm_add_epi32(M[i % 4],
+		    _mm_loadu_si128((const __m128i *)&Krnd[i * 4]));
+		S1 = _mm_sha256rnds2_epu32(S1, S0, msg);
+		if (i >= 3 && i < 15) {
+			tmp = _mm_alignr_epi8(M[i % 4], M[(i + 3) % 4], 4);
+			M[(i + 1) % 4] = _mm_add_epi32(M[(i + 1) % 4], tmp);
+			M[(i + 1) % 4] = _mm_sha256msg2_epu32(M[(i + 1) % 4],
+			    M[i % 4]);
+		}
+		msg = _mm_shuffle_epi32(msg, 0x0E);
+		S0 = _mm_sha256rnds2_epu32(S0, S1, msg);
+		if (i >= 1 && i < 13)
+			M[(i + 3) % 4] = _mm_sha256msg1_epu32(M[(i + 3) % 4],
+			    M[i % 4]);
+	}
+
+	/* Add the compressed block and store ABCD and EFGH again. */
+	S0 = _mm_add_epi32(S0, S0_save);
+	S1 = _mm_add_epi32(S1, S1_save);
+	tmp = _mm_shuffle_epi32(S0, 0x1B);
+	S1 = _mm_shuffle_epi32(S1, 0xB1);
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, S1, 0xF0));
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(S1, tmp, 8));
+}
+
+#endif /* CPUSUPPORT_X86_SHANI */